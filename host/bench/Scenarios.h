@@ -0,0 +1,94 @@
+//
+// Scripted finger movements for each gesture type, shared by the benchmarks
+//
+#ifndef SCENARIOS_H
+#define SCENARIOS_H
+
+#include "TouchSequence.h"
+
+#define MAX_SCENARIO_STEPS  10
+#define ANY_ELECTRODE       0xFF
+
+struct ScenarioStep {
+    unsigned int atMs;      // time since the start of the gesture
+    byte channel;           // MPR121 channel, ELECTRODE_PROXIMITY for prox
+    bool down;
+};
+
+struct Scenario {
+    const char *name;
+    TouchGesture expected;
+    byte electrode;         // expected getLastTouch(), or ANY_ELECTRODE
+    byte steps;
+    ScenarioStep step[MAX_SCENARIO_STEPS];
+};
+
+#define T ELECTRODE_TOP
+#define L ELECTRODE_LEFT
+#define B ELECTRODE_BOTTOM
+#define R ELECTRODE_RIGHT
+#define C ELECTRODE_CENTER
+#define P ELECTRODE_PROXIMITY
+
+static const Scenario scenarios[] = {
+    { "tap", TOUCH_TAP, C, 2,
+        { { 0, C, true }, { 80, C, false } } },
+    { "tap top", TOUCH_TAP, T, 2,
+        { { 0, T, true }, { 80, T, false } } },
+    { "double tap", TOUCH_DOUBLE_TAP, C, 4,
+        { { 0, C, true }, { 80, C, false },
+          { 200, C, true }, { 280, C, false } } },
+    { "short swipe up", TOUCH_SWIPE_UP, ANY_ELECTRODE, 4,
+        { { 0, C, true }, { 60, T, true },
+          { 90, C, false }, { 150, T, false } } },
+    { "short swipe down", TOUCH_SWIPE_DOWN, ANY_ELECTRODE, 4,
+        { { 0, C, true }, { 60, B, true },
+          { 90, C, false }, { 150, B, false } } },
+    { "short swipe left", TOUCH_SWIPE_LEFT, ANY_ELECTRODE, 4,
+        { { 0, C, true }, { 60, L, true },
+          { 90, C, false }, { 150, L, false } } },
+    { "short swipe right", TOUCH_SWIPE_RIGHT, ANY_ELECTRODE, 4,
+        { { 0, C, true }, { 60, R, true },
+          { 90, C, false }, { 150, R, false } } },
+    { "long swipe up", TOUCH_SWIPE_UP, ANY_ELECTRODE, 6,
+        { { 0, B, true }, { 50, C, true }, { 80, B, false },
+          { 110, T, true }, { 140, C, false }, { 200, T, false } } },
+    { "long swipe down", TOUCH_SWIPE_DOWN, ANY_ELECTRODE, 6,
+        { { 0, T, true }, { 50, C, true }, { 80, T, false },
+          { 110, B, true }, { 140, C, false }, { 200, B, false } } },
+    { "long swipe left", TOUCH_SWIPE_LEFT, ANY_ELECTRODE, 6,
+        { { 0, R, true }, { 50, C, true }, { 80, R, false },
+          { 110, L, true }, { 140, C, false }, { 200, L, false } } },
+    { "long swipe right", TOUCH_SWIPE_RIGHT, ANY_ELECTRODE, 6,
+        { { 0, L, true }, { 50, C, true }, { 80, L, false },
+          { 110, R, true }, { 140, C, false }, { 200, R, false } } },
+    { "proximity", TOUCH_PROXIMITY, ANY_ELECTRODE, 2,
+        { { 0, P, true }, { 600, P, false } } },
+    { "chord left+right", TOUCH_CHORD, ANY_ELECTRODE, 4,
+        { { 0, L, true }, { 20, R, true },
+          { 300, L, false }, { 310, R, false } } },
+    { "slow swipe up", TOUCH_UNKNOWN, ANY_ELECTRODE, 4,
+        { { 0, C, true }, { 400, T, true },
+          { 450, C, false }, { 500, T, false } } },
+    { "swipe slowing down", TOUCH_UNKNOWN, ANY_ELECTRODE, 10,
+        { { 0, B, true }, { 20, B, false }, { 40, C, true },
+          { 60, C, false }, { 80, B, true }, { 400, C, true },
+          { 420, B, false }, { 720, T, true },
+          { 740, C, false }, { 760, T, false } } },
+    { "5 touch swipe up", TOUCH_SWIPE_UP, ANY_ELECTRODE, 10,
+        { { 0, B, true }, { 40, B, false }, { 80, C, true },
+          { 120, C, false }, { 160, B, true }, { 200, B, false },
+          { 240, C, true }, { 280, C, false },
+          { 320, T, true }, { 360, T, false } } },
+};
+
+#undef T
+#undef L
+#undef B
+#undef R
+#undef C
+#undef P
+
+#define NUM_SCENARIOS (sizeof(scenarios) / sizeof(scenarios[0]))
+
+#endif // SCENARIOS_H
@@ -0,0 +1,221 @@
+//
+// ACK window benchmark: sends packets over a modelled radio link and
+// listens for each ACK as waitForReply() does, for the fixed replyWakeLock
+// and for AckWindow percentiles.  Reports the mean time spent listening per
+// packet and the ACKs that arrived after the window closed.  An ACK carrying
+// commands that starts within the window is listened to until complete.
+// Then checks which commands the hub's CommandQueue sends again when the
+// switch retries a packet or sends another one.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include "AckWindow.h"
+#include "CommandQueue.h"
+#include "SwitchSettings.h"
+
+#define PACKETS         5000
+
+struct Link {
+    const char *name;
+    // round trip: base + a uniform jitter, a share of the packets is
+    // delayed by up to tailMs more and a share gets no ACK at all
+    unsigned int baseMs;
+    unsigned int jitterMs;
+    unsigned int tailPercent;
+    unsigned int tailMs;
+    unsigned int lostPercent;
+    // a share of the ACKs carries commands of up to RF12_MAXDATA bytes
+    unsigned int commandPercent;
+};
+
+// returns the round trip of an ACK, 0 if it was lost
+static unsigned int
+roundTrip(const Link &link)
+{
+    if ((unsigned int)(rand() % 100) < link.lostPercent)
+        return 0;
+    unsigned int rtt = link.baseMs + rand() % (link.jitterMs + 1);
+    if ((unsigned int)(rand() % 100) < link.tailPercent)
+        rtt += rand() % (link.tailMs + 1);
+    return rtt;
+}
+
+struct Result {
+    double meanWaitMs;
+    unsigned long late;         // ACKs arriving after the window
+    unsigned long acks;         // ACKs sent by the hub
+    unsigned long commands;     // ACKs carrying commands
+    unsigned long commandsLate;
+};
+
+static Result
+run(const Link &first, const Link &second, byte percentile, byte limit)
+{
+    Result r;
+    memset(&r, 0, sizeof(r));
+    AckWindow window;
+    unsigned long long waited = 0;
+    srand(1);
+    for (int i = 0; i < PACKETS; ++i) {
+        // the link changes half way
+        const Link &link = i < PACKETS / 2 ? first : second;
+        unsigned int rtt = roundTrip(link);
+        byte w = window.getWindow(percentile, limit);
+        // the payload arrives after the length, seen at the round trip.
+        // Picked by the packet number, the round trips stay those of the
+        // links without commands.
+        unsigned int airMs = 0;
+        if (rtt && (unsigned int)(i * 37 % 100) < link.commandPercent) {
+            byte len = 1 + i * 53 % RF12_MAXDATA;
+            airMs = ((unsigned long)len + ACK_TRAILER) * ACK_BYTE_US / 1000;
+            r.commands++;
+        }
+        if (rtt)
+            r.acks++;
+        if (rtt && rtt <= w) {
+            waited += rtt + airMs;
+            window.add(rtt);
+        }
+        else {
+            // the firmware listens while millis() - start <= window
+            waited += w + 1;
+            window.miss();
+            if (rtt)
+                r.late++;
+            if (airMs)
+                r.commandsLate++;
+        }
+    }
+    r.meanWaitMs = (double)waited / PACKETS;
+    return r;
+}
+
+#define NODE            2
+
+// queues a command of len bytes for the switch
+static void
+queue(CommandQueue &q, byte type, byte len)
+{
+    SwitchPacket *pkt = (SwitchPacket *)q.reserve(NODE, len);
+    pkt->type = type;
+    pkt->len = len;
+}
+
+// the command bytes the hub sends with the ACK of a packet from the switch,
+// numbered with sequence or -1 for none
+static byte
+ack(CommandQueue &q, int sequence, byte flags = 0)
+{
+    SwitchSequence seq;
+    seq.sequence = sequence;
+    seq.flags = flags;
+    const SwitchSequence *numbered = sequence < 0 ? NULL : &seq;
+    q.received(NODE, numbered);
+    if (q.nodeId != NODE)
+        return 0;
+    byte len = q.length();
+    q.acked(numbered);
+    return len;
+}
+
+static int
+runCommands()
+{
+    int failures = 0;
+    CommandQueue q;
+    q.reset();
+
+    printf("\n%-34s %s\n", "commands", "ACK bytes");
+    // the ACK of the events was lost, their retry gets the commands again
+    queue(q, SwitchPacket::PING, sizeof(SwitchPacket));
+    byte first = ack(q, 5);
+    byte retry = ack(q, 5, SEQUENCE_RETRY);
+    byte next = ack(q, 6);
+    bool ok = first == sizeof(SwitchPacket) && retry == first && !next;
+    printf("%-34s %u, %u, %u%s\n", "events, retry, next events", first, retry,
+            next, ok ? "" : "  FAIL");
+    if (!ok)
+        failures++;
+
+    // a status shows the events got their ACK, it gets no commands again
+    queue(q, SwitchPacket::PING, sizeof(SwitchPacket));
+    first = ack(q, 7);
+    byte status = ack(q, -1);
+    ok = first == sizeof(SwitchPacket) && !status;
+    printf("%-34s %u, %u%s\n", "events, status", first, status,
+            ok ? "" : "  FAIL");
+    if (!ok)
+        failures++;
+
+    // only the commands queued after the ACK of the events go along
+    queue(q, SwitchPacket::PING, sizeof(SwitchPacket));
+    first = ack(q, 8);
+    queue(q, SwitchPacket::I2C_REQUEST, sizeof(SwitchI2CRequest));
+    status = ack(q, -1);
+    ok = first == sizeof(SwitchPacket) &&
+        status == sizeof(SwitchI2CRequest) &&
+        q.pkt[0] == SwitchPacket::I2C_REQUEST && !ack(q, -1);
+    printf("%-34s %u, %u%s\n", "events, command, status", first, status,
+            ok ? "" : "  FAIL");
+    if (!ok)
+        failures++;
+    return failures;
+}
+
+int
+main()
+{
+    static const Link links[] = {
+        { "quiet", 4, 2, 0, 0, 0, 5 },
+        { "busy", 5, 6, 5, 15, 2, 10 },
+        { "lossy", 4, 3, 2, 10, 20, 5 },
+    };
+    static const byte percentiles[] = { 0, 90, 95, 99 };
+    SleepSettings sleep;
+
+    printf("ack: %d packets, fixed window %ums\n\n", PACKETS,
+            sleep.replyWakeLock);
+    printf("%-14s %10s %9s %9s %8s %9s\n", "link", "percentile", "wait ms",
+            "late", "late %", "cmds late");
+
+    int failures = 0;
+    // each link on its own, then quiet turning busy
+    for (unsigned int l = 0; l <= sizeof(links) / sizeof(links[0]); ++l) {
+        bool shift = l == sizeof(links) / sizeof(links[0]);
+        const Link &first = shift ? links[0] : links[l];
+        const Link &second = shift ? links[1] : links[l];
+        Result fixed = run(first, second, 0, sleep.replyWakeLock);
+        for (unsigned int p = 0; p < sizeof(percentiles); ++p) {
+            Result r = run(first, second, percentiles[p],
+                    sleep.replyWakeLock);
+            double latePercent = r.acks ? 100.0 * r.late / r.acks : 0;
+            // the window costs at most about the ACKs beyond its
+            // percentile and never listens longer than the fixed window
+            bool ok = r.meanWaitMs <= fixed.meanWaitMs &&
+                (!percentiles[p] ||
+                 latePercent <= 100 - percentiles[p] + 1.0);
+            if (!ok)
+                failures++;
+            char name[32];
+            snprintf(name, sizeof(name), "%s%s%s", first.name,
+                    shift ? "->" : "", shift ? second.name : "");
+            printf("%-14s %10u %9.2f %9lu %7.2f%% %4lu/%-4lu%s\n", name,
+                    percentiles[p], r.meanWaitMs, r.late, latePercent,
+                    r.commandsLate, r.commands, ok ? "" : "  FAIL");
+        }
+    }
+
+    // a received ACK ends the wait either way, the default setting listens
+    // shorter for the ACKs that are lost
+    Result lossy = run(links[2], links[2], sleep.ackPercentile,
+            sleep.replyWakeLock);
+    Result fixed = run(links[2], links[2], 0, sleep.replyWakeLock);
+    printf("\ndefault %u%%: %.2fms per packet on a lossy link, %.2fms fixed\n",
+            sleep.ackPercentile, lossy.meanWaitMs, fixed.meanWaitMs);
+    if (lossy.meanWaitMs >= fixed.meanWaitMs) {
+        printf("FAIL: the default window does not listen shorter\n");
+        failures++;
+    }
+    failures += runCommands();
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,188 @@
+//
+// Battery benchmark: models the ADC readings readVcc() takes of a discharging
+// battery, a single conversion and the mean of VCC_SAMPLES, and feeds hourly
+// statuses with some piggybacked early into the firmware's BatteryTrend.
+// Reports the reading noise and the estimated days left against the true
+// days left over the life of the battery.  No line through the past sees
+// the knee of the curve coming, the bench also reports how many days after
+// the knee the estimate catches up.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include "BatteryTrend.h"
+#include "SwitchSettings.h"
+
+#define HOUR_MS         3600000UL
+// conversions averaged by readVcc() in switch/src/battery.cpp
+#define VCC_SAMPLES     8
+// ADC noise in counts, +-
+#define ADC_NOISE       2
+
+struct Battery {
+    const char *name;
+    // mV at day 0, at kneeDay and at endDay, linear in between
+    unsigned int startMv;
+    unsigned int kneeMv;
+    unsigned int endMv;
+    unsigned int kneeDay;
+    unsigned int endDay;
+};
+
+static double
+voltage(const Battery &b, double day)
+{
+    if (day < b.kneeDay)
+        return b.startMv - (double)(b.startMv - b.kneeMv) * day / b.kneeDay;
+    return b.kneeMv - (double)(b.kneeMv - b.endMv) * (day - b.kneeDay) /
+        (b.endDay - b.kneeDay);
+}
+
+// the ADC result of measuring the 1.1V bandgap against Vcc
+static unsigned int
+convert(double mv)
+{
+    int counts = (int)(1125300.0 / mv + 0.5) + rand() % (2 * ADC_NOISE + 1) -
+        ADC_NOISE;
+    return counts > 0 ? counts : 1;
+}
+
+static long
+readVcc(double mv, byte samples)
+{
+    unsigned long sum = 0;
+    for (byte i = 0; i < samples; ++i)
+        sum += convert(mv);
+    return 1125300L * samples / sum;
+}
+
+struct Result {
+    double single;              // mean absolute reading error, mV
+    double averaged;
+    unsigned int firstDay;      // first day with an estimate
+    double meanError;           // mean relative error against the true days
+    double kneeError;           // the same from the knee on
+    unsigned int kneeLag;       // days from the knee to a close estimate
+    unsigned int daysAtEnd;     // the estimate past the end of life
+};
+
+// an estimate within a quarter or 2 days of the true days left
+static bool
+isClose(unsigned int days, double left)
+{
+    double error = days > left ? days - left : left - days;
+    return error <= 2 || error <= left / 4;
+}
+
+static Result
+run(const Battery &b, unsigned int cutoffMv, bool print)
+{
+    Result r;
+    memset(&r, 0, sizeof(r));
+    BatteryTrend trend;
+    srand(1);
+    unsigned long now = 0;
+    unsigned long readings = 0;
+    unsigned int estimates = 0;
+    unsigned int kneeEstimates = 0;
+    double singleErr = 0, averagedErr = 0, relErr = 0, kneeErr = 0;
+    unsigned int lastDay = ~0;
+    bool caught = false;
+    r.kneeLag = b.endDay - b.kneeDay;
+    while (now / (24 * HOUR_MS) <= b.endDay + 2) {
+        double day = now / (24.0 * HOUR_MS);
+        double mv = voltage(b, day);
+        long vcc = readVcc(mv, VCC_SAMPLES);
+        singleErr += abs(readVcc(mv, 1) - (long)mv);
+        averagedErr += abs(vcc - (long)mv);
+        readings++;
+
+        trend.add(now, vcc);
+        unsigned int days = trend.getDaysLeft(cutoffMv);
+        unsigned int today = (unsigned int)day;
+        if (days != BATTERY_DAYS_UNKNOWN && !r.firstDay)
+            r.firstDay = today ? today : 1;
+        double left = b.endDay - day;
+        if (today != lastDay) {
+            lastDay = today;
+            if (days != BATTERY_DAYS_UNKNOWN && left >= 1) {
+                double err = (days > left ? days - left : left - days) / left;
+                relErr += err;
+                estimates++;
+                if (today >= b.kneeDay) {
+                    kneeErr += err;
+                    kneeEstimates++;
+                    if (!caught && isClose(days, left)) {
+                        caught = true;
+                        r.kneeLag = today - b.kneeDay;
+                    }
+                }
+            }
+            bool knee = today >= b.kneeDay && (today - b.kneeDay) % 5 == 0;
+            if (print && (today % 30 == 0 || knee)) {
+                char estimate[16];
+                if (days == BATTERY_DAYS_UNKNOWN)
+                    snprintf(estimate, sizeof(estimate), "unknown");
+                else
+                    snprintf(estimate, sizeof(estimate), "%u", days);
+                printf("  day %3u: %4ldmV, %3.0f days left, estimate %s\n",
+                        today, vcc, left > 0 ? left : 0, estimate);
+            }
+        }
+        if (left < 0)
+            r.daysAtEnd = days;
+        // hourly statuses, a quarter of them piggybacked up to 12min early
+        now += HOUR_MS - (rand() % 4 ? 0 : rand() % (12 * 60000UL));
+    }
+    r.single = singleErr / readings;
+    r.averaged = averagedErr / readings;
+    r.meanError = estimates ? relErr / estimates : 1;
+    r.kneeError = kneeEstimates ? kneeErr / kneeEstimates : 1;
+    return r;
+}
+
+int
+main()
+{
+    // two alkaline AA cells, a lithium cell with a flat curve and a
+    // cutoff reached earlier, and a steady supply
+    static const Battery batteries[] = {
+        { "2xAA alkaline", 3100, 2500, 2200, 300, 340 },
+        { "lithium", 3300, 3000, 2200, 150, 160 },
+    };
+    BatterySettings settings;
+    int failures = 0;
+
+    for (unsigned int i = 0; i < sizeof(batteries) / sizeof(batteries[0]);
+            ++i) {
+        const Battery &b = batteries[i];
+        printf("%s, cutoff %umV at day %u:\n", b.name, settings.cutoffMv,
+                b.endDay);
+        Result r = run(b, settings.cutoffMv, true);
+        printf("  reading error %.1fmV single, %.1fmV mean of %d\n",
+                r.single, r.averaged, VCC_SAMPLES);
+        printf("  first estimate day %u, mean error %.0f%% of the true days "
+                "left, %.0f%% from the knee on\n", r.firstDay,
+                100 * r.meanError, 100 * r.kneeError);
+        printf("  close %u days after the knee, %u at the end\n\n",
+                r.kneeLag, r.daysAtEnd);
+        // before the knee the estimate is the days at the discharge rate,
+        // it catches up within days of the knee and reads 0 once the
+        // cutoff passed
+        bool ok = r.averaged < r.single && r.firstDay && r.firstDay <= 7 &&
+            r.kneeLag <= BATTERY_RECENT_POINTS && r.daysAtEnd == 0;
+        if (!ok) {
+            printf("FAIL\n");
+            failures++;
+        }
+    }
+
+    // a steady supply never gets an estimate
+    Battery steady = { "steady", 3300, 3300, 3300, 100, 200 };
+    Result r = run(steady, settings.cutoffMv, false);
+    printf("steady supply: first estimate day %u\n", r.firstDay);
+    if (r.firstDay) {
+        printf("FAIL: a steady supply is estimated to run out\n");
+        failures++;
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,125 @@
+//
+// Boot benchmark: the touch phase of setup() for a cold start on an MPR121
+// fresh from power on, for a soft reset that configures the running MPR121
+// again with begin() and for a warm restart that takes it over with
+// resume().  Reports the i2c traffic, the time spent and the
+// auto-configuration runs, and checks that a tap is recognized after each.
+//
+#include <stdio.h>
+#include "TouchSequence.h"
+#include "MPR121Sim.h"
+
+static const byte mpr121Addr    = 0x5A;
+static const byte mpr121IntPin  = 1;
+
+static MPR121Sim mpr121(mpr121Addr, mpr121IntPin);
+
+enum BootKind { COLD, SOFT_RESET, WARM };
+
+struct Result {
+    unsigned long transactions;
+    unsigned long bytes;
+    unsigned long long busUs;
+    unsigned long long us;          // simulated time, delays included
+    unsigned long autoConfigs;
+    bool resumed;
+    bool tap;
+};
+
+// moves the finger on the center electrode as the main loop would see it
+static void
+step(TouchSequence &touch, bool down)
+{
+    if (down)
+        mpr121.touch(ELECTRODE_CENTER);
+    else
+        mpr121.release(ELECTRODE_CENTER);
+    if (touch.isInterrupted()) {
+        touch.update();
+        touch.enableInterrupt();
+    }
+    sim::advance(80000);
+}
+
+// returns true if a tap is recognized
+static bool
+tap(TouchSequence &touch)
+{
+    touch.enableInterrupt();
+    step(touch, true);
+    step(touch, false);
+    bool ok = touch.getGesture() == TOUCH_TAP;
+    touch.clear();
+    return ok;
+}
+
+static Result
+boot(BootKind kind)
+{
+    MPR121Settings settings;
+    settings.proximityMode = 1;
+    Result r;
+    memset(&r, 0, sizeof(r));
+
+    if (kind == COLD)
+        mpr121.reset();
+    else {
+        // the sketch that ran before the reset
+        TouchSequence before(mpr121Addr, mpr121IntPin);
+        before.begin(settings);
+    }
+
+    TouchSequence touch(mpr121Addr, mpr121IntPin);
+    sim::i2cStats().reset();
+    unsigned long autoConfigs = mpr121.autoConfigs;
+    unsigned long long start = sim::now();
+    // mirrors the touch phase of setup() in switch/src/firmware.cpp
+    r.resumed = kind == WARM && touch.resume();
+    if (!r.resumed) {
+        touch.begin(settings);
+        touch.beginBatch();
+        touch.setTouchThreshold(2, ELECTRODE_PROXIMITY);
+        touch.setReleaseThreshold(1, ELECTRODE_PROXIMITY);
+        touch.commitBatch();
+    }
+    r.us = sim::now() - start;
+    r.transactions = sim::i2cStats().transactions;
+    r.bytes = sim::i2cStats().bytes;
+    r.busUs = sim::i2cStats().busNanos / 1000;
+    r.autoConfigs = mpr121.autoConfigs - autoConfigs;
+    r.tap = tap(touch);
+    return r;
+}
+
+int
+main()
+{
+    static const char *names[] = { "cold", "soft reset", "warm restart" };
+    Result results[3];
+
+    printf("%-14s %8s %8s %9s %9s %10s %4s\n", "boot", "i2c", "bytes",
+            "bus us", "time us", "autoconfig", "tap");
+    int failures = 0;
+    for (int k = COLD; k <= WARM; ++k) {
+        Result &r = results[k] = boot((BootKind)k);
+        bool ok = r.tap && (k != WARM || r.resumed);
+        if (!ok)
+            failures++;
+        printf("%-14s %8lu %8lu %9llu %9llu %10lu %4s%s\n", names[k],
+                r.transactions, r.bytes, r.busUs, r.us, r.autoConfigs,
+                r.tap ? "ok" : "-", ok ? "" : "  FAIL");
+    }
+
+    // a warm restart leaves the MPR121 running: no auto-configuration and
+    // only the shadow registers are read back
+    const Result &soft = results[SOFT_RESET];
+    const Result &warm = results[WARM];
+    printf("\nwarm restart: %.1f%% of the soft reset i2c time\n",
+            soft.us ? 100.0 * warm.us / soft.us : 0);
+    if (warm.autoConfigs || warm.transactions * 2 > soft.transactions ||
+            warm.us >= soft.us) {
+        printf("FAIL: the warm restart reconfigures the MPR121\n");
+        failures++;
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,134 @@
+//
+// Threshold calibration benchmark: leaves the simulated MPR121 idle with
+// electrode noise and counts the touch wakeups it causes with the default
+// thresholds and after ThresholdCalibration measured the noise on idle
+// wakeups.  Real touches must still be detected with the new thresholds.
+//
+#include <stdio.h>
+#include "TouchSequence.h"
+#include "ThresholdCalibration.h"
+#include "MPR121Sim.h"
+#include "MPR121_registers.h"
+
+// MPR121 sample period with the default AFE2/ESI
+#define SAMPLE_MS       16
+#define IDLE_MINUTES    30
+
+static const byte mpr121Addr    = 0x5A;
+static const byte mpr121IntPin  = 1;
+
+static MPR121Sim mpr121(mpr121Addr, mpr121IntPin);
+static TouchSequence touch(mpr121Addr, mpr121IntPin);
+static ThresholdCalibration calibration(touch);
+
+static void
+measure(unsigned int ms)
+{
+    for (unsigned int t = 0; t < ms; t += SAMPLE_MS) {
+        sim::advance(SAMPLE_MS * 1000ULL);
+        mpr121.measure();
+    }
+}
+
+// returns the number of wakeups from idle during the given time
+static unsigned long
+idle(unsigned int minutes)
+{
+    unsigned long wakes = 0;
+    // acknowledge a status change left pending by earlier sampling
+    touch.update();
+    touch.clear();
+    touch.enableInterrupt();
+    for (unsigned long t = 0; t < minutes * 60000UL; t += SAMPLE_MS) {
+        measure(SAMPLE_MS);
+        if (!touch.isInterrupted())
+            continue;
+        if (!touch.isTouched() && !touch.isProximity())
+            wakes++;
+        touch.update();
+        touch.enableInterrupt();
+    }
+    touch.clear();
+    return wakes;
+}
+
+// returns the number of electrodes a finger is detected on
+static int
+touches(int electrodes)
+{
+    int detected = 0;
+    for (int i = 0; i < electrodes; ++i) {
+        touch.enableInterrupt();
+        mpr121.touch(i);
+        measure(SAMPLE_MS * 4);
+        touch.update();
+        if (touch.isTouched(i))
+            detected++;
+        mpr121.release(i);
+        measure(SAMPLE_MS * 4);
+        touch.update();
+        touch.clear();
+    }
+    return detected;
+}
+
+int
+main()
+{
+    MPR121Settings settings;
+    CalibrationSettings cal;
+    touch.begin(settings);
+
+    printf("calibration: margin %u/4, touch %u-%u, %u samples x %u wakeups\n\n",
+            cal.margin, cal.minTouch, cal.maxTouch, cal.samples, cal.wakeups);
+    printf("%-6s %12s %12s %6s %6s %8s %7s %8s\n", "noise", "wakes/h",
+            "wakes/h cal", "noise", "touch", "release", "i2c tx", "touches");
+
+    int failures = 0;
+    static const uint8_t levels[] = { 1, 2, 4, 8, 12, 16 };
+    for (unsigned int l = 0; l < sizeof(levels); ++l) {
+        // default thresholds
+        touch.beginBatch();
+        touch.setTouchThreshold(settings.touch);
+        touch.setReleaseThreshold(settings.release);
+        touch.commitBatch();
+        mpr121.setNoise(levels[l]);
+
+        unsigned long before = idle(IDLE_MINUTES);
+
+        // idle status wakeups
+        calibration.reset();
+        bool updated = false;
+        byte noise = 0;
+        for (byte w = 0; w < cal.wakeups; ++w) {
+            for (byte i = 0; i < cal.samples; ++i) {
+                calibration.sample();
+                measure(15);
+            }
+            noise = calibration.getNoise(0);
+            sim::i2cStats().reset();
+            updated |= calibration.update(cal);
+        }
+        sim::I2CStats stats = sim::i2cStats();
+
+        unsigned long after = idle(IDLE_MINUTES);
+        int detected = touches(settings.electrodes);
+        bool ok = updated && detected == settings.electrodes &&
+            after <= before;
+        if (!ok)
+            failures++;
+
+        printf("+-%-4u %12.1f %12.1f %6u %6u %8u %7lu %6d/%d%s\n", levels[l],
+                before * 60.0 / IDLE_MINUTES, after * 60.0 / IDLE_MINUTES,
+                noise, touch.getRegister(E0TTH), touch.getRegister(E0RTH),
+                stats.transactions, detected, settings.electrodes,
+                ok ? "" : "  FAIL");
+    }
+
+    if (mpr121.ignoredWrites) {
+        printf("\n%lu register writes while the MPR121 was running\n",
+                mpr121.ignoredWrites);
+        failures++;
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,260 @@
+//
+// Settings store benchmark: commits settings changes through the
+// firmware's ConfigStore and reports the EEPROM wear against rewriting the
+// settings in place, the reads of a boot, and checks that a commit cut
+// short at any byte loads the previous settings, that a corrupted record
+// falls back to the one before and that settings saved by earlier
+// firmware are migrated.
+//
+#include <stdio.h>
+#include <stddef.h>
+#include <EEPROM.h>
+#include "ConfigStore.h"
+#include "util.h"
+#include "Sim.h"
+
+#define COMMITS         1000
+
+static unsigned long
+maxWrites()
+{
+    unsigned long n = 0;
+    for (unsigned int i = 0; i <= E2END; ++i) {
+        if (EEPROM.writes[i] > n)
+            n = EEPROM.writes[i];
+    }
+    return n;
+}
+
+static unsigned long
+totalWrites()
+{
+    unsigned long n = 0;
+    for (unsigned int i = 0; i <= E2END; ++i)
+        n += EEPROM.writes[i];
+    return n;
+}
+
+// loads the settings with a new store, as a boot does
+static byte
+boot(SwitchSettings &settings, ConfigStore &store)
+{
+    settings = SwitchSettings();
+    store = ConfigStore();
+    return store.load(settings);
+}
+
+// a commit of a one byte change per step, returns the failures
+static int
+runWear()
+{
+    EEPROM.erase();
+    ConfigStore store;
+    SwitchSettings settings;
+
+    // the earlier saveConfiguration() wrote the changed bytes in place
+    unsigned long inPlace = 0;
+    unsigned long long start = sim::now();
+    for (int i = 0; i < COMMITS; ++i) {
+        settings.mpr121.touch = 4 + (i & 1);
+        store.commit(settings);
+        inPlace++;
+    }
+    double commitMs = (sim::now() - start) / 1000.0 / COMMITS;
+    unsigned long journal = maxWrites();
+
+    ConfigStore loaded;
+    SwitchSettings s;
+    EEPROM.reads = 0;
+    byte result = boot(s, loaded);
+    printf("%d commits of a 1 byte change, %d slots of %d bytes:\n",
+            COMMITS, CONFIG_SLOTS, CONFIG_SLOT_SIZE);
+    printf("  most writes to a cell: %lu in place, %lu journaled\n",
+            inPlace, journal);
+    printf("  bytes written per commit: %.1f, %.1fms\n",
+            (double)totalWrites() / COMMITS, commitMs);
+    printf("  boot: %lu EEPROM reads\n\n", EEPROM.reads);
+
+    bool ok = result == CONFIG_LOADED && s.mpr121.touch == settings.mpr121.touch &&
+        journal * (CONFIG_SLOTS - 1) <= inPlace + CONFIG_SLOTS &&
+        EEPROM.reads <= CONFIG_SLOTS * (CONFIG_HEADER_SIZE + 1) +
+            CONFIG_SLOT_SIZE;
+    if (!ok)
+        printf("FAIL: wear\n");
+    return ok ? 0 : 1;
+}
+
+// cuts a commit short after each byte, the previous settings or the new
+// ones must load
+static int
+runPowerLoss()
+{
+    int failures = 0;
+    unsigned int cuts = 0;
+    for (long budget = 0; budget < CONFIG_SLOT_SIZE; ++budget) {
+        EEPROM.erase();
+        ConfigStore store;
+        SwitchSettings settings;
+        // fill the slots so every byte of the next one changes
+        for (byte i = 0; i < CONFIG_SLOTS; ++i) {
+            settings.sleep.repeatMs = 100 + i;
+            store.commit(settings);
+        }
+        settings.sleep.repeatMs = 1000;
+        memset(settings.gesture.table, 0x5A, sizeof(settings.gesture.table));
+        EEPROM.budget = budget;
+        bool complete = store.commit(settings);
+        EEPROM.budget = -1;
+
+        SwitchSettings s;
+        ConfigStore loaded;
+        byte result = boot(s, loaded);
+        unsigned int expected = complete ? 1000 : 100 + CONFIG_SLOTS - 1;
+        if (result != CONFIG_LOADED || s.sleep.repeatMs != expected) {
+            printf("FAIL: commit cut after %ld bytes loads %u, not %u\n",
+                    budget, s.sleep.repeatMs, expected);
+            failures++;
+        }
+        if (!complete)
+            cuts++;
+    }
+    printf("commit cut short after 0-%d bytes: %u torn, %s\n",
+            CONFIG_SLOT_SIZE - 1, cuts,
+            failures ? "FAIL" : "previous settings loaded");
+
+    // a flipped bit in the newest record
+    EEPROM.erase();
+    ConfigStore store;
+    SwitchSettings settings;
+    settings.sleep.repeatMs = 1;
+    store.commit(settings);
+    settings.sleep.repeatMs = 2;
+    store.commit(settings);
+    int addr = store.getSlot() * CONFIG_SLOT_SIZE + CONFIG_HEADER_SIZE + 10;
+    EEPROM.write(addr, EEPROM.read(addr) ^ 0x04);
+    SwitchSettings s;
+    ConfigStore loaded;
+    boot(s, loaded);
+    printf("corrupted newest record: loads %u\n\n", s.sleep.repeatMs);
+    if (s.sleep.repeatMs != 1) {
+        printf("FAIL: corrupted record\n");
+        failures++;
+    }
+    return failures;
+}
+
+// the settings as an earlier minor version laid them out, sections of
+// the given sizes, returns the length
+static byte
+layout(const SwitchSettings &settings, byte minor, const byte *sizes,
+       byte *blob)
+{
+    static const byte offsets[] = {
+        offsetof(SwitchSettings, rfm12b),
+        offsetof(SwitchSettings, mpr121),
+        offsetof(SwitchSettings, sleep),
+        offsetof(SwitchSettings, gesture),
+        offsetof(SwitchSettings, calibration),
+        offsetof(SwitchSettings, slider),
+        offsetof(SwitchSettings, battery),
+    };
+    const byte *s = (const byte *)&settings;
+    blob[0] = FIRMWARE_MAJOR_VERSION;
+    blob[1] = minor;
+    byte len = 2;
+    for (byte i = 0; i < sizeof(offsets); ++i) {
+        memcpy(blob + len, s + offsets[i], sizes[i]);
+        len += sizes[i];
+    }
+    return len;
+}
+
+static int
+runMigration()
+{
+    int failures = 0;
+    SwitchSettings old;
+    old.rfm12b.nodeId = 7;
+    old.mpr121.touch = 9;
+    old.sleep.statusInterval = 55;
+    old.sleep.repeatMs = 900;
+    old.gesture.chordMs = 60;
+    old.calibration.margin = 12;
+    old.slider.flags = SLIDER_ENABLED;
+    byte blob[CONFIG_SLOT_SIZE];
+
+    // saved in place by the first version
+    static const byte v1[] = { sizeof(RFM12BSettings), sizeof(MPR121Settings),
+        offsetof(SleepSettings, repeatCoalesce), 0, 0, 0, 0 };
+    EEPROM.erase();
+    byte len = layout(old, 1, v1, blob);
+    for (byte i = 0; i < len; ++i)
+        EEPROM.write(i, blob[i]);
+    SwitchSettings s;
+    ConfigStore store;
+    byte result = boot(s, store);
+    bool ok = result == CONFIG_MIGRATED && s.rfm12b.nodeId == 7 &&
+        s.mpr121.touch == 9 && s.sleep.statusInterval == 55 &&
+        s.sleep.repeatMs == SleepSettings().repeatMs &&
+        s.gesture.chordMs == GestureSettings().chordMs &&
+        s.header.minor == FIRMWARE_MINOR_VERSION;
+    // the firmware commits it in the current layout
+    store.commit(s);
+    ok = ok && boot(s, store) == CONFIG_LOADED && s.rfm12b.nodeId == 7;
+    printf("version 1 saved in place: %s\n", ok ? "migrated" : "FAIL");
+    if (!ok)
+        failures++;
+
+    // a record of version 9, before BatterySettings
+    static const byte v9[] = { sizeof(RFM12BSettings), sizeof(MPR121Settings),
+        sizeof(SleepSettings), offsetof(GestureSettings, enabledHigh),
+        sizeof(CalibrationSettings), sizeof(SliderSettings), 0 };
+    EEPROM.erase();
+    byte record[CONFIG_SLOT_SIZE];
+    len = layout(old, 9, v9, record + CONFIG_HEADER_SIZE);
+    record[0] = CONFIG_MAGIC;
+    record[1] = 3;
+    record[2] = 0;
+    record[3] = len;
+    unsigned int crc = crc16(record, CONFIG_HEADER_SIZE + len);
+    record[CONFIG_HEADER_SIZE + len] = crc & 0xFF;
+    record[CONFIG_HEADER_SIZE + len + 1] = crc >> 8;
+    for (byte i = 0; i < CONFIG_RECORD_SIZE(len); ++i)
+        EEPROM.write(2 * CONFIG_SLOT_SIZE + i, record[i]);
+    result = boot(s, store);
+    ok = result == CONFIG_MIGRATED && s.sleep.repeatMs == 900 &&
+        s.gesture.chordMs == 60 && s.calibration.margin == 12 &&
+        s.slider.flags == SLIDER_ENABLED &&
+        s.battery.cutoffMv == BatterySettings().cutoffMv &&
+        s.gesture.getEnabled() == GESTURE_ALL &&
+        s.gesture.getDoubleTap() == GestureSettings().getDoubleTap() &&
+        store.getSlot() == 2;
+    store.commit(s);
+    ok = ok && store.getSlot() == 3 && store.getSequence() == 4;
+    printf("version 9 record: %s\n", ok ? "migrated" : "FAIL");
+    if (!ok)
+        failures++;
+
+    // another major version is not loaded
+    EEPROM.erase();
+    len = layout(old, FIRMWARE_MINOR_VERSION, v9, blob);
+    blob[0] = FIRMWARE_MAJOR_VERSION + 1;
+    for (byte i = 0; i < len; ++i)
+        EEPROM.write(i, blob[i]);
+    result = boot(s, store);
+    printf("other major version: %s\n",
+            result == CONFIG_NONE ? "defaults" : "FAIL");
+    if (result != CONFIG_NONE)
+        failures++;
+    return failures;
+}
+
+int
+main()
+{
+    int failures = 0;
+    failures += runWear();
+    failures += runPowerLoss();
+    failures += runMigration();
+    return failures ? 1 : 0;
+}
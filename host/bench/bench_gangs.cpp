@@ -0,0 +1,261 @@
+//
+// Multi-gang benchmark: up to four simulated MPR121s (0x5A - 0x5D) share
+// one interrupt line, as on a multi-gang wall plate.  Random gestures are
+// played on all gangs at once through a model of the switch main loop and
+// every gang must report its own gesture.  Reports the radio packets sent
+// when the events finishing together are coalesced into one packet.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <vector>
+#include "TouchSequence.h"
+#include "PowerScheduler.h"
+#include "MPR121Sim.h"
+#include "Scenarios.h"
+
+#define GANGS           4
+#define ROUNDS          500
+
+static const byte mpr121Addr    = 0x5A;
+static const byte mpr121IntPin  = 1;
+
+static MPR121Sim mpr121[GANGS] = {
+    MPR121Sim(mpr121Addr, mpr121IntPin),
+    MPR121Sim(mpr121Addr + 1, mpr121IntPin),
+    MPR121Sim(mpr121Addr + 2, mpr121IntPin),
+    MPR121Sim(mpr121Addr + 3, mpr121IntPin),
+};
+static TouchSequence touch[GANGS] = {
+    TouchSequence(mpr121Addr, mpr121IntPin),
+    TouchSequence(mpr121Addr + 1, mpr121IntPin),
+    TouchSequence(mpr121Addr + 2, mpr121IntPin),
+    TouchSequence(mpr121Addr + 3, mpr121IntPin),
+};
+
+struct GangState {
+    TouchGesture result;        // last gesture sent for the gang
+    byte events;
+};
+
+struct Stats {
+    unsigned long events;
+    unsigned long packets;
+    unsigned long wakes;
+    unsigned long i2c;
+};
+
+// mirrors loop()/serviceGang() in switch/src/firmware.cpp, the touch states
+// are run by the firmware's PowerScheduler
+class NodeModel {
+    public:
+        NodeModel(byte gangs) : gangs(gangs), queued(0), power(gangs) {
+            memset(&stats, 0, sizeof(stats));
+            memset(state, 0, sizeof(state));
+        }
+
+        // runs the loop until time t, waking at the end of sleep periods
+        void runUntil(unsigned long long t) {
+            unsigned long long wakeAt;
+            while (nextWake(wakeAt) && wakeAt <= t) {
+                if (sim::now() < wakeAt)
+                    sim::advance(wakeAt - sim::now());
+                pass();
+            }
+            if (sim::now() < t)
+                sim::advance(t - sim::now());
+        }
+
+        // touch interrupt
+        void interrupt() {
+            pass();
+        }
+
+        // sleeps until all gangs reported their sequence
+        void finish() {
+            unsigned long long wakeAt;
+            while (nextWake(wakeAt)) {
+                if (sim::now() < wakeAt)
+                    sim::advance(wakeAt - sim::now());
+                pass();
+            }
+        }
+
+        void start(byte g) {
+            state[g].result = TOUCH_UNKNOWN;
+            state[g].events = 0;
+        }
+
+        GangState state[GANGS];
+        Stats stats;
+
+    protected:
+        bool nextWake(unsigned long long &wakeAt) {
+            unsigned long at;
+            if (!power.getWakeAt(at))
+                return false;
+            wakeAt = at * 1000ULL;
+            return true;
+        }
+
+        void pass() {
+            unsigned long i2c = sim::i2cStats().transactions;
+            stats.wakes++;
+            for (byte g = 0; g < gangs; ++g)
+                service(g);
+            if (queued && !power.isDueSoon(sim::now() / 1000)) {
+                stats.packets++;
+                queued = 0;
+            }
+            stats.i2c += sim::i2cStats().transactions - i2c;
+        }
+
+        void service(byte g) {
+            unsigned long now = sim::now() / 1000;
+            byte event = power.poll(g, touch[g], now);
+            if (event == EVENT_NONE)
+                return;
+            switch (power.handle(g, event, now)) {
+                case ACTION_REPEAT:
+                    send(g, touch[g].getGesture());
+                    break;
+                case ACTION_FINISH:
+                    send(g, touch[g].getGesture());
+                    touch[g].clear();
+                    break;
+            }
+        }
+
+        void send(byte g, TouchGesture gesture) {
+            state[g].result = gesture;
+            state[g].events++;
+            stats.events++;
+            queued++;
+        }
+
+        byte gangs;
+        byte queued;
+        PowerScheduler power;
+};
+
+struct Step {
+    unsigned long atMs;
+    byte gang;
+    const ScenarioStep *step;
+
+    bool operator<(const Step &o) const { return atMs < o.atMs; }
+};
+
+// plays a random scenario on each gang, started staggerMs apart with up to
+// jitterMs of random delay.  Returns the number of gangs that reported the
+// wrong gesture.
+static int
+runRound(NodeModel &node, byte gangs, unsigned int staggerMs,
+         unsigned int jitterMs)
+{
+    std::vector<Step> steps;
+    const Scenario *played[GANGS];
+    for (byte g = 0; g < gangs; ++g) {
+        // scenarios that end in a touch still held would repeat
+        const Scenario *s;
+        do {
+            s = &scenarios[rand() % NUM_SCENARIOS];
+        } while (s->expected == TOUCH_PROXIMITY);
+        played[g] = s;
+        node.start(g);
+        unsigned long start = g * staggerMs + rand() % (jitterMs + 1);
+        for (byte i = 0; i < s->steps; ++i) {
+            Step step = { start + s->step[i].atMs, g, &s->step[i] };
+            steps.push_back(step);
+        }
+    }
+    std::stable_sort(steps.begin(), steps.end());
+
+    unsigned long long start = sim::now();
+    for (size_t i = 0; i < steps.size(); ++i) {
+        node.runUntil(start + steps[i].atMs * 1000ULL);
+        MPR121Sim &sensor = mpr121[steps[i].gang];
+        if (steps[i].step->down)
+            sensor.touch(steps[i].step->channel);
+        else
+            sensor.release(steps[i].step->channel);
+        for (byte g = 0; g < gangs; ++g) {
+            if (touch[g].isInterrupted()) {
+                node.interrupt();
+                break;
+            }
+        }
+    }
+    node.finish();
+    sim::advance(2000000);
+
+    int wrong = 0;
+    for (byte g = 0; g < gangs; ++g) {
+        if (node.state[g].events != 1 ||
+                node.state[g].result != played[g]->expected)
+            wrong++;
+    }
+    return wrong;
+}
+
+int
+main()
+{
+    MPR121Settings settings;
+    GestureSettings gestures;
+    for (byte g = 0; g < GANGS; ++g) {
+        touch[g].begin(settings);
+        touch[g].setGestures(gestures.getEnabled(), gestures.getDoubleTap());
+        touch[g].setTiming(gestures.chordMs, gestures.swipeMs);
+        touch[g].enableInterrupt();
+    }
+
+    struct Pattern {
+        const char *name;
+        unsigned int staggerMs;
+        unsigned int jitterMs;
+    };
+    static const Pattern patterns[] = {
+        { "together", 0, 0 },
+        { "within 30ms", 0, 30 },
+        { "sweep 100ms", 100, 0 },
+        { "random 1s", 0, 1000 },
+    };
+
+    printf("gangs: %d rounds of random gestures on each gang\n\n", ROUNDS);
+    printf("%-12s %5s %7s %7s %8s %9s %8s %6s\n", "pattern", "gangs",
+            "events", "packets", "saved", "ev/pkt", "i2c/wake", "wrong");
+
+    int failures = 0;
+    srand(1);
+    for (unsigned int p = 0; p < sizeof(patterns) / sizeof(patterns[0]);
+            ++p) {
+        for (byte gangs = 1; gangs <= GANGS; ++gangs) {
+            NodeModel node(gangs);
+            sim::i2cStats().reset();
+            int wrong = 0;
+            for (int r = 0; r < ROUNDS; ++r)
+                wrong += runRound(node, gangs, patterns[p].staggerMs,
+                                  patterns[p].jitterMs);
+            // a packet per gang and event without coalescing
+            const Stats &s = node.stats;
+            bool ok = !wrong && s.packets <= s.events;
+            if (!ok)
+                failures++;
+            printf("%-12s %5d %7lu %7lu %7.1f%% %9.2f %8.1f %6d%s\n",
+                    patterns[p].name, gangs, s.events, s.packets,
+                    100.0 * (s.events - s.packets) / s.events,
+                    (double)s.events / s.packets,
+                    (double)s.i2c / s.wakes, wrong, ok ? "" : "  FAIL");
+        }
+    }
+
+    for (byte g = 0; g < GANGS; ++g) {
+        if (mpr121[g].ignoredWrites) {
+            printf("\n%lu register writes while MPR121 %d was running\n",
+                    mpr121[g].ignoredWrites, g);
+            failures++;
+        }
+    }
+    return failures ? 1 : 0;
+}
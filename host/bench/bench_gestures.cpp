@@ -0,0 +1,204 @@
+//
+// Gesture benchmark: runs each scripted gesture through TouchSequence
+// against the simulated MPR121 and reports the I2C transactions, simulated
+// bus time and host CPU cycles spent in update() and getGesture().
+//
+#include <stdio.h>
+#include "TouchSequence.h"
+#include "MPR121Sim.h"
+#include "Scenarios.h"
+#include "MPR121_registers.h"
+
+#define ITERATIONS  1000
+
+static const byte mpr121Addr    = 0x5A;
+static const byte mpr121IntPin  = 1;
+
+static MPR121Sim mpr121(mpr121Addr, mpr121IntPin);
+static TouchSequence touch(mpr121Addr, mpr121IntPin);
+
+struct Result {
+    TouchGesture gesture;
+    byte electrode;
+    unsigned long updates;
+    unsigned long transactions;
+    unsigned long long busNanos;
+    unsigned long long updateCycles;
+    unsigned long long gestureCycles;
+};
+
+static void
+runScenario(const Scenario &s, Result &r)
+{
+    unsigned long long start = sim::now();
+    touch.enableInterrupt();
+    sim::i2cStats().reset();
+
+    for (byte i = 0; i < s.steps; ++i) {
+        const ScenarioStep &step = s.step[i];
+        unsigned long long at = start + step.atMs * 1000ULL;
+        if (sim::now() < at)
+            sim::advance(at - sim::now());
+        if (step.down)
+            mpr121.touch(step.channel);
+        else
+            mpr121.release(step.channel);
+
+        if (touch.isInterrupted()) {
+            unsigned long long c = sim::cycles();
+            touch.update();
+            r.updateCycles += sim::cycles() - c;
+            r.updates++;
+            touch.enableInterrupt();
+        }
+    }
+
+    unsigned long long c = sim::cycles();
+    r.gesture = touch.getGesture();
+    r.electrode = touch.getLastTouch();
+    r.gestureCycles += sim::cycles() - c;
+    touch.clear();
+
+    r.transactions += sim::i2cStats().transactions;
+    r.busNanos += sim::i2cStats().busNanos;
+}
+
+static void
+reportConfig(const char *name)
+{
+    printf("%-28s %7lu %10.1f\n", name, sim::i2cStats().transactions,
+            sim::i2cStats().busNanos / 1000.0);
+    sim::i2cStats().reset();
+}
+
+// configures the MPR121 and the proximity thresholds of main(), returns
+// the i2c transactions
+static unsigned long
+configure(MPR121Settings &settings)
+{
+    unsigned long transactions = sim::i2cStats().transactions;
+    touch.beginBatch();
+    touch.configure(settings);
+    touch.setTouchThreshold(2, ELECTRODE_PROXIMITY);
+    touch.setReleaseThreshold(1, ELECTRODE_PROXIMITY);
+    touch.commitBatch();
+    return sim::i2cStats().transactions - transactions;
+}
+
+// register write/read costs through the shadow registers, returns the
+// number of registers where the shadow copy disagrees with the MPR121
+static int
+runConfig()
+{
+    printf("%-28s %7s %10s\n", "config", "i2c tx", "bus us");
+
+    sim::i2cStats().reset();
+    touch.setRegister(DBR, touch.getRegister(DBR));
+    reportConfig("rewrite unchanged register");
+
+    touch.setRegister(AFE2, touch.getRegister(AFE2) ^ 0x01);
+    reportConfig("write one register");
+
+    touch.beginBatch();
+    touch.setTouchThreshold(6);
+    touch.setReleaseThreshold(3);
+    touch.commitBatch();
+    reportConfig("batch 26 thresholds");
+
+    byte regs[0x80];
+    touch.getRegisters(0, regs, sizeof(regs));
+    reportConfig("read all registers");
+
+    int mismatches = 0;
+    for (int reg = MPR121_SHADOW_FIRST; reg < 0x80; ++reg) {
+        if (regs[reg] != mpr121.peek(reg)) {
+            printf("shadow mismatch: 0x%02X %02X != %02X\n", reg, regs[reg],
+                    mpr121.peek(reg));
+            mismatches++;
+        }
+    }
+
+    // restore the defaults used by the gestures
+    MPR121Settings settings;
+    touch.beginBatch();
+    touch.setRegister(AFE2, settings.afe2);
+    touch.setTouchThreshold(settings.touch);
+    touch.setReleaseThreshold(settings.release);
+    touch.setTouchThreshold(2, ELECTRODE_PROXIMITY);
+    touch.setReleaseThreshold(1, ELECTRODE_PROXIMITY);
+    touch.commitBatch();
+    sim::i2cStats().reset();
+
+    // settings applied live, as a CONFIGURE does
+    unsigned long autoConfigs = mpr121.autoConfigs;
+    settings.proximityMode = 1;
+    unsigned long unchanged = configure(settings);
+    reportConfig("configure unchanged");
+    settings.debounce ^= 0x01;
+    unsigned long debounce = configure(settings);
+    reportConfig("configure debounce");
+    settings.debounce ^= 0x01;
+    configure(settings);
+    sim::i2cStats().reset();
+    printf("\n");
+    if (unchanged || debounce > 3 || mpr121.autoConfigs != autoConfigs) {
+        printf("FAIL: configure() rewrites unchanged registers\n\n");
+        mismatches++;
+    }
+    return mismatches;
+}
+
+int
+main()
+{
+    MPR121Settings settings;
+    settings.proximityMode = 1;
+
+    sim::i2cStats().reset();
+    touch.begin(settings);
+    GestureSettings gestures;
+    touch.setTiming(gestures.chordMs, gestures.swipeMs);
+    touch.stop();
+    touch.setTouchThreshold(2, ELECTRODE_PROXIMITY);
+    touch.setReleaseThreshold(1, ELECTRODE_PROXIMITY);
+    touch.run();
+    printf("setup: %lu i2c transactions, %.1f us bus time @ %lu Hz\n\n",
+            sim::i2cStats().transactions,
+            sim::i2cStats().busNanos / 1000.0, sim::getI2CClock());
+
+    int failures = 0;
+    failures += runConfig();
+
+    printf("%-18s %-8s %7s %7s %10s %12s %12s\n", "gesture", "result",
+            "updates", "i2c tx", "bus us", "cyc/update", "cyc/gesture");
+
+    for (unsigned int i = 0; i < NUM_SCENARIOS; ++i) {
+        const Scenario &s = scenarios[i];
+        Result r;
+        memset(&r, 0, sizeof(r));
+        bool ok = true;
+        for (int n = 0; n < ITERATIONS; ++n) {
+            runScenario(s, r);
+            ok = ok && r.gesture == s.expected &&
+                (s.electrode == ANY_ELECTRODE || r.electrode == s.electrode);
+            sim::advance(2000000);
+        }
+        if (!ok)
+            failures++;
+
+        printf("%-18s %-8s %7.1f %7.1f %10.1f %12.0f %12.0f\n", s.name,
+                ok ? "ok" : "FAIL",
+                (double)r.updates / ITERATIONS,
+                (double)r.transactions / ITERATIONS,
+                r.busNanos / 1000.0 / ITERATIONS,
+                r.updates ? (double)r.updateCycles / r.updates : 0.0,
+                (double)r.gestureCycles / ITERATIONS);
+    }
+
+    if (mpr121.ignoredWrites) {
+        printf("\n%lu register writes while the MPR121 was running\n",
+                mpr121.ignoredWrites);
+        failures++;
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,231 @@
+//
+// Gesture latency benchmark: replays each scripted gesture through a model
+// of the switch main loop (sleep periods, release timeout, early commit) and
+// reports the time from the final finger movement to the gesture report.
+// Speculative mode lists its first (possibly wrong) report and the final
+// one, negative times are reports made before the finger was lifted.
+//
+#include <stdio.h>
+#include "TouchSequence.h"
+#include "MPR121Sim.h"
+#include "Scenarios.h"
+
+static const byte mpr121Addr    = 0x5A;
+static const byte mpr121IntPin  = 1;
+
+static MPR121Sim mpr121(mpr121Addr, mpr121IntPin);
+static TouchSequence touch(mpr121Addr, mpr121IntPin);
+
+// watchdog sleep periods in ms, indexed by period_t
+static const unsigned int periodMs[] = {
+    15, 30, 60, 120, 250, 500, 1000, 2000, 4000, 8000,
+};
+
+struct GestureSet {
+    const char *name;
+    GestureSettings settings;
+};
+
+struct Report {
+    TouchGesture gesture;       // final gesture after corrections
+    long long at;               // simulated time of the first report
+    long long final;            // simulated time of the last report
+    byte packets;               // TouchEvent + TouchCorrection packets
+    byte corrections;
+};
+
+// mirrors loop() in switch/src/firmware.cpp
+class LoopModel {
+    public:
+        LoopModel(const SleepSettings &sleep, const GestureSettings &gesture) :
+            sleep(sleep), gesture(gesture),
+            sleepPeriod(SLEEP_FOREVER), reported(TOUCH_UNKNOWN)
+        {
+            memset(&report, 0, sizeof(report));
+        }
+
+        // runs the loop until time t, waking on watchdog timeouts
+        void runUntil(unsigned long long t) {
+            while (sleepPeriod != SLEEP_FOREVER &&
+                    wakeAt + periodMs[sleepPeriod] * 1000ULL <= t)
+                wakeUp();
+            if (sim::now() < t)
+                sim::advance(t - sim::now());
+        }
+
+        // touch interrupt
+        void interrupt() {
+            touch.update();
+            if (touch.isTouched())
+                sleepPeriod = (period_t)sleep.touch;
+            else if (touch.isProximity())
+                sleepPeriod = (period_t)sleep.proximity;
+            else
+                sleepPeriod = (period_t)sleep.release;
+            wakeAt = sim::now();
+            touch.enableInterrupt();
+            commitEarly();
+        }
+
+        // sleeps until the sequence has been reported
+        void finish() {
+            while (sleepPeriod != SLEEP_FOREVER)
+                wakeUp();
+        }
+
+        Report report;
+
+    protected:
+        void wakeUp() {
+            wakeAt += periodMs[sleepPeriod] * 1000ULL;
+            sim::advance(wakeAt - sim::now());
+            timeout();
+        }
+
+        void timeout() {
+            if (touch.isTouched() || touch.isProximity()) {
+                touch.update();
+                sleepPeriod = (period_t)sleep.repeat;
+            }
+            else
+                finishGesture();
+        }
+
+        void send(TouchGesture g, bool correction) {
+            if (!report.packets)
+                report.at = sim::now();
+            report.final = sim::now();
+            report.gesture = g;
+            report.packets++;
+            if (correction)
+                report.corrections++;
+        }
+
+        void finishGesture() {
+            TouchGesture g = touch.getGesture();
+            if (reported == TOUCH_UNKNOWN)
+                send(g, false);
+            else if (g != reported)
+                send(g, true);
+            touch.clear();
+            reported = TOUCH_UNKNOWN;
+            sleepPeriod = SLEEP_FOREVER;
+        }
+
+        void commitEarly() {
+            if (touch.isTouched())
+                return;
+            if ((gesture.flags & (GESTURE_EARLY_COMMIT | GESTURE_SPECULATIVE)) &&
+                    touch.isComplete()) {
+                finishGesture();
+                return;
+            }
+            TouchGesture g = touch.getGesture();
+            if ((gesture.flags & GESTURE_SPECULATIVE) &&
+                    reported == TOUCH_UNKNOWN &&
+                    touch.isEnabled(g, touch.getLastTouch())) {
+                send(g, false);
+                reported = g;
+            }
+        }
+
+        SleepSettings sleep;
+        GestureSettings gesture;
+        period_t sleepPeriod;
+        unsigned long long wakeAt;
+        TouchGesture reported;
+};
+
+static Report
+runScenario(const Scenario &s, const GestureSettings &gesture)
+{
+    SleepSettings sleep;
+    LoopModel loop(sleep, gesture);
+    touch.setGestures(gesture.getEnabled(), gesture.getDoubleTap());
+    touch.setTiming(gesture.chordMs, gesture.swipeMs);
+    touch.enableInterrupt();
+
+    unsigned long long start = sim::now();
+    for (byte i = 0; i < s.steps; ++i) {
+        const ScenarioStep &step = s.step[i];
+        loop.runUntil(start + step.atMs * 1000ULL);
+        if (step.down)
+            mpr121.touch(step.channel);
+        else
+            mpr121.release(step.channel);
+        if (touch.isInterrupted())
+            loop.interrupt();
+    }
+    unsigned long long end = sim::now();
+    loop.finish();
+
+    // report times relative to the last finger movement
+    loop.report.at -= (long long)end;
+    loop.report.final -= (long long)end;
+    sim::advance(2000000);
+    return loop.report;
+}
+
+static GestureSettings
+gestureSet(unsigned int enabled, unsigned int doubleTapElectrodes)
+{
+    GestureSettings g;
+    g.setEnabled(enabled);
+    g.setDoubleTap(doubleTapElectrodes);
+    return g;
+}
+
+int
+main()
+{
+    MPR121Settings settings;
+    settings.proximityMode = 1;
+    touch.begin(settings);
+    touch.setTouchThreshold(2, ELECTRODE_PROXIMITY);
+    touch.setReleaseThreshold(1, ELECTRODE_PROXIMITY);
+
+    const GestureSet sets[] = {
+        { "all gestures", gestureSet(GESTURE_ALL, 0xFFF) },
+        { "no double tap", gestureSet(
+                GESTURE_ALL & ~GESTURE_BIT(TOUCH_DOUBLE_TAP), 0) },
+        { "no swipes, double tap on center", gestureSet(
+                GESTURE_ALL & ~GESTURE_SWIPES, 1 << ELECTRODE_CENTER) },
+        { "taps only", gestureSet(GESTURE_BIT(TOUCH_TAP), 0) },
+    };
+
+    int failures = 0;
+    for (unsigned int n = 0; n < sizeof(sets) / sizeof(sets[0]); ++n) {
+        printf("%s\n", sets[n].name);
+        printf("%-18s %10s %10s %22s\n", "", "timeout", "early",
+                "speculative");
+        printf("%-18s %10s %10s %7s %7s %7s\n", "gesture", "ms", "ms",
+                "first", "final", "fixes");
+
+        for (unsigned int i = 0; i < NUM_SCENARIOS; ++i) {
+            const Scenario &s = scenarios[i];
+            GestureSettings g = sets[n].settings;
+
+            g.flags = 0;
+            Report base = runScenario(s, g);
+            g.flags = GESTURE_EARLY_COMMIT;
+            Report early = runScenario(s, g);
+            g.flags = GESTURE_SPECULATIVE;
+            Report spec = runScenario(s, g);
+
+            // reporting early must not change an enabled gesture
+            bool ok = base.gesture == s.expected;
+            if (g.getEnabled() & GESTURE_BIT(s.expected))
+                ok = ok && early.gesture == s.expected &&
+                    early.packets == 1 && spec.gesture == s.expected;
+            if (!ok)
+                failures++;
+
+            printf("%-18s %10.0f %10.0f %7.0f %7.0f %7d%s\n", s.name,
+                    base.final / 1000.0, early.final / 1000.0,
+                    spec.at / 1000.0, spec.final / 1000.0, spec.corrections,
+                    ok ? "" : "  FAIL");
+        }
+        printf("\n");
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,332 @@
+//
+// Power state benchmark: plays the gesture scenarios and a few held fingers
+// on a simulated MPR121 through the firmware's PowerScheduler, with status
+// reports and ACK waits in between, and accounts the time the MCU spends in
+// each sleep mode.  Every stretch is checked against the power state table:
+// the MCU must power down as soon as the period of the last touch state
+// ended, wake up only from the wake sources of its state and listen for an
+// ACK at most SleepSettings::replyWakeLock.
+//
+#include <stdio.h>
+#include "TouchSequence.h"
+#include "PowerScheduler.h"
+#include "RepeatCoalescer.h"
+#include "MPR121Sim.h"
+#include "Scenarios.h"
+
+// idle time after each gesture, longer than any touch state period
+#define GAP_MS          3000
+// status interval of the benchmark, the firmware sends one an hour
+#define STATUS_MS       7000
+// nominal time awake to sample Vcc and send a packet, and the round trip of
+// an ACK
+#define SEND_MS         3
+#define ACK_RTT_MS      8
+// every nth ACK is lost, the MCU listens until replyWakeLock passed
+#define ACK_LOSS        5
+
+static const byte mpr121Addr    = 0x5A;
+static const byte mpr121IntPin  = 1;
+
+static MPR121Sim mpr121(mpr121Addr, mpr121IntPin);
+static TouchSequence touch(mpr121Addr, mpr121IntPin);
+
+#define C ELECTRODE_CENTER
+#define B ELECTRODE_BOTTOM
+#define T ELECTRODE_TOP
+#define P ELECTRODE_PROXIMITY
+
+// held fingers, reported with repeat events or slider samples
+static const Scenario holds[] = {
+    { "hold center 2s", TOUCH_UNKNOWN, ANY_ELECTRODE, 2,
+        { { 0, C, true }, { 2000, C, false } } },
+    { "hold prox 3s", TOUCH_UNKNOWN, ANY_ELECTRODE, 2,
+        { { 0, P, true }, { 3000, P, false } } },
+    { "slide up 1.5s", TOUCH_UNKNOWN, ANY_ELECTRODE, 6,
+        { { 0, B, true }, { 300, C, true }, { 400, B, false },
+          { 700, T, true }, { 800, C, false }, { 1500, T, false } } },
+};
+#define NUM_HOLDS (sizeof(holds) / sizeof(holds[0]))
+
+#undef C
+#undef B
+#undef T
+#undef P
+
+struct Stats {
+    unsigned long long modeUs[3];
+    unsigned long wakes;
+    unsigned long packets;
+    unsigned long events;
+    unsigned long repeats;      // repeat ticks and slider samples
+    unsigned long long excessUs;
+    unsigned long wrongWakes;
+    unsigned long longAcks;
+};
+
+// mirrors loop()/serviceGang() in switch/src/firmware.cpp for one gang
+class NodeModel {
+    public:
+        NodeModel(const SliderSettings &slider) :
+            power(1), result(TOUCH_UNKNOWN), slider(slider), queued(0),
+            ack(false), acks(0), neededUntil(0)
+        {
+            memset(&stats, 0, sizeof(stats));
+            power.setPeriods(sleep, slider);
+            statusAt = sim::now() + STATUS_MS * 1000ULL;
+        }
+
+        // sleeps like sleepTracked() until time t, waking at the end of the
+        // touch state periods and for the status
+        void runUntil(unsigned long long t) {
+            for (;;) {
+                unsigned long long wake = statusAt;
+                byte source = WAKE_RADIO;
+                unsigned long at;
+                if (power.getMode() == MODE_STANDBY && power.getWakeAt(at)) {
+                    // the first watchdog slice ending after the period
+                    unsigned long long slice = WDT_SLICE_MS * 1000ULL;
+                    unsigned long long w = sim::now();
+                    if (at * 1000ULL > w)
+                        w += (at * 1000ULL - w + slice - 1) / slice * slice;
+                    if (w < wake) {
+                        wake = w;
+                        source = WAKE_WATCHDOG;
+                    }
+                }
+                if (wake > t)
+                    break;
+                sleepUntil(wake);
+                pass(source);
+            }
+            sleepUntil(t);
+        }
+
+        // touch interrupt
+        void interrupt() {
+            pass(WAKE_TOUCH);
+        }
+
+        void start() {
+            result = TOUCH_UNKNOWN;
+        }
+
+        PowerScheduler power;
+        Stats stats;
+        TouchGesture result;        // first gesture reported
+
+    protected:
+        void sleepUntil(unsigned long long t) {
+            if (t <= sim::now())
+                return;
+            byte mode = power.getMode();
+            stats.modeUs[mode] += t - sim::now();
+            // the period of the touch state plus a watchdog slice needs
+            // standby, anything past it is spent in a higher power mode
+            // than needed
+            if (mode != MODE_POWER_DOWN && t > neededUntil)
+                stats.excessUs += t - (neededUntil > sim::now() ?
+                                       neededUntil : sim::now());
+            sim::advance(t - sim::now());
+        }
+
+        void awake(unsigned int ms) {
+            stats.modeUs[power.getMode()] += ms * 1000ULL;
+            sim::advance(ms * 1000ULL);
+        }
+
+        void pass(byte source) {
+            stats.wakes++;
+            if (!(power.getWakes() & source))
+                stats.wrongWakes++;
+
+            if (source == WAKE_RADIO) {
+                byte previous = power.enter(POWER_STATUS);
+                awake(SEND_MS);
+                stats.packets++;
+                waitForReply();
+                power.enter(previous);
+                statusAt += STATUS_MS * 1000ULL;
+            }
+
+            unsigned long now = sim::now() / 1000;
+            service(now);
+            if (queued && !power.isDueSoon(now))
+                send();
+        }
+
+        void service(unsigned long now) {
+            byte event = power.poll(0, touch, now);
+            if (event == EVENT_NONE)
+                return;
+            byte action = power.handle(0, event, now);
+            unsigned long at;
+            if (power.getWakeAt(at))
+                neededUntil = (at + WDT_SLICE_MS) * 1000ULL;
+
+            switch (action) {
+                case ACTION_CHANGE:
+                    if (repeats.flush())
+                        queue(false);
+                    if (!touch.isTouched() &&
+                            (gesture.flags & GESTURE_EARLY_COMMIT) &&
+                            touch.isComplete())
+                        finish(now);
+                    break;
+                case ACTION_REPEAT:
+                    stats.repeats++;
+                    if (repeats.tick(now, sleep))
+                        queue(false);
+                    break;
+                case ACTION_SLIDE:
+                    // a packet per SliderSettings::samples
+                    if (++stats.repeats % slider.samples == 0)
+                        queue(false);
+                    break;
+                case ACTION_FINISH:
+                    finish(now);
+                    break;
+            }
+        }
+
+        void finish(unsigned long now) {
+            if (result == TOUCH_UNKNOWN)
+                result = touch.getGesture();
+            if (repeats.flush())
+                queue(false);
+            stats.events++;
+            queue(true);
+            touch.clear();
+            power.handle(0, EVENT_DONE, now);
+        }
+
+        void queue(bool needsAck) {
+            queued++;
+            ack |= needsAck;
+        }
+
+        void send() {
+            awake(SEND_MS);
+            stats.packets++;
+            if (ack)
+                waitForReply();
+            queued = 0;
+            ack = false;
+        }
+
+        void waitForReply() {
+            byte previous = power.enter(POWER_AWAITING_ACK);
+            unsigned int ms = ++acks % ACK_LOSS ? ACK_RTT_MS :
+                sleep.replyWakeLock;
+            awake(ms);
+            if (ms > sleep.replyWakeLock)
+                stats.longAcks++;
+            if (!(power.getWakes() & WAKE_ACK))
+                stats.wrongWakes++;
+            power.enter(previous);
+        }
+
+        SleepSettings sleep;
+        GestureSettings gesture;
+        SliderSettings slider;
+        RepeatCoalescer repeats;
+        byte queued;
+        bool ack;
+        unsigned long acks;
+        unsigned long long statusAt;
+        unsigned long long neededUntil;
+};
+
+// plays a scenario and idles for GAP_MS, returns false if the node did not
+// return to POWER_IDLE
+static bool
+play(NodeModel &node, const Scenario &s)
+{
+    node.start();
+    unsigned long long start = sim::now();
+    for (byte i = 0; i < s.steps; ++i) {
+        node.runUntil(start + s.step[i].atMs * 1000ULL);
+        if (s.step[i].down)
+            mpr121.touch(s.step[i].channel);
+        else
+            mpr121.release(s.step[i].channel);
+        if (touch.isInterrupted())
+            node.interrupt();
+    }
+    node.runUntil(sim::now() + GAP_MS * 1000ULL);
+    return node.power.getState() == POWER_IDLE;
+}
+
+static int
+run(const char *name, const SliderSettings &slider)
+{
+    NodeModel node(slider);
+    int failures = 0;
+    printf("%s\n", name);
+    printf("%-18s %6s %5s %7s %10s %9s %9s %8s\n", "scenario", "result",
+            "wakes", "repeats", "standby ms", "awake ms", "excess ms",
+            "packets");
+
+    for (unsigned int i = 0; i < NUM_SCENARIOS + NUM_HOLDS; ++i) {
+        bool hold = i >= NUM_SCENARIOS;
+        const Scenario &s = hold ? holds[i - NUM_SCENARIOS] : scenarios[i];
+        Stats before = node.stats;
+        bool idle = play(node, s);
+        const Stats &after = node.stats;
+
+        unsigned long repeats = after.repeats - before.repeats;
+        bool ok = idle && after.excessUs == before.excessUs &&
+            after.wrongWakes == before.wrongWakes &&
+            after.longAcks == before.longAcks &&
+            (hold ? repeats > 0 : node.result == s.expected);
+        if (!ok)
+            failures++;
+        printf("%-18s %6s %5lu %7lu %10.0f %9.0f %9.1f %8lu%s\n", s.name,
+                hold ? "held" : node.result == s.expected ? "ok" : "wrong",
+                after.wakes - before.wakes, repeats,
+                (after.modeUs[MODE_STANDBY] - before.modeUs[MODE_STANDBY]) /
+                    1000.0,
+                (after.modeUs[MODE_AWAKE] - before.modeUs[MODE_AWAKE]) /
+                    1000.0,
+                (after.excessUs - before.excessUs) / 1000.0,
+                after.packets - before.packets,
+                !idle ? "  NOT IDLE" : ok ? "" : "  FAIL");
+    }
+
+    const Stats &s = node.stats;
+    double total = s.modeUs[0] + s.modeUs[1] + s.modeUs[2];
+    printf("time: %.2f%% power down, %.2f%% standby, %.2f%% awake; "
+            "wrong wakes %lu, long ACK waits %lu\n\n",
+            100.0 * s.modeUs[MODE_POWER_DOWN] / total,
+            100.0 * s.modeUs[MODE_STANDBY] / total,
+            100.0 * s.modeUs[MODE_AWAKE] / total, s.wrongWakes, s.longAcks);
+    return failures;
+}
+
+int
+main()
+{
+    MPR121Settings settings;
+    settings.proximityMode = 1;
+    GestureSettings gestures;
+    touch.begin(settings);
+    touch.beginBatch();
+    touch.setTouchThreshold(2, ELECTRODE_PROXIMITY);
+    touch.setReleaseThreshold(1, ELECTRODE_PROXIMITY);
+    touch.commitBatch();
+    touch.setGestures(gestures.getEnabled(), gestures.getDoubleTap());
+    touch.setTiming(gestures.chordMs, gestures.swipeMs);
+    touch.enableInterrupt();
+
+    SliderSettings slider;
+    int failures = run("defaults", slider);
+    slider.flags |= SLIDER_ENABLED;
+    failures += run("slider enabled", slider);
+
+    if (mpr121.ignoredWrites) {
+        printf("%lu register writes while the MPR121 was running\n",
+                mpr121.ignoredWrites);
+        failures++;
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,155 @@
+//
+// Repeat benchmark: holds the center electrode of a simulated MPR121 and
+// runs the repeat ticks through the firmware's PowerScheduler (repeat
+// acceleration) and RepeatCoalescer (ticks per TouchEvent).  Reports the
+// radio packets against the ticks they carry, the tick rate reached at the
+// end of the hold and the time to the first repeat event.
+//
+#include <stdio.h>
+#include "TouchSequence.h"
+#include "PowerScheduler.h"
+#include "RepeatCoalescer.h"
+#include "MPR121Sim.h"
+
+static const byte mpr121Addr    = 0x5A;
+static const byte mpr121IntPin  = 1;
+
+static MPR121Sim mpr121(mpr121Addr, mpr121IntPin);
+static TouchSequence touch(mpr121Addr, mpr121IntPin);
+
+struct Result {
+    unsigned long ticks;
+    unsigned long sent;         // ticks carried by the packets
+    unsigned long packets;
+    unsigned long wakes;
+    unsigned long firstMs;      // touch to the first repeat packet
+    double lastRate;            // ticks per second in the last second
+};
+
+static Result
+hold(const SleepSettings &sleep, unsigned int holdMs)
+{
+    Result r;
+    memset(&r, 0, sizeof(r));
+    PowerScheduler power(1);
+    power.setPeriods(sleep, SliderSettings());
+    RepeatCoalescer repeats;
+    unsigned long start = sim::now() / 1000;
+    unsigned long lastTicks[64];
+    unsigned long count = 0;
+
+    mpr121.touch(ELECTRODE_CENTER);
+    bool released = false;
+    for (;;) {
+        unsigned long now = sim::now() / 1000;
+        byte event = power.poll(0, touch, now);
+        if (event != EVENT_NONE) {
+            r.wakes++;
+            byte n = 0;
+            switch (power.handle(0, event, now)) {
+                case ACTION_REPEAT:
+                    r.ticks++;
+                    lastTicks[count++ % 64] = now;
+                    n = repeats.tick(now, sleep);
+                    break;
+                case ACTION_CHANGE:
+                case ACTION_FINISH:
+                    n = repeats.flush();
+                    break;
+            }
+            if (n) {
+                if (!r.sent)
+                    r.firstMs = now - start;
+                r.sent += n;
+                r.packets++;
+            }
+            if (power.isIdle(0)) {
+                touch.clear();
+                break;
+            }
+        }
+
+        // sleep to the end of the period or the release
+        unsigned long at;
+        unsigned long long next = (start + holdMs) * 1000ULL;
+        if (power.getWakeAt(at) && (released || at * 1000ULL < next))
+            next = at * 1000ULL;
+        if (next > sim::now())
+            sim::advance(next - sim::now());
+        if (!released && sim::now() >= (start + holdMs) * 1000ULL) {
+            mpr121.release(ELECTRODE_CENTER);
+            released = true;
+        }
+    }
+
+    // ticks within the last second of the hold
+    unsigned long n = 0;
+    for (unsigned long i = 0; i < count && i < 64; ++i) {
+        if (lastTicks[(count - 1 - i) % 64] + 1000 > start + holdMs)
+            n++;
+    }
+    r.lastRate = n;
+    return r;
+}
+
+int
+main()
+{
+    MPR121Settings settings;
+    GestureSettings gestures;
+    touch.begin(settings);
+    touch.setGestures(gestures.getEnabled(), gestures.getDoubleTap());
+    touch.setTiming(gestures.chordMs, gestures.swipeMs);
+    touch.enableInterrupt();
+
+    struct Variant {
+        const char *name;
+        byte coalesce;
+        unsigned int ms;
+        byte accel;
+        byte fastest;
+    };
+    SleepSettings defaults;
+    const Variant variants[] = {
+        { "every tick", 1, 0, 0, defaults.repeat },
+        { "defaults", defaults.repeatCoalesce, defaults.repeatMs,
+          defaults.repeatAccel, defaults.repeatFastest },
+        { "coalesce only", defaults.repeatCoalesce, defaults.repeatMs, 0,
+          defaults.repeat },
+        { "accel only", 1, 0, defaults.repeatAccel, defaults.repeatFastest },
+        { "fast 30ms", 16, 500, 3, SLEEP_30MS },
+    };
+    static const unsigned int holds[] = { 1000, 3000, 10000 };
+
+    printf("repeat: held center, repeat %ums, first repeat after %ums\n\n",
+            WDT_SLICE_MS << defaults.repeat, WDT_SLICE_MS << defaults.touch);
+    printf("%-14s %6s %6s %7s %6s %7s %9s %9s\n", "mode", "hold", "ticks",
+            "packets", "wakes", "tick/s", "first ms", "ticks/pkt");
+
+    int failures = 0;
+    Result every[sizeof(holds) / sizeof(holds[0])];
+    for (unsigned int v = 0; v < sizeof(variants) / sizeof(variants[0]); ++v) {
+        SleepSettings sleep;
+        sleep.repeatCoalesce = variants[v].coalesce;
+        sleep.repeatMs = variants[v].ms;
+        sleep.repeatAccel = variants[v].accel;
+        sleep.repeatFastest = variants[v].fastest;
+        for (unsigned int h = 0; h < sizeof(holds) / sizeof(holds[0]); ++h) {
+            Result r = hold(sleep, holds[h]);
+            if (!v)
+                every[h] = r;
+            // no tick is lost and the first one is not held back, the
+            // defaults send fewer packets than one per tick
+            bool ok = r.sent == r.ticks && r.firstMs == every[h].firstMs &&
+                (v != 1 || holds[h] < 3000 || r.packets < every[h].packets);
+            if (!ok)
+                failures++;
+            printf("%-14s %5.1fs %6lu %7lu %6lu %7.0f %9lu %9.2f%s\n",
+                    variants[v].name, holds[h] / 1000.0, r.ticks, r.packets,
+                    r.wakes, r.lastRate, r.firstMs,
+                    r.packets ? (double)r.sent / r.packets : 0.0,
+                    ok ? "" : "  FAIL");
+        }
+    }
+    return failures ? 1 : 0;
+}
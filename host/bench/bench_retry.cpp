@@ -0,0 +1,215 @@
+//
+// Retransmit benchmark: sends touch events over a modelled lossy link as
+// sendOutbox() does with the EventQueue, the hub decoding the packets and
+// dropping the events seen before with the SequenceFilter.  Reports the
+// events lost and the delay of the delivered ones against sending each
+// event once.  The switch powers on again three times during each run,
+// twice with a single event in between, every event must reach the hub at
+// most once.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include "EventQueue.h"
+#include "ConfigStore.h"
+#include "SequenceFilter.h"
+#include "CompactCodec.h"
+#include "TouchSequence.h"
+
+#define EVENTS          5000
+#define NODE_ID         2
+// listening for the ACK that does not come
+#define ACK_WINDOW_MS   12
+
+struct Link {
+    const char *name;
+    // packets and ACKs lost independently, and all but a few of them
+    // while a burst of burstMs every periodMs lasts
+    unsigned int lostPercent;
+    unsigned int burstMs;
+    unsigned int periodMs;
+};
+
+struct Result {
+    unsigned long lost;
+    unsigned long duplicates;
+    unsigned long sends;
+    // delays of the delivered events
+    unsigned long p99Ms;
+    unsigned long maxMs;
+};
+
+static bool
+isLost(const Link &link, unsigned long now)
+{
+    if (link.periodMs && now % link.periodMs < link.burstMs)
+        return rand() % 100 < 90;
+    return (unsigned int)(rand() % 100) < link.lostPercent;
+}
+
+static TouchEvent
+event(unsigned int id)
+{
+    TouchEvent e;
+    e.gesture = TOUCH_TAP;
+    e.electrode = ELECTRODE_TOP;
+    // the bench numbers the events in the fields the hub passes on
+    e.repeat = id & 0xFF;
+    e.gang = id >> 8;
+    return e;
+}
+
+struct Hub {
+    SequenceFilter filter;
+    unsigned long createdAt[EVENTS];
+    unsigned long delay[EVENTS];
+    bool delivered[EVENTS];
+    unsigned long duplicates;
+
+    Hub() : duplicates(0) {
+        memset(delivered, 0, sizeof(delivered));
+    }
+
+    // handles a packet as handleIncomingPacket() does
+    void receive(const byte *compact, byte len, unsigned long now) {
+        byte data[RF12_MAXDATA];
+        byte datalen = compactDecode(compact, len, data, sizeof(data));
+        byte offset = 0;
+        filter.start();
+        while (offset + sizeof(SwitchPacket) <= datalen) {
+            SwitchPacket *header = (SwitchPacket *)(data + offset);
+            if (header->type == SwitchPacket::SEQUENCE)
+                filter.sequence(NODE_ID, *(SwitchSequence *)header);
+            else if (header->type == SwitchPacket::TOUCH_EVENT &&
+                     filter.accept(NODE_ID)) {
+                TouchEvent *e = (TouchEvent *)header;
+                unsigned int id = e->repeat | e->gang << 8;
+                if (delivered[id])
+                    duplicates++;
+                delivered[id] = true;
+                delay[id] = now - createdAt[id];
+            }
+            offset += header->len;
+        }
+    }
+};
+
+// sends the queued events at now, returns false if no ACK arrived
+static bool
+send(EventQueue &queue, Hub &hub, const Link &link, unsigned long now,
+     Result &r)
+{
+    byte buf[RF12_MAXDATA];
+    byte compact[RF12_MAXDATA];
+    byte len = queue.fill(buf);
+    byte n = compactEncode(buf, len, compact, sizeof(compact));
+    r.sends++;
+    bool received = !isLost(link, now);
+    if (received)
+        hub.receive(compact, n, now);
+    if (received && !isLost(link, now)) {
+        queue.acked();
+        return true;
+    }
+    queue.missed(now + ACK_WINDOW_MS);
+    return false;
+}
+
+static int
+compareDelay(const void *a, const void *b)
+{
+    unsigned long x = *(const unsigned long *)a;
+    unsigned long y = *(const unsigned long *)b;
+    return x < y ? -1 : x > y;
+}
+
+static Result
+run(const Link &link, bool retry)
+{
+    static Hub hub;
+    hub = Hub();
+    Result r;
+    memset(&r, 0, sizeof(r));
+    EventQueue queue;
+    unsigned long now = 0;
+    srand(1);
+    for (unsigned int id = 0; id < EVENTS; ++id) {
+        unsigned long at = now + 300 + rand() % 5000;
+        // the retries due before the next touch, the switch wakes for them
+        unsigned long retryAt;
+        while (retry && queue.getRetryAt(retryAt) &&
+               (long)(retryAt - at) < 0)
+            send(queue, hub, link, retryAt, r);
+        now = at;
+        // a power on loses the queue and starts the numbering over
+        if (id == 100 || id == 101 || id == EVENTS / 2) {
+            queue = EventQueue();
+            queue.begin(ConfigStore::countBoot(), true);
+        }
+        hub.createdAt[id] = now;
+        queue.add(event(id));
+        send(queue, hub, link, now, r);
+        if (!retry)
+            queue.acked();
+    }
+    unsigned long retryAt;
+    while (retry && queue.getRetryAt(retryAt))
+        send(queue, hub, link, retryAt, r);
+
+    static unsigned long delays[EVENTS];
+    unsigned int n = 0;
+    for (unsigned int id = 0; id < EVENTS; ++id) {
+        if (hub.delivered[id])
+            delays[n++] = hub.delay[id];
+        else
+            r.lost++;
+    }
+    qsort(delays, n, sizeof(delays[0]), compareDelay);
+    r.p99Ms = n ? delays[n * 99 / 100] : 0;
+    r.maxMs = n ? delays[n - 1] : 0;
+    r.duplicates = hub.duplicates;
+    return r;
+}
+
+int
+main()
+{
+    static const Link links[] = {
+        { "quiet", 0, 0, 0 },
+        { "busy", 5, 0, 0 },
+        { "lossy", 20, 0, 0 },
+        { "bursts", 2, 400, 20000 },
+    };
+
+    printf("retry: %d events, retries from %ums, %u sends at most\n\n",
+            EVENTS, EVENT_RETRY_MS, EVENT_RETRY_MAX);
+    printf("%-8s %-6s %7s %7s %8s %8s %6s\n", "link", "retry", "lost",
+            "lost %", "p99 ms", "max ms", "sends");
+
+    int failures = 0;
+    // the backoff of all retries plus their jitter and ACK windows
+    unsigned long longest = 0;
+    for (byte i = 1; i < EVENT_RETRY_MAX; ++i)
+        longest += ((unsigned long)EVENT_RETRY_MS << (i - 1)) +
+                   EVENT_RETRY_MS + ACK_WINDOW_MS;
+    for (unsigned int l = 0; l < sizeof(links) / sizeof(links[0]); ++l) {
+        Result once = run(links[l], false);
+        Result r = run(links[l], true);
+        // retries lose a tenth of the events sending each once does, and
+        // deliver each event once within the backoff
+        bool ok = !r.duplicates && r.lost * 10 <= once.lost &&
+            r.maxMs <= longest;
+        if (!ok)
+            failures++;
+        const Result *results[] = { &once, &r };
+        for (int i = 0; i < 2; ++i) {
+            const Result &x = *results[i];
+            printf("%-8s %-6s %7lu %6.2f%% %8lu %8lu %6lu%s\n",
+                    i ? "" : links[l].name, i ? "yes" : "no", x.lost,
+                    100.0 * x.lost / EVENTS, x.p99Ms, x.maxMs, x.sends,
+                    i && !ok ? "  FAIL" : "");
+        }
+        if (r.duplicates)
+            printf("FAIL: %lu events delivered twice\n", r.duplicates);
+    }
+    return failures ? 1 : 0;
+}
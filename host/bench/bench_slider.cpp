@@ -0,0 +1,197 @@
+//
+// Slider benchmark: moves a simulated finger along the vertical electrodes
+// (bottom, center, top) and samples its position with
+// TouchSequence::getSliderPosition() the way the firmware does while
+// sliding, packing the positions with SliderStream.  Reports the radio
+// packets per second against one repeat TouchEvent per SleepSettings::repeat
+// period, and the error of the reported positions.
+//
+#include <stdio.h>
+#include <math.h>
+#include "TouchSequence.h"
+#include "SliderStream.h"
+#include "MPR121Sim.h"
+
+// nominal length of the shortest watchdog sleep, see firmware.cpp
+#define WDT_SLICE_MS    16
+
+static const byte mpr121Addr    = 0x5A;
+static const byte mpr121IntPin  = 1;
+
+static MPR121Sim mpr121(mpr121Addr, mpr121IntPin);
+static TouchSequence touch(mpr121Addr, mpr121IntPin);
+
+// a finger held on the slider: ms since the start and the position (0 at
+// the bottom electrode, 1 at the top) it moves to by then
+struct Waypoint {
+    unsigned int atMs;
+    double position;
+};
+
+static const Waypoint path[] = {
+    { 0, 0.0 },
+    { 600, 0.0 },       // hold at the bottom
+    { 2100, 1.0 },      // slide up
+    { 3100, 1.0 },      // hold at the top
+    { 3800, 0.5 },      // slide down to the center
+    { 4800, 0.5 },
+};
+#define PATH_MS     4800
+
+static double
+fingerAt(unsigned int ms)
+{
+    for (unsigned int i = 1; i < sizeof(path) / sizeof(path[0]); ++i) {
+        if (ms > path[i].atMs)
+            continue;
+        const Waypoint &a = path[i - 1], &b = path[i];
+        return a.position + (b.position - a.position) *
+            (ms - a.atMs) / (b.atMs - a.atMs);
+    }
+    return path[sizeof(path) / sizeof(path[0]) - 1].position;
+}
+
+// the signal of an electrode falls off linearly to the next electrode
+static void
+placeFinger(double x)
+{
+    const byte slider[3] = { ELECTRODE_BOTTOM, ELECTRODE_CENTER,
+                             ELECTRODE_TOP };
+    for (byte i = 0; i < 3; ++i) {
+        double d = fabs(x - i * 0.5) / 0.5;
+        mpr121.setDelta(slider[i], d < 1 ? (uint16_t)(MPR121Sim::TOUCH_DELTA *
+                    (1 - d) + 0.5) : 0);
+    }
+}
+
+struct Result {
+    unsigned long packets;
+    unsigned long bytes;
+    unsigned long samples;
+    double rmsError;
+    double maxError;
+    double busUsPerSample;
+};
+
+static Result
+run(const SliderSettings &cfg, byte noise)
+{
+    Result r;
+    memset(&r, 0, sizeof(r));
+    SliderStream stream;
+    unsigned int periodMs = WDT_SLICE_MS << cfg.period;
+    mpr121.setNoise(noise);
+    sim::i2cStats().reset();
+
+    double sumSq = 0;
+    unsigned long errors = 0;
+    double truth[SLIDER_MAX_DELTAS + 1];
+    stream.begin(0, cfg.period);
+    for (unsigned int t = 0; t <= PATH_MS; t += periodMs) {
+        double x = fingerAt(t);
+        placeFinger(x);
+        sim::advance(periodMs * 1000ULL);
+        touch.update();
+
+        int position = touch.getSliderPosition(cfg.minSignal);
+        bool last = t + periodMs > PATH_MS;
+        if (position >= 0) {
+            // samples <= SLIDER_MAX_DELTAS + 1, the packet never overflows
+            stream.add(stream.smooth(position, cfg.smoothing), cfg.deadband);
+            truth[stream.packet.samples - 1] = x * 255;
+            r.samples++;
+        }
+        if (last)
+            stream.end();
+        if (stream.packet.samples < cfg.samples && !last)
+            continue;
+
+        // the receiver side
+        if (stream.hasNews()) {
+            r.packets++;
+            r.bytes += stream.packet.len;
+            int p = stream.packet.position;
+            for (byte i = 0; i < stream.packet.samples; ++i) {
+                if (i)
+                    p += stream.packet.delta[i - 1];
+                double e = fabs(p - truth[i]);
+                sumSq += e * e;
+                errors++;
+                if (e > r.maxError)
+                    r.maxError = e;
+            }
+        }
+        stream.next();
+    }
+    r.rmsError = errors ? sqrt(sumSq / errors) : 0;
+    r.busUsPerSample = sim::i2cStats().busNanos / 1000.0 /
+        (PATH_MS / periodMs + 1);
+    return r;
+}
+
+int
+main()
+{
+    MPR121Settings settings;
+    touch.begin(settings);
+    SleepSettings sleep;
+    double seconds = PATH_MS / 1000.0;
+    double repeats = PATH_MS / (double)(WDT_SLICE_MS << sleep.repeat);
+
+    printf("slider: %.1fs slide, repeat events: %.1f packets/s, no position\n\n",
+            seconds, repeats / seconds);
+    printf("%-6s %6s %7s %8s %6s %9s %8s %8s %7s %7s\n", "noise", "period",
+            "samples", "deadband", "smooth", "pkts/s", "B/pkt", "pos/s", "rms",
+            "max");
+
+    struct Variant {
+        byte period;
+        byte samples;
+        byte deadband;
+        byte smoothing;
+        byte noise;
+    };
+    SliderSettings defaults;
+    static const Variant variants[] = {
+        // the defaults must send fewer packets than the repeat events
+        { defaults.period, defaults.samples, defaults.deadband,
+          defaults.smoothing, 0 },
+        { defaults.period, defaults.samples, defaults.deadband,
+          defaults.smoothing, 2 },
+        { SLEEP_30MS, 8, 0, 0, 0 },
+        { SLEEP_30MS, 4, 4, 1, 0 },
+        { SLEEP_30MS, 16, 4, 1, 0 },
+        { SLEEP_15MS, 16, 4, 1, 0 },
+        { SLEEP_60MS, 8, 4, 1, 0 },
+        { SLEEP_30MS, 8, 2, 0, 2 },
+        { SLEEP_30MS, 8, 4, 2, 2 },
+        { SLEEP_30MS, 8, 4, 1, 4 },
+        { SLEEP_30MS, 8, 8, 1, 4 },
+    };
+
+    int failures = 0;
+    for (unsigned int i = 0; i < sizeof(variants) / sizeof(variants[0]);
+            ++i) {
+        SliderSettings cfg;
+        cfg.flags = SLIDER_ENABLED;
+        cfg.period = variants[i].period;
+        cfg.samples = variants[i].samples;
+        cfg.deadband = variants[i].deadband;
+        cfg.smoothing = variants[i].smoothing;
+        Result r = run(cfg, variants[i].noise);
+
+        // positions within a tenth of the slider
+        bool ok = r.maxError < 26 && (i > 1 || r.packets < repeats);
+        if (!ok)
+            failures++;
+        printf("+-%-4u %4ums %7u %8u %6u %9.2f %8.1f %8.1f %7.1f %7.1f%s\n",
+                variants[i].noise, WDT_SLICE_MS << cfg.period, cfg.samples,
+                cfg.deadband, cfg.smoothing, r.packets / seconds,
+                r.packets ? (double)r.bytes / r.packets : 0.0,
+                r.samples / seconds, r.rmsError, r.maxError,
+                ok ? "" : "  FAIL");
+    }
+    Result r = run(SliderSettings(), 0);
+    printf("\ni2c bus: %.0fus per sample\n", r.busUsPerSample);
+    return failures ? 1 : 0;
+}
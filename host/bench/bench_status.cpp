@@ -0,0 +1,154 @@
+//
+// Status benchmark: runs two days of touch events of a few traffic
+// patterns through the firmware's StatusSchedule and a model of the RFM12B
+// wakeup timer, which waitForReply() restarts after every packet.  Reports
+// the statuses sent on their own and those piggybacked on a touch event,
+// and the longest time without a status.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include "StatusSchedule.h"
+
+#define HOURS           48
+#define MINUTE          60000UL
+
+struct Traffic {
+    const char *name;
+    // gaps between touch events, uniform in [minMs, maxMs], bursts of
+    // burst events every burstEvery ms if burst
+    unsigned long minMs;
+    unsigned long maxMs;
+    unsigned int burst;
+    unsigned long burstEvery;
+};
+
+struct Result {
+    unsigned int events;
+    unsigned int alone;         // statuses sent on their own, boot excluded
+    unsigned int piggybacked;
+    unsigned long maxGapMs;
+};
+
+// the time of the touch event after now, ~0 if there is none
+static unsigned long
+nextEvent(const Traffic &t, unsigned long now, unsigned int &inBurst)
+{
+    if (t.burst) {
+        if (inBurst) {
+            inBurst--;
+            return now + t.minMs + rand() % (t.maxMs - t.minMs + 1);
+        }
+        inBurst = t.burst - 1;
+        return (now / t.burstEvery + 1) * t.burstEvery;
+    }
+    if (!t.maxMs)
+        return ~0UL;
+    return now + t.minMs + rand() % (t.maxMs - t.minMs + 1);
+}
+
+// aimed: the wakeup timer is restarted towards the due status, otherwise
+// for the full status interval as before StatusSchedule
+static Result
+run(const Traffic &t, const SleepSettings &sleep, bool aimed)
+{
+    Result r;
+    memset(&r, 0, sizeof(r));
+    StatusSchedule schedule;
+    const unsigned long end = HOURS * 60 * MINUTE;
+    const unsigned long unit = 1UL << sleep.statusScaler;
+    unsigned int inBurst = 0;
+    srand(1);
+
+    // the boot status
+    unsigned long now = 0;
+    unsigned long last = 0;
+    schedule.sent(now, sleep);
+    unsigned long timerAt = StatusSchedule::getPeriod(sleep);
+    unsigned long eventAt = nextEvent(t, now, inBurst);
+    while (now < end) {
+        bool status = false;
+        if (timerAt <= eventAt) {
+            now = timerAt;
+            r.alone++;
+            status = true;
+        }
+        else {
+            now = eventAt;
+            r.events++;
+            if (schedule.isDue(now, sleep)) {
+                r.piggybacked++;
+                status = true;
+            }
+            eventAt = nextEvent(t, now, inBurst);
+        }
+        if (status) {
+            schedule.sent(now, sleep);
+            if (now - last > r.maxGapMs)
+                r.maxGapMs = now - last;
+            last = now;
+        }
+        // the packet's ACK wait restarts the wakeup timer
+        timerAt = now + (aimed ? schedule.getInterval(now, sleep) * unit :
+                         StatusSchedule::getPeriod(sleep));
+    }
+    if (end > last && end - last > r.maxGapMs)
+        r.maxGapMs = end - last;
+    return r;
+}
+
+int
+main()
+{
+    static const Traffic traffic[] = {
+        { "busy", 1 * MINUTE, 3 * MINUTE, 0, 0 },
+        { "hourly", 40 * MINUTE, 80 * MINUTE, 0, 0 },
+        { "evenings", 1 * MINUTE, 5 * MINUTE, 30, 24 * 60 * MINUTE },
+        { "idle", 0, 0, 0, 0 },
+    };
+    SleepSettings defaults;
+    struct Variant {
+        const char *name;
+        byte piggyback;
+        bool aimed;
+    };
+    const Variant variants[] = {
+        { "timer only", 0, false },
+        { "aimed timer", 0, true },
+        { "defaults", defaults.statusPiggyback, true },
+        { "window 30min", 55, true },
+    };
+    const unsigned long period = StatusSchedule::getPeriod(defaults);
+
+    printf("status: %d hours, status every %.1f min, piggyback window "
+            "%.1f min\n\n", HOURS, period / (double)MINUTE,
+            ((unsigned long)defaults.statusPiggyback << defaults.statusScaler) /
+            (double)MINUTE);
+    printf("%-10s %-13s %7s %6s %6s %8s\n", "traffic", "mode", "events",
+            "alone", "piggy", "max gap");
+
+    int failures = 0;
+    for (unsigned int t = 0; t < sizeof(traffic) / sizeof(traffic[0]); ++t) {
+        unsigned int aimedAlone = 0;
+        for (unsigned int v = 0; v < sizeof(variants) / sizeof(variants[0]);
+                ++v) {
+            SleepSettings sleep;
+            sleep.statusPiggyback = variants[v].piggyback;
+            Result r = run(traffic[t], sleep, variants[v].aimed);
+            if (v == 1)
+                aimedAlone = r.alone;
+            // an aimed timer keeps the status interval (an overdue packet
+            // restarts it for a unit), piggybacking never adds standalone
+            // statuses and a busy switch needs none
+            bool ok = !variants[v].aimed ||
+                (r.maxGapMs <= period + (2UL << sleep.statusScaler) &&
+                 r.alone <= aimedAlone &&
+                 (t != 0 || !sleep.statusPiggyback || r.alone == 0));
+            if (!ok)
+                failures++;
+            printf("%-10s %-13s %7u %6u %6u %7.1fh%s\n", traffic[t].name,
+                    variants[v].name, r.events, r.alone, r.piggybacked,
+                    r.maxGapMs / (60.0 * MINUTE), ok ? "" : "  FAIL");
+        }
+    }
+    return failures ? 1 : 0;
+}
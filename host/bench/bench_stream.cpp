@@ -0,0 +1,174 @@
+//
+// Electrode stream benchmark: samples the simulated MPR121 the way the
+// firmware does while streaming, packs the samples with ElectrodeStream and
+// reports the packing density, packets per minute and the I2C cost of a
+// sample.  Every packet is decoded again and compared to the samples read.
+//
+#include <stdio.h>
+#include "TouchSequence.h"
+#include "ElectrodeStream.h"
+#include "MPR121Sim.h"
+#include "MPR121_registers.h"
+
+#define SAMPLES         12000
+// SLEEP_15MS between samples
+#define PERIOD_MS       15
+// RFM12B at 49.2kbps, preamble, sync, header and crc around the payload
+#define RADIO_BPS       49200
+#define RADIO_OVERHEAD  9
+
+static const byte mpr121Addr    = 0x5A;
+static const byte mpr121IntPin  = 1;
+
+static MPR121Sim mpr121(mpr121Addr, mpr121IntPin);
+static TouchSequence touch(mpr121Addr, mpr121IntPin);
+
+struct Sample {
+    unsigned int filtered[STREAM_MAX_CHANNELS];
+    byte baseline[STREAM_MAX_CHANNELS];
+};
+
+static Sample pending[256];
+
+// mirrors lighthub/stream.py, returns the number of samples that differ
+static int
+verify(const SwitchStreamData &pkt)
+{
+    unsigned int filtered[STREAM_MAX_CHANNELS];
+    byte baseline[STREAM_MAX_CHANNELS];
+    const byte *p = pkt.data;
+    int errors = 0;
+
+    for (byte s = 0; s < pkt.samples; ++s) {
+        for (byte i = 0; i < pkt.channels; ++i) {
+            if (!s) {
+                filtered[i] = p[0] | (p[1] << 8);
+                baseline[i] = p[2];
+                p += 3;
+            }
+            else if (*p == 0x80) {
+                filtered[i] = p[1] | (p[2] << 8);
+                p += 3;
+            }
+            else
+                filtered[i] += (signed char)*p++;
+        }
+        if (s) {
+            const byte *mask = p;
+            p += (pkt.channels + 7) / 8;
+            for (byte i = 0; i < pkt.channels; ++i)
+                if (mask[i >> 3] & (1 << (i & 7)))
+                    baseline[i] = *p++;
+        }
+        if (memcmp(filtered, pending[s].filtered,
+                   pkt.channels * sizeof(*filtered)) ||
+            memcmp(baseline, pending[s].baseline, pkt.channels))
+            errors++;
+    }
+    if (p - (const byte *)&pkt != pkt.len)
+        errors++;
+    return errors;
+}
+
+struct Result {
+    byte channels;
+    unsigned long samples;
+    unsigned long packets;
+    unsigned long bytes;
+    unsigned long transactions;
+    unsigned long long busNanos;
+    unsigned long long cycles;
+    int errors;
+};
+
+static void
+runStream(uint8_t noise, bool touches, Result &r)
+{
+    ElectrodeStream stream;
+    memset(&r, 0, sizeof(r));
+    mpr121.setNoise(noise);
+    sim::i2cStats().reset();
+    stream.reset(0);
+
+    for (unsigned long n = 0; n < SAMPLES; ++n) {
+        sim::advance(PERIOD_MS * 1000ULL);
+        if (touches) {
+            // a touch every 3s, baseline drift every 5s
+            if (n % 200 == 0)
+                mpr121.touch((n / 200) % 5);
+            else if (n % 200 == 40)
+                mpr121.release((n / 200) % 5);
+            if (n % 333 == 0)
+                mpr121.setBaseline(n % 5, 700 + (n / 333 % 4) * 4);
+        }
+
+        Sample &s = pending[stream.packet.samples];
+        r.channels = touch.readElectrodeData(s.filtered, s.baseline);
+        unsigned long long c = sim::cycles();
+        bool added = stream.add(r.channels, s.filtered, s.baseline);
+        r.cycles += sim::cycles() - c;
+        if (!added) {
+            r.errors += verify(stream.packet);
+            r.packets++;
+            r.bytes += stream.packet.len;
+            pending[0] = s;
+            stream.reset(0);
+            stream.add(r.channels, pending[0].filtered, pending[0].baseline);
+        }
+        r.samples++;
+    }
+    if (!stream.isEmpty()) {
+        r.errors += verify(stream.packet);
+        r.packets++;
+        r.bytes += stream.packet.len;
+    }
+    r.transactions = sim::i2cStats().transactions;
+    r.busNanos = sim::i2cStats().busNanos;
+    mpr121.setNoise(0);
+}
+
+int
+main()
+{
+    MPR121Settings settings;
+    settings.proximityMode = 1;
+    touch.begin(settings);
+
+    printf("stream: %d samples every %d ms, %d byte packets\n\n", SAMPLES,
+            PERIOD_MS, (int)sizeof(SwitchStreamData));
+    printf("%-16s %4s %7s %7s %8s %8s %10s %10s %9s\n", "signal", "ch",
+            "B/smp", "raw B", "smp/pkt", "pkt/min", "air ms/min",
+            "bus us/smp", "cyc/smp");
+
+    struct {
+        const char *name;
+        uint8_t noise;
+        bool touches;
+    } runs[] = {
+        { "quiet",          1,  false },
+        { "noisy",          8,  false },
+        { "touches+drift",  3,  true },
+        { "very noisy",     80, false },
+    };
+
+    int failures = 0;
+    for (unsigned int i = 0; i < sizeof(runs) / sizeof(runs[0]); ++i) {
+        Result r;
+        runStream(runs[i].noise, runs[i].touches, r);
+        double minutes = r.samples * PERIOD_MS / 60000.0;
+        double airMs = (r.bytes + r.packets * RADIO_OVERHEAD) * 8000.0 /
+            RADIO_BPS;
+        printf("%-16s %4u %7.2f %7u %8.1f %8.1f %10.1f %10.1f %9.0f%s\n",
+                runs[i].name, r.channels,
+                (double)(r.bytes - r.packets *
+                 (sizeof(SwitchStreamData) - STREAM_DATA_SIZE)) / r.samples,
+                r.channels * 3,
+                (double)r.samples / r.packets, r.packets / minutes,
+                airMs / minutes, r.busNanos / 1000.0 / r.samples,
+                (double)r.cycles / r.samples,
+                r.errors ? "  FAIL" : "");
+        if (r.errors)
+            failures++;
+    }
+    return failures ? 1 : 0;
+}
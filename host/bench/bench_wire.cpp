@@ -0,0 +1,300 @@
+//
+// Wire encoding benchmark: encodes the packets a switch sends for each kind
+// of event with CompactCodec, as radioSend() does once the hub selected it,
+// and reports the bytes and airtime against the structs.  Every packet is
+// decoded again as the hub does and compared, truncated packets must not
+// decode past their end.
+//
+#include <stdio.h>
+#include "CompactCodec.h"
+#include "TouchSequence.h"
+#include "BatteryTrend.h"
+
+// RFM12B at 49.2kbps, preamble, sync, header and crc around the payload
+#define RADIO_BPS       49200
+#define RADIO_OVERHEAD  9
+
+// the length of a sub-packet as avr-gcc lays it out, 2 byte ints and 4
+// byte longs without padding, the host structs are larger
+static byte
+avrLen(const SwitchPacket *pkt)
+{
+    switch (pkt->type) {
+        case SwitchPacket::STATUS_UPDATE:
+            return sizeof(SwitchPacket) + 4 + 6 * 2;
+        case SwitchPacket::ENERGY_STATUS:
+            return sizeof(SwitchPacket) + 6 * 4;
+        default:
+            return pkt->len;
+    }
+}
+
+struct Packet {
+    byte data[RF12_MAXDATA];
+    byte len;
+    byte avr;
+
+    Packet() : len(0), avr(0) {}
+
+    template <class T>
+    void add(const T &pkt) {
+        memcpy(data + len, &pkt, pkt.len);
+        len += pkt.len;
+        avr += avrLen(&pkt);
+    }
+};
+
+static TouchEvent
+event(byte gesture, byte electrode, byte repeat = 0, byte gang = 0)
+{
+    TouchEvent e;
+    e.gesture = gesture;
+    e.electrode = electrode;
+    e.repeat = repeat;
+    e.gang = gang;
+    return e;
+}
+
+// the events that need an ACK follow a SwitchSequence
+static SwitchSequence
+sequence(byte first, byte flags = 0)
+{
+    SwitchSequence q;
+    q.sequence = first;
+    q.flags = flags;
+    return q;
+}
+
+static SwitchStatus
+status()
+{
+    SwitchStatus s;
+    s.batteryLevel = 2987;
+    s.batteryDays = 212;
+    s.statusCount = 1500;
+    s.touchWakes = 812;
+    s.falseWakes = 35;
+    s.settingsCrc = 0xBEEF;
+    s.droppedEvents = 3;
+    return s;
+}
+
+static SwitchEnergy
+energy()
+{
+    SwitchEnergy e;
+    e.awakeMs = 184230;
+    e.standbyMs = 2311520;
+    e.i2cMs = 3412;
+    e.txMs = 4480;
+    e.ackWaitMs = 8120;
+    e.wakes = 9342;
+    return e;
+}
+
+// compares the sub-packets field by field, the host structs have padding
+static bool
+same(const byte *a, const byte *b, byte len)
+{
+    byte pos = 0;
+    while (pos < len) {
+        const SwitchPacket *pa = (const SwitchPacket *)(a + pos);
+        const SwitchPacket *pb = (const SwitchPacket *)(b + pos);
+        if (pa->type != pb->type || pa->len != pb->len)
+            return false;
+        if (pa->type == SwitchPacket::STATUS_UPDATE) {
+            const SwitchStatus *sa = (const SwitchStatus *)pa;
+            const SwitchStatus *sb = (const SwitchStatus *)pb;
+            if (sa->batteryLevel != sb->batteryLevel ||
+                sa->batteryDays != sb->batteryDays ||
+                sa->statusCount != sb->statusCount ||
+                sa->touchWakes != sb->touchWakes ||
+                sa->falseWakes != sb->falseWakes ||
+                sa->settingsCrc != sb->settingsCrc ||
+                sa->droppedEvents != sb->droppedEvents)
+                return false;
+        }
+        else if (pa->type == SwitchPacket::ENERGY_STATUS) {
+            const SwitchEnergy *ea = (const SwitchEnergy *)pa;
+            const SwitchEnergy *eb = (const SwitchEnergy *)pb;
+            if (ea->awakeMs != eb->awakeMs || ea->standbyMs != eb->standbyMs ||
+                ea->i2cMs != eb->i2cMs || ea->txMs != eb->txMs ||
+                ea->ackWaitMs != eb->ackWaitMs || ea->wakes != eb->wakes)
+                return false;
+        }
+        else if (memcmp(pa, pb, pa->len))
+            return false;
+        pos += pa->len;
+    }
+    return true;
+}
+
+static double
+airtimeMs(byte len)
+{
+    return (len + RADIO_OVERHEAD) * 8000.0 / RADIO_BPS;
+}
+
+// encodes and decodes a packet, returns the failures
+static int
+run(const char *name, const Packet &pkt, unsigned int &avrBytes,
+    unsigned int &compactBytes, byte version = COMPACT_VERSION)
+{
+    byte compact[RF12_MAXDATA];
+    byte n = compactEncode(pkt.data, pkt.len, compact, sizeof(compact),
+                           version);
+    // radioSend() sends the structs if the encoding is no shorter
+    byte sent = n && n < pkt.avr ? n : pkt.avr;
+    printf("  %-24s %3u -> %3u bytes %5.2f -> %5.2fms %4.0f%%%s\n", name,
+            pkt.avr, sent, airtimeMs(pkt.avr), airtimeMs(sent),
+            100.0 * sent / pkt.avr, n ? "" : " (structs)");
+    avrBytes += pkt.avr;
+    compactBytes += sent;
+    if (!n)
+        return 0;
+
+    int failures = 0;
+    byte decoded[RF12_MAXDATA];
+    byte len = compactDecode(compact, n, decoded, sizeof(decoded));
+    if (len != pkt.len || !same(pkt.data, decoded, len)) {
+        printf("FAIL: %s does not decode\n", name);
+        failures++;
+    }
+    // a packet cut short decodes its whole sub-packets at most
+    for (byte cut = 0; cut < n; ++cut) {
+        len = compactDecode(compact, cut, decoded, sizeof(decoded));
+        if (len > pkt.len || (len && !same(pkt.data, decoded, len))) {
+            printf("FAIL: %s cut after %u bytes\n", name, cut);
+            failures++;
+        }
+    }
+    return failures;
+}
+
+int
+main()
+{
+    int failures = 0;
+    unsigned int avrBytes = 0, compactBytes = 0;
+    Packet p;
+
+    printf("bytes on air per packet, structs -> compact:\n");
+#define RUN(name) do { \
+        failures += run(name, p, avrBytes, compactBytes); \
+        p = Packet(); \
+    } while (0)
+
+    p.add(sequence(0x51));
+    p.add(event(TOUCH_TAP, ELECTRODE_TOP));
+    RUN("tap");
+    unsigned int tapAvr = avrBytes, tapCompact = compactBytes;
+    p.add(event(TOUCH_DOUBLE_TAP, ELECTRODE_CENTER));
+    RUN("double tap");
+    p.add(event(TOUCH_SWIPE_UP, ELECTRODE_BOTTOM));
+    RUN("swipe");
+    p.add(event(TOUCH_TAP, ELECTRODE_LEFT, 3));
+    RUN("repeat of 3 ticks");
+    p.add(event(TOUCH_CHORD, 0x03));
+    RUN("chord top+left");
+    p.add(event(TOUCH_CHORD, 0x11));
+    RUN("chord top+center");
+    p.add(sequence(0x52, SEQUENCE_RESTART));
+    p.add(event(TOUCH_TAP, ELECTRODE_TOP, 0, 0));
+    p.add(event(TOUCH_CHORD, 0x11, 0, 1));
+    RUN("tap + top+center chord");
+    p.add(event(TOUCH_PROXIMITY, ELECTRODE_PROXIMITY));
+    RUN("proximity");
+    p.add(event(TOUCH_TAP, ELECTRODE_TOP, 0, 0));
+    p.add(event(TOUCH_TAP, ELECTRODE_TOP, 0, 1));
+    RUN("taps of 2 gangs");
+
+    TouchCorrection c;
+    c.reportedGesture = TOUCH_TAP;
+    c.reportedElectrode = ELECTRODE_RIGHT;
+    c.gesture = TOUCH_DOUBLE_TAP;
+    c.electrode = ELECTRODE_RIGHT;
+    c.gang = 0;
+    p.add(c);
+    RUN("correction");
+
+    p.add(status());
+    p.add(energy());
+    unsigned int before = avrBytes, beforeCompact = compactBytes;
+    RUN("status");
+    unsigned int statusAvr = avrBytes - before;
+    unsigned int statusCompact = compactBytes - beforeCompact;
+    p.add(sequence(0));
+    p.add(event(TOUCH_TAP, ELECTRODE_TOP));
+    p.add(status());
+    p.add(energy());
+    RUN("tap + piggyback status");
+
+    // a hub of version 1 gets the sequence as a struct
+    p.add(sequence(0x51));
+    p.add(event(TOUCH_TAP, ELECTRODE_TOP));
+    p.add(event(TOUCH_DOUBLE_TAP, ELECTRODE_TOP));
+    failures += run("retry of 2 taps, v1", p, avrBytes, compactBytes, 1);
+    p = Packet();
+
+    // a hub of version 2 gets the status without the dropped events
+    SwitchStatus old = status();
+    old.droppedEvents = 0;
+    p.add(old);
+    failures += run("status, v2", p, avrBytes, compactBytes, 2);
+    p = Packet();
+
+    // the extremes of the fields
+    SwitchStatus s = status();
+    s.batteryLevel = 1800;
+    s.batteryDays = BATTERY_DAYS_UNKNOWN;
+    s.statusCount = 0xFFFF;
+    s.droppedEvents = 0xFFFF;
+    p.add(s);
+    SwitchEnergy e = energy();
+    e.awakeMs = 0xFFFFFFFFUL;
+    p.add(e);
+    RUN("status, field extremes");
+
+    SwitchSliderData slider;
+    slider.gang = 0;
+    slider.sequence = 0;
+    slider.flags = 0;
+    slider.period = 0;
+    slider.samples = 9;
+    slider.position = 100;
+    for (byte i = 0; i < SLIDER_MAX_DELTAS; ++i)
+        slider.delta[i] = i;
+    slider.len = sizeof(slider) - SLIDER_MAX_DELTAS + 8;
+    p.add(slider);
+    RUN("slider, 9 samples");
+
+    SwitchStreamData stream;
+    memset(stream.data, 0x55, sizeof(stream.data));
+    p.add(stream);
+    RUN("stream data");
+
+    // a later version is not decoded
+    byte later[] = { COMPACT_MARKER | (COMPACT_VERSION + 1), 0x01, 0x10 };
+    byte decoded[RF12_MAXDATA];
+    if (compactDecode(later, sizeof(later), decoded, sizeof(decoded))) {
+        printf("FAIL: a later version decodes\n");
+        failures++;
+    }
+
+    // a day of 50 touch packets and 24 statuses
+    unsigned long dayAvr = 50UL * tapAvr + 24UL * statusAvr;
+    unsigned long dayCompact = 50UL * tapCompact + 24UL * statusCompact;
+    printf("\nall packets: %u -> %u bytes (%.0f%%)\n", avrBytes, compactBytes,
+            100.0 * compactBytes / avrBytes);
+    printf("a day of 50 taps and 24 statuses: %.1f -> %.1fms on air\n",
+            50 * airtimeMs(tapAvr) + 24 * airtimeMs(statusAvr),
+            50 * airtimeMs(tapCompact) + 24 * airtimeMs(statusCompact));
+    printf("  payload %lu -> %lu bytes\n", dayAvr, dayCompact);
+
+    // a tap takes half the payload, a status three quarters
+    if (2 * tapCompact > tapAvr || 4 * statusCompact > 3 * statusAvr) {
+        printf("FAIL: compact encoding\n");
+        failures++;
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,80 @@
+//
+// Minimal Arduino core shim for host builds
+//
+#ifndef ARDUINO_H
+#define ARDUINO_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+typedef uint8_t byte;
+typedef bool boolean;
+typedef uint16_t word;
+
+#define LOW     0
+#define HIGH    1
+#define CHANGE  1
+#define FALLING 2
+#define RISING  3
+
+#define INPUT   0
+#define OUTPUT  1
+
+#define DEC     10
+#define HEX     16
+#define OCT     8
+#define BIN     2
+
+#define min(a,b) ((a)<(b)?(a):(b))
+#define max(a,b) ((a)>(b)?(a):(b))
+
+#ifndef _BV
+#define _BV(bit) (1 << (bit))
+#endif
+
+// flash is ordinary memory on the host
+#define PROGMEM
+#define pgm_read_byte(p)    (*(const uint8_t *)(p))
+#define memcpy_P            memcpy
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+
+void attachInterrupt(uint8_t interruptNum, void (*isr)(), int mode);
+void detachInterrupt(uint8_t interruptNum);
+
+class HardwareSerial {
+    public:
+        void begin(unsigned long) {}
+        void flush() {}
+        operator bool() { return true; }
+        int available() { return 0; }
+        int read() { return -1; }
+
+        void print(const char *s);
+        void print(char c);
+        void print(long n, int base=DEC);
+        void print(unsigned long n, int base=DEC);
+        void print(int n, int base=DEC) { print((long)n, base); }
+        void print(unsigned int n, int base=DEC) { print((unsigned long)n, base); }
+        void print(unsigned char n, int base=DEC) { print((unsigned long)n, base); }
+        void print(double n) ;
+
+        template <class T>
+        void println(T v) { print(v); print('\n'); }
+        template <class T>
+        void println(T v, int base) { print(v, base); print('\n'); }
+        void println() { print('\n'); }
+};
+
+extern HardwareSerial Serial;
+
+#endif // ARDUINO_H
@@ -0,0 +1,39 @@
+#include "EEPROM.h"
+#include "Sim.h"
+
+EEPROMClass EEPROM;
+
+static uint8_t cells[E2END + 1];
+
+EEPROMClass::EEPROMClass()
+{
+    erase();
+}
+
+uint8_t
+EEPROMClass::read(int address)
+{
+    reads++;
+    return cells[address & E2END];
+}
+
+void
+EEPROMClass::write(int address, uint8_t value)
+{
+    if (budget == 0)
+        return;
+    if (budget > 0)
+        budget--;
+    cells[address & E2END] = value;
+    writes[address & E2END]++;
+    sim::advance(WRITE_US);
+}
+
+void
+EEPROMClass::erase()
+{
+    memset(cells, 0xFF, sizeof(cells));
+    memset(writes, 0, sizeof(writes));
+    reads = 0;
+    budget = -1;
+}
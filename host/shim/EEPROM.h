@@ -0,0 +1,32 @@
+//
+// EEPROM library shim for host builds: 1KB of cells that count their
+// writes, and a write budget that models a reset in the middle of a write
+//
+#ifndef EEPROM_H
+#define EEPROM_H
+
+#include <Arduino.h>
+
+#define E2END 0x3FF
+
+class EEPROMClass {
+    public:
+        EEPROMClass();
+        uint8_t read(int address);
+        void write(int address, uint8_t value);
+
+        // erases all cells to 0xFF and clears the counters
+        void erase();
+
+        // writes to each cell, an erase does not count
+        unsigned long writes[E2END + 1];
+        unsigned long reads;
+        // writes left before they are dropped, < 0 for no limit
+        long budget;
+        // simulated time of a byte write
+        static const unsigned int WRITE_US = 3300;
+};
+
+extern EEPROMClass EEPROM;
+
+#endif // EEPROM_H
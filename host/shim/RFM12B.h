@@ -0,0 +1,24 @@
+//
+// RFM12B library shim for host builds
+//
+#ifndef RFM12B_h
+#define RFM12B_h
+
+#include <Arduino.h>
+
+#define RF12_433MHZ     1
+#define RF12_868MHZ     2
+#define RF12_915MHZ     3
+
+#define RF12_MAXDATA    128
+
+// low battery detector thresholds
+#define RF12_2v25       0
+#define RF12_2v55       3
+#define RF12_2v65       4
+#define RF12_2v75       5
+#define RF12_3v05       8
+#define RF12_3v15       9
+#define RF12_3v25       10
+
+#endif // RFM12B_h
@@ -0,0 +1,95 @@
+#include "Wire.h"
+#include "Sim.h"
+
+TwoWire Wire;
+
+TwoWire::TwoWire() :
+    txAddress(0), txLength(0), rxIndex(0), rxLength(0)
+{
+}
+
+void
+TwoWire::begin()
+{
+    rxIndex = rxLength = 0;
+    txLength = 0;
+}
+
+void
+TwoWire::setClock(unsigned long hz)
+{
+    sim::setI2CClock(hz);
+}
+
+void
+TwoWire::beginTransmission(uint8_t address)
+{
+    txAddress = address;
+    txLength = 0;
+}
+
+size_t
+TwoWire::write(uint8_t data)
+{
+    if (txLength >= BUFFER_LENGTH)
+        return 0;
+    txBuffer[txLength++] = data;
+    return 1;
+}
+
+size_t
+TwoWire::write(const uint8_t *data, size_t quantity)
+{
+    for (size_t i = 0; i < quantity; ++i) {
+        if (!write(data[i]))
+            return i;
+    }
+    return quantity;
+}
+
+// like the AVR library, the transmission goes out on the bus even when
+// nothing has been written (an address-only write to the last address)
+uint8_t
+TwoWire::endTransmission(uint8_t)
+{
+    sim::I2CDevice *dev = sim::findI2C(txAddress);
+    sim::i2cTransaction(1 + txLength);
+    byte len = txLength;
+    txLength = 0;
+    if (!dev)
+        return 2;   // address NACK
+    if (len)
+        dev->i2cWrite(txBuffer, len);
+    return 0;
+}
+
+uint8_t
+TwoWire::requestFrom(uint8_t address, uint8_t quantity, uint8_t)
+{
+    if (quantity > BUFFER_LENGTH)
+        quantity = BUFFER_LENGTH;
+    rxIndex = rxLength = 0;
+    sim::I2CDevice *dev = sim::findI2C(address);
+    if (!dev) {
+        sim::i2cTransaction(1);
+        return 0;
+    }
+    sim::i2cTransaction(1 + quantity);
+    dev->i2cRead(rxBuffer, quantity);
+    rxLength = quantity;
+    return quantity;
+}
+
+int
+TwoWire::available()
+{
+    return rxLength - rxIndex;
+}
+
+int
+TwoWire::read()
+{
+    if (rxIndex >= rxLength)
+        return -1;
+    return rxBuffer[rxIndex++];
+}
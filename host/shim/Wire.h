@@ -0,0 +1,40 @@
+//
+// Wire (TWI) library shim for host builds, backed by the simulated I2C bus
+//
+#ifndef WIRE_H
+#define WIRE_H
+
+#include <Arduino.h>
+
+#define BUFFER_LENGTH 32
+
+class TwoWire {
+    public:
+        TwoWire();
+        void begin();
+        void setClock(unsigned long hz);
+        void beginTransmission(uint8_t address);
+        void beginTransmission(int address) { beginTransmission((uint8_t)address); }
+        uint8_t endTransmission(uint8_t sendStop=true);
+        uint8_t requestFrom(uint8_t address, uint8_t quantity,
+                            uint8_t sendStop=true);
+        uint8_t requestFrom(int address, int quantity) {
+            return requestFrom((uint8_t)address, (uint8_t)quantity);
+        }
+        size_t write(uint8_t data);
+        size_t write(const uint8_t *data, size_t quantity);
+        int available();
+        int read();
+
+    private:
+        uint8_t txAddress;
+        uint8_t txBuffer[BUFFER_LENGTH];
+        uint8_t txLength;
+        uint8_t rxBuffer[BUFFER_LENGTH];
+        uint8_t rxIndex;
+        uint8_t rxLength;
+};
+
+extern TwoWire Wire;
+
+#endif // WIRE_H
@@ -0,0 +1,194 @@
+#include "MPR121Sim.h"
+#include "Arduino.h"
+#include "MPR121_registers.h"
+
+// 10 bit electrode data reported with no finger present
+#define IDLE_DATA   700
+
+MPR121Sim::MPR121Sim(uint8_t address, uint8_t interruptNum) :
+    address(address), interruptNum(interruptNum), irq(false), noise(0)
+{
+    reset();
+    sim::attachI2C(address, this);
+}
+
+MPR121Sim::~MPR121Sim()
+{
+    sim::detachI2C(address);
+}
+
+void
+MPR121Sim::reset()
+{
+    memset(regs, 0, sizeof(regs));
+    regs[AFE1] = 0x10;
+    regs[AFE2] = 0x24;
+    for (int i = 0; i < MPR121SIM_CHANNELS; ++i) {
+        baseline[i] = IDLE_DATA;
+        delta[i] = 0;
+    }
+    ptr = 0;
+    status = 0;
+    ignoredWrites = 0;
+    autoConfigs = 0;
+    setIRQ(false);
+    seed = 1;
+    sample();
+}
+
+bool
+MPR121Sim::isRunning() const
+{
+    return regs[ECR] & 0x3F;
+}
+
+void
+MPR121Sim::setDelta(uint8_t channel, uint16_t val)
+{
+    if (channel >= MPR121SIM_CHANNELS)
+        return;
+    delta[channel] = val;
+    sample();
+}
+
+void
+MPR121Sim::setBaseline(uint8_t channel, uint16_t val)
+{
+    if (channel >= MPR121SIM_CHANNELS)
+        return;
+    baseline[channel] = val & 0x3FC;
+    sample();
+}
+
+void
+MPR121Sim::setIRQ(bool asserted)
+{
+    // the IRQ output is open drain, several MPR121s may share the line
+    sim::pullInterruptLine(interruptNum, asserted, irq);
+    irq = asserted;
+}
+
+int
+MPR121Sim::noiseSample()
+{
+    if (!noise)
+        return 0;
+    // deterministic LCG so runs are repeatable
+    seed = seed * 1103515245 + 12345;
+    return (int)((seed >> 16) % (2 * noise + 1)) - noise;
+}
+
+void
+MPR121Sim::sample()
+{
+    byte eleEn = regs[ECR] & 0x0F;
+    byte proxEn = (regs[ECR] >> 4) & 0x03;
+    if (eleEn > 12)
+        eleEn = 12;
+
+    uint16_t next = 0;
+    for (int i = 0; i < MPR121SIM_CHANNELS; ++i) {
+        bool enabled = i < 12 ? i < eleEn : proxEn != 0;
+        int level = (int)baseline[i] - delta[i] + noiseSample();
+        uint16_t data = level < 0 ? 0 : level > 0x3FF ? 0x3FF : level;
+
+        if (enabled) {
+            regs[ELE0_LSB + (i << 1)] = data & 0xFF;
+            regs[ELE0_MSB + (i << 1)] = (data >> 8) & 0x03;
+        }
+        regs[E0BV + i] = baseline[i] >> 2;
+
+        if (!enabled)
+            continue;
+        // touch/release detection with hysteresis
+        int diff = (int)baseline[i] - data;
+        bool touched;
+        if (status & (1 << i))
+            touched = diff >= regs[E0RTH + (i << 1)];
+        else
+            touched = diff > regs[E0TTH + (i << 1)];
+        if (touched)
+            next |= 1 << i;
+    }
+
+    if (next != status) {
+        status = next;
+        regs[ELE0_7] = status & 0xFF;
+        regs[ELE8_PROX] = (status >> 8) & 0x1F;
+        setIRQ(true);
+    }
+}
+
+void
+MPR121Sim::writeRegister(uint8_t reg, uint8_t val)
+{
+    if (reg == SOFT_RESET) {
+        if (val == 0x63)
+            reset();
+        return;
+    }
+    reg &= 0x7F;
+
+    // registers other than ECR and GPIO can only be written in stop mode
+    bool writable = reg >= MIN_WRITE_REG &&
+        (reg == ECR || (reg >= GPIOCR0 && reg <= GPIOTOG) || !isRunning());
+    if (!writable) {
+        ignoredWrites++;
+        return;
+    }
+
+    bool wasRunning = isRunning();
+    regs[reg] = val;
+    if (reg >= E0BV && reg <= EPROXBV)
+        baseline[reg - E0BV] = (uint16_t)val << 2;
+    if (reg == ECR) {
+        // auto-configuration runs on every transition from stop to run mode
+        if (!wasRunning && isRunning() && (regs[ACCR0] & 0x01))
+            autoConfigure();
+        if (!isRunning() && status) {
+            status = 0;
+            regs[ELE0_7] = regs[ELE8_PROX] = 0;
+        }
+        sample();
+    }
+}
+
+void
+MPR121Sim::autoConfigure()
+{
+    autoConfigs++;
+    for (uint8_t reg = CDC0; reg <= CDCPROX; ++reg)
+        regs[reg] = AUTOCONFIG_CDC;
+    for (uint8_t reg = CDT01; reg <= CDTPROX; ++reg)
+        regs[reg] = AUTOCONFIG_CDT;
+}
+
+uint8_t
+MPR121Sim::readRegister(uint8_t reg)
+{
+    reg &= 0x7F;
+    // reading the touch status clears the interrupt
+    if (reg <= ELE8_PROX && irq)
+        setIRQ(false);
+    return regs[reg];
+}
+
+void
+MPR121Sim::i2cWrite(const uint8_t *data, size_t len)
+{
+    // the first byte sets the register address, the following are written
+    // with auto-increment
+    ptr = data[0];
+    for (size_t i = 1; i < len; ++i)
+        writeRegister(ptr++, data[i]);
+}
+
+void
+MPR121Sim::i2cRead(uint8_t *data, size_t len)
+{
+    // a read of the electrode data sees a new measurement
+    if (noise && ptr >= ELE0_LSB && ptr <= ELEPROX_MSB)
+        sample();
+    for (size_t i = 0; i < len; ++i)
+        data[i] = readRegister(ptr++);
+}
@@ -0,0 +1,80 @@
+//
+// Register level model of the MPR121 capacitive touch sensor
+//
+#ifndef MPR121SIM_H
+#define MPR121SIM_H
+
+#include "Sim.h"
+
+#define MPR121SIM_CHANNELS  13      // 12 electrodes + proximity
+
+class MPR121Sim : public sim::I2CDevice {
+    public:
+        // Constructor
+        //   address:      i2c address the model answers on
+        //   interruptNum: external interrupt line driven by the IRQ pin
+        MPR121Sim(uint8_t address, uint8_t interruptNum);
+        ~MPR121Sim();
+
+        // restores the power on register values
+        void reset();
+
+        // sets the capacitance delta caused by a finger on a channel,
+        // 12 is the proximity channel
+        void setDelta(uint8_t channel, uint16_t delta);
+        void touch(uint8_t channel) { setDelta(channel, TOUCH_DELTA); }
+        void release(uint8_t channel) { setDelta(channel, 0); }
+        // moves the 10 bit baseline of a channel, as the MPR121 baseline
+        // tracking would after a slow environmental change
+        void setBaseline(uint8_t channel, uint16_t val);
+        // adds uniform noise of +-amplitude counts to the electrode data,
+        // the data is sampled again on every read of the data registers
+        void setNoise(uint8_t amplitude) { noise = amplitude; sample(); }
+
+        // takes a new measurement, the MPR121 does so every sample period
+        void measure() { sample(); }
+
+        // returns the raw register value without any bus traffic
+        uint8_t peek(uint8_t reg) const { return regs[reg & 0x7F]; }
+        // returns true when the electrodes are in run mode
+        bool isRunning() const;
+        // returns true when the IRQ line is asserted
+        bool isIRQ() const { return irq; }
+
+        // number of register writes dropped because the MPR121 was in run
+        // mode or the register is read only
+        unsigned long ignoredWrites;
+        // number of auto-configuration runs
+        unsigned long autoConfigs;
+
+        static const uint16_t TOUCH_DELTA = 40;
+        // charge current/time registers written by auto-configuration
+        static const uint8_t AUTOCONFIG_CDC = 0x20;
+        static const uint8_t AUTOCONFIG_CDT = 0x22;
+
+        // sim::I2CDevice
+        virtual void i2cWrite(const uint8_t *data, size_t len);
+        virtual void i2cRead(uint8_t *data, size_t len);
+
+    protected:
+        void writeRegister(uint8_t reg, uint8_t val);
+        uint8_t readRegister(uint8_t reg);
+        // recomputes electrode data and touch status
+        void sample();
+        void autoConfigure();
+        void setIRQ(bool asserted);
+        int noiseSample();
+
+        uint8_t address;
+        uint8_t interruptNum;
+        uint8_t ptr;
+        uint8_t regs[0x80];
+        uint16_t baseline[MPR121SIM_CHANNELS];
+        uint16_t delta[MPR121SIM_CHANNELS];
+        uint16_t status;
+        bool irq;
+        uint8_t noise;
+        uint32_t seed;
+};
+
+#endif // MPR121SIM_H
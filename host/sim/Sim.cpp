@@ -0,0 +1,250 @@
+#include "Sim.h"
+#include "Arduino.h"
+
+namespace sim {
+
+static unsigned long long clock_us = 0;
+static unsigned long long clock_ns = 0;
+
+struct InterruptLine {
+    void (*isr)();
+    int mode;
+    int level;
+    int pulls;                  // open drain outputs pulling the line low
+};
+static InterruptLine lines[2] = {
+    { NULL, LOW, HIGH, 0 },
+    { NULL, LOW, HIGH, 0 },
+};
+
+static I2CDevice *devices[128];
+static unsigned long i2cClock = 100000L;
+static I2CStats stats;
+
+unsigned long long
+now()
+{
+    return clock_us;
+}
+
+void
+advance(unsigned long long us)
+{
+    clock_us += us;
+}
+
+static void
+advanceNanos(unsigned long long ns)
+{
+    clock_ns += ns;
+    clock_us += clock_ns / 1000;
+    clock_ns %= 1000;
+}
+
+void
+reset()
+{
+    clock_us = 0;
+    clock_ns = 0;
+    for (int i = 0; i < 2; ++i) {
+        lines[i].isr = NULL;
+        lines[i].level = HIGH;
+        lines[i].pulls = 0;
+    }
+    i2cClock = 100000L;
+    stats.reset();
+}
+
+static void
+trigger(uint8_t interruptNum, int prevLevel)
+{
+    InterruptLine &line = lines[interruptNum];
+    if (!line.isr)
+        return;
+    bool fire = false;
+    switch (line.mode) {
+        case LOW:     fire = line.level == LOW;                          break;
+        case CHANGE:  fire = line.level != prevLevel;                    break;
+        case FALLING: fire = prevLevel == HIGH && line.level == LOW;     break;
+        case RISING:  fire = prevLevel == LOW && line.level == HIGH;     break;
+    }
+    if (fire)
+        line.isr();
+}
+
+void
+setInterruptLine(uint8_t interruptNum, int level)
+{
+    if (interruptNum > 1)
+        return;
+    int prev = lines[interruptNum].level;
+    lines[interruptNum].level = level;
+    trigger(interruptNum, prev);
+}
+
+void
+pullInterruptLine(uint8_t interruptNum, bool low, bool wasLow)
+{
+    if (interruptNum > 1)
+        return;
+    InterruptLine &line = lines[interruptNum];
+    if (low && !wasLow)
+        line.pulls++;
+    else if (!low && wasLow && line.pulls)
+        line.pulls--;
+    setInterruptLine(interruptNum, line.pulls ? LOW : HIGH);
+}
+
+bool
+isInterruptAttached(uint8_t interruptNum)
+{
+    return interruptNum < 2 && lines[interruptNum].isr;
+}
+
+void
+attachI2C(uint8_t address, I2CDevice *dev)
+{
+    devices[address & 0x7F] = dev;
+}
+
+void
+detachI2C(uint8_t address)
+{
+    devices[address & 0x7F] = NULL;
+}
+
+I2CDevice *
+findI2C(uint8_t address)
+{
+    return devices[address & 0x7F];
+}
+
+void
+i2cTransaction(size_t len)
+{
+    // START + 9 clocks per byte (8 data + ACK) + STOP
+    unsigned long long bits = 9 * len + 2;
+    unsigned long long ns = bits * 1000000000ULL / i2cClock;
+    stats.transactions++;
+    stats.bytes += len;
+    stats.busNanos += ns;
+    advanceNanos(ns);
+}
+
+void
+setI2CClock(unsigned long hz)
+{
+    i2cClock = hz;
+}
+
+unsigned long
+getI2CClock()
+{
+    return i2cClock;
+}
+
+I2CStats &
+i2cStats()
+{
+    return stats;
+}
+
+} // namespace sim
+
+// =================
+//  Arduino runtime
+// =================
+
+HardwareSerial Serial;
+
+unsigned long
+millis()
+{
+    return (unsigned long)(sim::now() / 1000);
+}
+
+unsigned long
+micros()
+{
+    return (unsigned long)sim::now();
+}
+
+void
+delay(unsigned long ms)
+{
+    sim::advance((unsigned long long)ms * 1000);
+}
+
+void
+delayMicroseconds(unsigned int us)
+{
+    sim::advance(us);
+}
+
+void pinMode(uint8_t, uint8_t) {}
+void digitalWrite(uint8_t, uint8_t) {}
+int digitalRead(uint8_t) { return LOW; }
+
+void
+attachInterrupt(uint8_t interruptNum, void (*isr)(), int mode)
+{
+    if (interruptNum > 1)
+        return;
+    sim::lines[interruptNum].isr = isr;
+    sim::lines[interruptNum].mode = mode;
+    // a level triggered interrupt fires immediately if the line is held low
+    if (mode == LOW)
+        sim::trigger(interruptNum, sim::lines[interruptNum].level);
+}
+
+void
+detachInterrupt(uint8_t interruptNum)
+{
+    if (interruptNum > 1)
+        return;
+    sim::lines[interruptNum].isr = NULL;
+}
+
+// ========
+//  Serial
+// ========
+
+#include <stdio.h>
+
+void
+HardwareSerial::print(const char *s)
+{
+    fputs(s, stdout);
+}
+
+void
+HardwareSerial::print(char c)
+{
+    fputc(c, stdout);
+}
+
+void
+HardwareSerial::print(long n, int base)
+{
+    if (n < 0 && base == DEC) {
+        fputc('-', stdout);
+        n = -n;
+    }
+    print((unsigned long)n, base);
+}
+
+void
+HardwareSerial::print(unsigned long n, int base)
+{
+    switch (base) {
+        case HEX: printf("%lX", n); break;
+        case OCT: printf("%lo", n); break;
+        default:  printf("%lu", n); break;
+    }
+}
+
+void
+HardwareSerial::print(double n)
+{
+    printf("%.2f", n);
+}
@@ -0,0 +1,67 @@
+//
+// Host simulation environment: simulated clock, interrupt lines and an I2C
+// bus model shared by the Arduino shims and the device models.
+//
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace sim {
+
+// An I2C slave attached to the simulated bus
+class I2CDevice {
+    public:
+        virtual ~I2CDevice() {}
+        // called with the bytes of a master write transaction
+        virtual void i2cWrite(const uint8_t *data, size_t len) = 0;
+        // called for a master read transaction, fills len bytes
+        virtual void i2cRead(uint8_t *data, size_t len) = 0;
+};
+
+struct I2CStats {
+    unsigned long transactions;     // START (or repeated START) conditions
+    unsigned long bytes;            // address + data bytes on the bus
+    unsigned long long busNanos;    // time the bus was busy
+
+    void reset() { transactions = 0; bytes = 0; busNanos = 0; }
+};
+
+// simulated time since reset, advanced by delay(), bus traffic and
+// explicitly by the test harness
+unsigned long long now();
+void advance(unsigned long long us);
+void reset();
+
+// drives the level of an external interrupt line (INT0/INT1), invoking an
+// attached ISR according to its trigger mode
+void setInterruptLine(uint8_t interruptNum, int level);
+// an open drain output pulling the line low or releasing it, the line is
+// low while any of the outputs sharing it pulls
+void pullInterruptLine(uint8_t interruptNum, bool low, bool wasLow);
+bool isInterruptAttached(uint8_t interruptNum);
+
+// I2C bus
+void attachI2C(uint8_t address, I2CDevice *dev);
+void detachI2C(uint8_t address);
+I2CDevice *findI2C(uint8_t address);
+// accounts one transaction of len bytes (address byte included) at the
+// current bus clock and advances simulated time accordingly
+void i2cTransaction(size_t len);
+void setI2CClock(unsigned long hz);
+unsigned long getI2CClock();
+I2CStats &i2cStats();
+
+// reads the processor timestamp counter, used to measure host CPU cycles
+static inline unsigned long long cycles() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#else
+    return now() * 1000;
+#endif
+}
+
+} // namespace sim
+
+#endif // SIM_H
@@ -0,0 +1,280 @@
+//
+// Touch trace replay: feeds recorded touch sessions (see TouchTrace.h)
+// through TouchSequence::update()/getGesture() on the simulated MPR121 and
+// compares the result with the gesture each session was reported as.
+// Reports the accuracy per gesture and the host CPU cycles per event.
+//
+//   trace_replay [-a pct] FILE...    replays binary traces or serial logs
+//   trace_replay -g N [-s seed] FILE writes N sessions of the benchmark
+//                                    scenarios with timing jitter
+//
+// The electrode of a generated session is 0xFF, which matches any.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+#include "TouchSequence.h"
+#include "TouchTrace.h"
+#include "MPR121Sim.h"
+#include "Scenarios.h"
+
+#define ANY_TRACE_ELECTRODE 0xFF
+// idle time recorded between generated sessions
+#define SESSION_GAP_MS      2000
+
+static const byte mpr121Addr    = 0x5A;
+static const byte mpr121IntPin  = 1;
+
+static MPR121Sim mpr121(mpr121Addr, mpr121IntPin);
+static TouchSequence touch(mpr121Addr, mpr121IntPin);
+
+struct GestureStats {
+    unsigned long sessions;
+    unsigned long correct;
+    unsigned long updates;
+    unsigned long long updateCycles;
+    unsigned long long gestureCycles;
+    // what the sessions of this gesture were recognized as
+    unsigned long as[16];
+};
+
+static const char *gestureNames[16] = {
+    "unknown", "tap", "double tap", "swipe up", "swipe down", "swipe left",
+    "swipe right", "proximity", "chord", "id 9", "id 10", "id 11", "id 12",
+    "id 13", "id 14", "id 15",
+};
+
+// returns false if the file could not be read or is not a trace
+static bool
+readTrace(const char *path, std::vector<TraceRecord> &records)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        return false;
+    }
+    std::vector<uint8_t> data;
+    uint8_t chunk[4096];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0)
+        data.insert(data.end(), chunk, chunk + n);
+    fclose(f);
+
+    // a serial log holds the records as hex lines
+    size_t prefix = strlen(TRACE_PREFIX);
+    bool log = false;
+    for (size_t i = 0; i + prefix <= data.size(); ++i) {
+        if ((i == 0 || data[i - 1] == '\n') &&
+                !memcmp(&data[i], TRACE_PREFIX, prefix)) {
+            uint8_t buf[TRACE_RECORD_SIZE];
+            unsigned int b;
+            size_t j = 0;
+            for (; j < sizeof(buf) && i + prefix + 2 * j + 2 <= data.size();
+                    ++j) {
+                char hex[3] = { (char)data[i + prefix + 2 * j],
+                                (char)data[i + prefix + 2 * j + 1], 0 };
+                if (sscanf(hex, "%2x", &b) != 1)
+                    break;
+                buf[j] = b;
+            }
+            if (j == sizeof(buf))
+                records.push_back(traceDecode(buf));
+            log = true;
+        }
+    }
+    if (log)
+        return true;
+
+    if (data.size() % TRACE_RECORD_SIZE) {
+        fprintf(stderr, "%s: not a trace\n", path);
+        return false;
+    }
+    for (size_t i = 0; i < data.size(); i += TRACE_RECORD_SIZE)
+        records.push_back(traceDecode(&data[i]));
+    return true;
+}
+
+static void
+setStatus(unsigned int status)
+{
+    for (byte ch = 0; ch < MPR121_CHANNELS; ++ch)
+        mpr121.setDelta(ch, status & (1 << ch) ? MPR121Sim::TOUCH_DELTA : 0);
+}
+
+static void
+replay(const std::vector<TraceRecord> &records, GestureStats *stats)
+{
+    unsigned long now = millis();
+    GestureStats pending;
+    memset(&pending, 0, sizeof(pending));
+
+    for (size_t i = 0; i < records.size(); ++i) {
+        const TraceRecord &r = records[i];
+        now += r.ms;
+        if (sim::now() < now * 1000ULL)
+            sim::advance(now * 1000ULL - sim::now());
+
+        if (!(r.status & TRACE_END)) {
+            setStatus(r.status);
+            unsigned long long c = sim::cycles();
+            touch.update(now);
+            pending.updateCycles += sim::cycles() - c;
+            pending.updates++;
+            continue;
+        }
+
+        byte expected = TRACE_GESTURE(r.status);
+        byte electrode = TRACE_ELECTRODE(r.status);
+        unsigned long long c = sim::cycles();
+        TouchGesture gesture = touch.getGesture();
+        byte got = gesture == TOUCH_CHORD ? touch.getChord() :
+            touch.getLastTouch();
+        unsigned long long gestureCycles = sim::cycles() - c;
+
+        GestureStats &s = stats[expected];
+        s.sessions++;
+        if (gesture == expected &&
+                (electrode == ANY_TRACE_ELECTRODE || electrode == got))
+            s.correct++;
+        s.as[gesture & 0x0F]++;
+        s.updates += pending.updates;
+        s.updateCycles += pending.updateCycles;
+        s.gestureCycles += gestureCycles;
+        memset(&pending, 0, sizeof(pending));
+
+        // start the next session with nothing touched
+        setStatus(0);
+        touch.update(now);
+        touch.clear();
+    }
+}
+
+static int
+generate(const char *path, unsigned long sessions, unsigned long seed)
+{
+    FILE *f = fopen(path, "wb");
+    if (!f) {
+        perror(path);
+        return 1;
+    }
+    srand(seed);
+    unsigned long records = 0;
+    for (unsigned long n = 0; n < sessions; ++n) {
+        const Scenario &s = scenarios[rand() % NUM_SCENARIOS];
+        // stretch the gesture by up to +-15% and jitter each step by +-5ms
+        double scale = 0.85 + (rand() % 31) / 100.0;
+        unsigned int status = 0;
+        unsigned long prev = 0, at = 0;
+        uint8_t buf[TRACE_RECORD_SIZE];
+        TraceRecord r;
+
+        for (byte i = 0; i < s.steps; ++i) {
+            const ScenarioStep &step = s.step[i];
+            long t = (long)(step.atMs * scale) + rand() % 11 - 5;
+            at = i == 0 ? 0 : t < (long)prev + 1 ? prev + 1 : t;
+            if (step.down)
+                status |= 1 << step.channel;
+            else
+                status &= ~(1 << step.channel);
+            r.ms = i == 0 ? SESSION_GAP_MS : at - prev;
+            r.status = status;
+            traceEncode(r, buf);
+            fwrite(buf, sizeof(buf), 1, f);
+            prev = at;
+            records++;
+        }
+        r.ms = 0;
+        r.status = traceEnd(s.expected, ANY_TRACE_ELECTRODE);
+        traceEncode(r, buf);
+        fwrite(buf, sizeof(buf), 1, f);
+        records++;
+    }
+    fclose(f);
+    printf("trace: %lu sessions, %lu records, %lu bytes -> %s\n", sessions,
+            records, records * TRACE_RECORD_SIZE, path);
+    return 0;
+}
+
+static void
+usage()
+{
+    fprintf(stderr, "usage: trace_replay [-a pct] FILE...\n"
+                    "       trace_replay -g sessions [-s seed] FILE\n");
+    exit(2);
+}
+
+int
+main(int argc, char **argv)
+{
+    unsigned long sessions = 0, seed = 1;
+    double minAccuracy = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "a:g:s:")) != -1) {
+        switch (opt) {
+            case 'a': minAccuracy = atof(optarg);           break;
+            case 'g': sessions = strtoul(optarg, NULL, 0);  break;
+            case 's': seed = strtoul(optarg, NULL, 0);      break;
+            default: usage();
+        }
+    }
+    if (optind >= argc)
+        usage();
+    if (sessions)
+        return generate(argv[optind], sessions, seed);
+
+    // any status bit of a recorded switch maps to an enabled channel
+    MPR121Settings settings;
+    settings.electrodes = 12;
+    settings.proximityMode = 1;
+    GestureSettings gestures;
+    touch.begin(settings);
+    touch.setTouchThreshold(2, ELECTRODE_PROXIMITY);
+    touch.setReleaseThreshold(1, ELECTRODE_PROXIMITY);
+    touch.setGestures(gestures.getEnabled(), gestures.getDoubleTap());
+    touch.setTiming(gestures.chordMs, gestures.swipeMs);
+
+    GestureStats stats[16];
+    memset(stats, 0, sizeof(stats));
+    for (int i = optind; i < argc; ++i) {
+        std::vector<TraceRecord> records;
+        if (!readTrace(argv[i], records))
+            return 1;
+        replay(records, stats);
+    }
+
+    printf("%-12s %8s %8s %8s %10s %11s  %s\n", "gesture", "sessions",
+            "correct", "accuracy", "cyc/update", "cyc/gesture",
+            "recognized as");
+    GestureStats total;
+    memset(&total, 0, sizeof(total));
+    for (int g = 0; g < 16; ++g) {
+        const GestureStats &s = stats[g];
+        if (!s.sessions)
+            continue;
+        printf("%-12s %8lu %8lu %7.1f%% %10.0f %11.0f ", gestureNames[g],
+                s.sessions, s.correct, 100.0 * s.correct / s.sessions,
+                s.updates ? (double)s.updateCycles / s.updates : 0.0,
+                (double)s.gestureCycles / s.sessions);
+        for (int a = 0; a < 16; ++a)
+            if (a != g && s.as[a])
+                printf(" %s:%lu", gestureNames[a], s.as[a]);
+        printf("\n");
+        total.sessions += s.sessions;
+        total.correct += s.correct;
+        total.updates += s.updates;
+        total.updateCycles += s.updateCycles;
+        total.gestureCycles += s.gestureCycles;
+    }
+    if (!total.sessions) {
+        printf("no sessions\n");
+        return 1;
+    }
+    double accuracy = 100.0 * total.correct / total.sessions;
+    printf("%-12s %8lu %8lu %7.1f%% %10.0f %11.0f\n", "total",
+            total.sessions, total.correct, accuracy,
+            total.updates ? (double)total.updateCycles / total.updates : 0.0,
+            (double)total.gestureCycles / total.sessions);
+    return accuracy < minAccuracy ? 1 : 0;
+}
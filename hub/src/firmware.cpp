@@ -4,6 +4,9 @@
 #include <RFM12B.h>
 #include "SwitchProtocol.h"
 #include "SwitchSettings.h"
+#include "CompactCodec.h"
+#include "SequenceFilter.h"
+#include "CommandQueue.h"
 #include "CmdMessenger.h"
 
 RFM12B radio;
@@ -12,6 +15,9 @@ RFM12B radio;
 #define NETWORKID   1
 #define FREQUENCY   RF12_915MHZ
 #define ACK_TIME    30  // # of ms to wait for an ack
+// the CompactCodec version selected for the switches offering one, 0 keeps
+// them on the structs
+#define HUB_ENCODING    COMPACT_VERSION
 
 #define CMD_MSG             0
 #define CMD_ACK             1
@@ -23,37 +29,21 @@ RFM12B radio;
 #define CMD_GET_I2C         7
 #define CMD_SET_I2C         8
 #define CMD_STATUS_REQUEST  9
+#define CMD_TOUCH_CORRECTION 10
+#define CMD_STREAM_DATA     11
+#define CMD_STREAM_REQUEST  12
+#define CMD_SLIDER_DATA     13
+#define CMD_ENERGY_EVENT    14
+#define CMD_LOG_REQUEST     15
+#define CMD_LOG_DATA        16
+#define CMD_BOOT_EVENT      17
+#define CMD_SET_BYTES       18
 
 CmdMessenger cmd(Serial);
-struct {
-    byte nodeId;
-    byte pkt[RF12_MAXDATA];
-    byte *current;
-
-    void reset() {
-        nodeId = 0;
-        current = pkt;
-    }
-
-    bool available(byte sz) {
-        return sizeof(pkt) - (current - pkt) >= sz;
-    }
+CommandQueue command;
 
-    byte *reserve(byte nodeId, byte size) {
-        if (nodeId != this->nodeId)
-            reset();
-        if (!available(size))
-            return NULL;
-        this->nodeId = nodeId;
-        byte *ret = current;
-        current += size;
-        return ret;
-    }
-
-    byte length() {
-        return current - pkt;
-    }
-} command;
+// drops the events switches send again after a lost ACK
+SequenceFilter sequences;
 
 void onUnknownCommand() {
     cmd.sendCmd(CMD_MSG, "Unknown command");
@@ -106,10 +96,75 @@ void onSetByteCommand() {
     cmd.sendCmdEnd();
 }
 
+byte hexValue(char c) {
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return 0xFF;
+}
+
+/* Sets consecutive settings bytes, given as a hex string.  The serial
+   buffer holds a few dozen bytes per command, a command continuing the
+   range of the previous one extends its CONFIGURE_RANGE packet. */
+void onSetBytesCommand() {
+    byte nodeId = (byte)cmd.readInt16Arg();
+    byte offset = (byte)cmd.readInt16Arg();
+    char *hex = cmd.readStringArg();
+    byte count = hex ? strlen(hex) / 2 : 0;
+    for (byte i = 0; i < 2 * count; ++i) {
+        if (hexValue(hex[i]) > 0xF)
+            count = 0;
+    }
+    if (!count || hex[2 * count]) {
+        cmd.sendCmd(CMD_MSG, "bad hex bytes");
+        return;
+    }
+
+    SwitchConfigureRange *pkt = command.range;
+    byte *value;
+    if (pkt && command.nodeId == nodeId &&
+            (byte *)pkt + pkt->len == command.current &&
+            pkt->offset + pkt->count == offset &&
+            pkt->count + count <= CONFIGURE_RANGE_SIZE &&
+            command.available(count)) {
+        value = command.reserve(nodeId, count);
+    }
+    else {
+        byte fixed = sizeof(SwitchConfigureRange) - CONFIGURE_RANGE_SIZE;
+        pkt = (SwitchConfigureRange *)command.reserve(nodeId, fixed + count);
+        if (!pkt) {
+            cmd.sendCmd(CMD_MSG, "too many commands");
+            return;
+        }
+        pkt->type = SwitchPacket::CONFIGURE_RANGE;
+        pkt->len = fixed;
+        pkt->offset = offset;
+        pkt->count = 0;
+        value = pkt->value;
+        command.range = pkt;
+    }
+    for (byte i = 0; i < count; ++i)
+        value[i] = (hexValue(hex[2 * i]) << 4) | hexValue(hex[2 * i + 1]);
+    pkt->len += count;
+    pkt->count += count;
+    cmd.sendCmdStart(CMD_ACK);
+    cmd.sendCmdArg(nodeId);
+    cmd.sendCmdArg(pkt->offset);
+    cmd.sendCmdArg(pkt->count);
+    cmd.sendCmdEnd();
+}
+
 void onGetI2CCommand() {
     byte nodeId = (byte)cmd.readInt16Arg();
     byte address = (byte)cmd.readInt16Arg();
     byte reg = (byte)cmd.readInt16Arg();
+    // optional, defaults to a single register
+    byte count = (byte)cmd.readInt16Arg();
+    if (!count)
+        count = 1;
     SwitchI2CRequest *pkt = (SwitchI2CRequest *)command.reserve(
             nodeId, sizeof(SwitchI2CRequest));
     if (!pkt) {
@@ -120,10 +175,12 @@ void onGetI2CCommand() {
     pkt->len = sizeof(SwitchI2CRequest);
     pkt->address = address;
     pkt->reg = reg;
+    pkt->count = count;
     cmd.sendCmdStart(CMD_ACK);
     cmd.sendCmdArg(nodeId);
     cmd.sendCmdArg(address);
     cmd.sendCmdArg(reg);
+    cmd.sendCmdArg(count);
     cmd.sendCmdEnd();
 }
 
@@ -164,6 +221,45 @@ void onStatusRequestCommand() {
     cmd.sendCmd(CMD_ACK, "ok");
 }
 
+void onStreamRequestCommand() {
+    byte nodeId = (byte)cmd.readInt16Arg();
+    byte period = (byte)cmd.readInt16Arg();
+    // the count is unsigned, above the int16 range of readInt16Arg()
+    long samples = cmd.readInt32Arg();
+    if (samples < 0 || samples > 0xFFFF) {
+        cmd.sendCmd(CMD_MSG, "bad sample count");
+        return;
+    }
+    SwitchStreamRequest *pkt = (SwitchStreamRequest *)command.reserve(
+            nodeId, sizeof(SwitchStreamRequest));
+    if (!pkt) {
+        cmd.sendCmd(CMD_MSG, "too many commands");
+        return;
+    }
+    pkt->type = SwitchPacket::STREAM_REQUEST;
+    pkt->len = sizeof(SwitchStreamRequest);
+    pkt->period = period;
+    pkt->samples = samples;
+    cmd.sendCmdStart(CMD_ACK);
+    cmd.sendCmdArg(nodeId);
+    cmd.sendCmdArg(period);
+    cmd.sendCmdArg(samples);
+    cmd.sendCmdEnd();
+}
+
+void onLogRequestCommand() {
+    byte nodeId = (byte)cmd.readInt16Arg();
+    SwitchPacket *pkt = (SwitchPacket *)command.reserve(
+            nodeId, sizeof(SwitchPacket));
+    if (!pkt) {
+        cmd.sendCmd(CMD_MSG, "too many commands");
+        return;
+    }
+    pkt->type = SwitchPacket::LOG_REQUEST;
+    pkt->len = sizeof(SwitchPacket);
+    cmd.sendCmd(CMD_ACK, "ok");
+}
+
 void setup() {
     Serial.begin(115200);
     radio.Initialize(NODEID, FREQUENCY, NETWORKID);
@@ -174,65 +270,257 @@ void setup() {
     cmd.attach(CMD_RESET, onResetCommand);
     cmd.attach(CMD_DUMP_SETTINGS, onDumpCommand);
     cmd.attach(CMD_SET_BYTE, onSetByteCommand);
+    cmd.attach(CMD_SET_BYTES, onSetBytesCommand);
     cmd.attach(CMD_GET_I2C, onGetI2CCommand);
     cmd.attach(CMD_SET_I2C, onSetI2CCommand);
     cmd.attach(CMD_STATUS_REQUEST, onStatusRequestCommand);
+    cmd.attach(CMD_STREAM_REQUEST, onStreamRequestCommand);
+    cmd.attach(CMD_LOG_REQUEST, onLogRequestCommand);
     cmd.sendCmd(CMD_MSG, "Initialized...");
 }
 
-void handleTouchEvent(byte nodeId) {
-    if (*radio.DataLen != sizeof(TouchEvent)) {
+/* The events of a protocol version 1 switch come without the gang, they
+   are of gang 0 */
+void handleTouchEvent(byte nodeId, SwitchPacket *header) {
+    // protocol 1 events end before gang, 2 before electrodeHigh
+    if (header->len > sizeof(TouchEvent) ||
+            header->len < sizeof(TouchEvent) - 2) {
         cmd.sendCmd(CMD_MSG, "bad touch event payload");
         return;
     }
-    TouchEvent pkt = *(TouchEvent *)radio.Data;
+    TouchEvent pkt;
+    pkt.gang = 0;
+    memcpy((void *)&pkt, header, header->len);
     cmd.sendCmdStart(CMD_TOUCH_EVENT);
     cmd.sendCmdArg(nodeId);
     cmd.sendCmdArg(pkt.gesture);
-    cmd.sendCmdArg(pkt.electrode);
+    cmd.sendCmdArg(pkt.electrode | (unsigned int)pkt.electrodeHigh << 8);
     cmd.sendCmdArg(pkt.repeat);
+    cmd.sendCmdArg(pkt.gang);
     cmd.sendCmdEnd();
 }
 
-void handleStatusUpdate(byte nodeId) {
-    if (*radio.DataLen != sizeof(SwitchStatus)) {
+void handleTouchCorrection(byte nodeId, SwitchPacket *header) {
+    // protocol 1 corrections end before gang, 2 before the high bits
+    if (header->len != sizeof(TouchCorrection) &&
+            header->len != sizeof(TouchCorrection) - 2 &&
+            header->len != sizeof(TouchCorrection) - 3) {
+        cmd.sendCmd(CMD_MSG, "bad touch correction payload");
+        return;
+    }
+    TouchCorrection pkt;
+    pkt.gang = 0;
+    memcpy((void *)&pkt, header, header->len);
+    cmd.sendCmdStart(CMD_TOUCH_CORRECTION);
+    cmd.sendCmdArg(nodeId);
+    cmd.sendCmdArg(pkt.reportedGesture);
+    cmd.sendCmdArg(pkt.reportedElectrode |
+            (unsigned int)pkt.reportedElectrodeHigh << 8);
+    cmd.sendCmdArg(pkt.gesture);
+    cmd.sendCmdArg(pkt.electrode | (unsigned int)pkt.electrodeHigh << 8);
+    cmd.sendCmdArg(pkt.gang);
+    cmd.sendCmdEnd();
+}
+
+void handleStatusUpdate(byte nodeId, SwitchPacket *header) {
+    SwitchStatus pkt;
+    if (header->len == sizeof(SwitchStatusV1)) {
+        // protocol 1 switches estimate nothing and count no wakes
+        SwitchStatusV1 *old = (SwitchStatusV1 *)header;
+        pkt.batteryLevel = old->batteryLevel;
+        pkt.batteryDays = 0xFFFF;
+        pkt.statusCount = old->statusCount;
+        pkt.touchWakes = 0;
+        pkt.falseWakes = 0;
+        pkt.settingsCrc = 0;
+        pkt.droppedEvents = 0;
+    } else if (header->len == sizeof(SwitchStatus) ||
+            header->len == sizeof(SwitchStatus) - sizeof(pkt.droppedEvents)) {
+        // protocol 2 and 3 statuses end before droppedEvents
+        pkt.droppedEvents = 0;
+        memcpy((void *)&pkt, header, header->len);
+    } else {
         cmd.sendCmd(CMD_MSG, "bad status event payload");
         return;
     }
-    SwitchStatus pkt = *(SwitchStatus *)radio.Data;
     cmd.sendCmdStart(CMD_STATUS_EVENT);
     cmd.sendCmdArg(nodeId);
     cmd.sendCmdArg(pkt.batteryLevel);
+    cmd.sendCmdArg(pkt.batteryDays);
     cmd.sendCmdArg(pkt.statusCount);
+    cmd.sendCmdArg(pkt.touchWakes);
+    cmd.sendCmdArg(pkt.falseWakes);
+    cmd.sendCmdArg(pkt.settingsCrc);
+    cmd.sendCmdArg(pkt.droppedEvents);
+    cmd.sendCmdEnd();
+}
+
+void handleEnergyStatus(byte nodeId, SwitchPacket *header) {
+    if (header->len != sizeof(SwitchEnergy)) {
+        cmd.sendCmd(CMD_MSG, "bad energy status payload");
+        return;
+    }
+    SwitchEnergy pkt = *(SwitchEnergy *)header;
+    cmd.sendCmdStart(CMD_ENERGY_EVENT);
+    cmd.sendCmdArg(nodeId);
+    cmd.sendCmdArg(pkt.awakeMs);
+    cmd.sendCmdArg(pkt.standbyMs);
+    cmd.sendCmdArg(pkt.i2cMs);
+    cmd.sendCmdArg(pkt.txMs);
+    cmd.sendCmdArg(pkt.ackWaitMs);
+    cmd.sendCmdArg(pkt.wakes);
+    cmd.sendCmdEnd();
+}
+
+/* Forwards the boot times and the protocol version of the switch, version
+   1 switches send no version */
+void handleBootStatus(byte nodeId, SwitchPacket *header) {
+    if (header->len != sizeof(SwitchBoot) &&
+            header->len != sizeof(SwitchBoot) - 1) {
+        cmd.sendCmd(CMD_MSG, "bad boot status payload");
+        return;
+    }
+    SwitchBoot pkt;
+    pkt.protocol = 1;
+    memcpy((void *)&pkt, header, header->len);
+    if (pkt.protocol > SWITCH_PROTOCOL_VERSION)
+        cmd.sendCmd(CMD_MSG, "switch protocol is newer, upgrade the hub");
+    cmd.sendCmdStart(CMD_BOOT_EVENT);
+    cmd.sendCmdArg(nodeId);
+    cmd.sendCmdArg(pkt.flags);
+    for (byte i = 0; i < BOOT_PHASES; ++i)
+        cmd.sendCmdArg(pkt.phaseUs[i]);
+    cmd.sendCmdArg(pkt.protocol);
     cmd.sendCmdEnd();
 }
 
-void handleSettingsDump(byte nodeId) {
-    if (*radio.DataLen != sizeof(SwitchDumpSettings)) {
+void handleSettingsDump(byte nodeId, SwitchPacket *header) {
+    if (header->len != sizeof(SwitchDumpSettings)) {
         cmd.sendCmd(CMD_MSG, "bad settings dump payload");
         return;
     }
-    SwitchDumpSettings pkt = *(SwitchDumpSettings *)radio.Data;
+    SwitchDumpSettings pkt = *(SwitchDumpSettings *)header;
     cmd.sendCmdStart(CMD_DUMP_SETTINGS);
     cmd.sendCmdArg(nodeId);
     cmd.sendCmdBinArg(pkt.settings);
     cmd.sendCmdEnd();
 }
 
-void handleI2CReply(byte nodeId) {
-    if (*radio.DataLen != sizeof(SwitchI2CReply)) {
-        cmd.sendCmd(CMD_MSG, "bad i2c reply payload");
-        return;
+void handleI2CReply(byte nodeId, SwitchPacket *header) {
+    SwitchI2CReply *pkt = (SwitchI2CReply *)header;
+    byte head = sizeof(SwitchI2CReply) - I2C_MAX_READ;
+    // protocol 1 replies hold a single value where count is now, a failed
+    // read of later switches carries count 0 and a value
+    byte count = 1;
+    const unsigned char *val = &pkt->count;
+    if (header->len != head) {
+        if (header->len > sizeof(SwitchI2CReply) ||
+                pkt->count > I2C_MAX_READ ||
+                header->len != head + (pkt->count ? pkt->count : 1)) {
+            cmd.sendCmd(CMD_MSG, "bad i2c reply payload");
+            return;
+        }
+        count = pkt->count;
+        val = pkt->val;
     }
-    SwitchI2CReply pkt = *(SwitchI2CReply *)radio.Data;
     cmd.sendCmdStart(CMD_GET_I2C);
     cmd.sendCmdArg(nodeId);
-    cmd.sendCmdArg(pkt.address);
-    cmd.sendCmdArg(pkt.reg);
-    cmd.sendCmdArg(pkt.val);
+    cmd.sendCmdArg(pkt->address);
+    cmd.sendCmdArg(pkt->reg);
+    cmd.sendCmdArg(count);
+    for (byte i = 0; i < count; ++i)
+        cmd.sendCmdArg(val[i]);
     cmd.sendCmdEnd();
 }
 
+void handleStreamData(byte nodeId, SwitchPacket *header) {
+    SwitchStreamData *pkt = (SwitchStreamData *)header;
+    if (header->len > sizeof(SwitchStreamData) ||
+            header->len < sizeof(SwitchStreamData) - STREAM_DATA_SIZE) {
+        cmd.sendCmd(CMD_MSG, "bad stream data payload");
+        return;
+    }
+    // forwarded as a single binary argument, unused data bytes are zero so
+    // the PC side decodes from the sample count alone
+    SwitchStreamData data;
+    memset(data.data, 0, sizeof(data.data));
+    memcpy(&data, pkt, header->len);
+    cmd.sendCmdStart(CMD_STREAM_DATA);
+    cmd.sendCmdArg(nodeId);
+    cmd.sendCmdBinArg(data);
+    cmd.sendCmdEnd();
+}
+
+void handleSliderData(byte nodeId, SwitchPacket *header) {
+    SwitchSliderData *pkt = (SwitchSliderData *)header;
+    byte fixed = sizeof(SwitchSliderData) - SLIDER_MAX_DELTAS;
+    if (header->len < fixed || pkt->samples > SLIDER_MAX_DELTAS + 1 ||
+            header->len != fixed + (pkt->samples ? pkt->samples - 1 : 0)) {
+        cmd.sendCmd(CMD_MSG, "bad slider data payload");
+        return;
+    }
+    // forwarded as absolute positions
+    cmd.sendCmdStart(CMD_SLIDER_DATA);
+    cmd.sendCmdArg(nodeId);
+    cmd.sendCmdArg(pkt->gang);
+    cmd.sendCmdArg(pkt->sequence);
+    cmd.sendCmdArg(pkt->flags);
+    cmd.sendCmdArg(pkt->period);
+    cmd.sendCmdArg(pkt->samples);
+    byte position = pkt->position;
+    for (byte i = 0; i < pkt->samples; ++i) {
+        if (i)
+            position += pkt->delta[i - 1];
+        cmd.sendCmdArg(position);
+    }
+    cmd.sendCmdEnd();
+}
+
+void handleLogData(byte nodeId, SwitchPacket *header) {
+    SwitchLogData *pkt = (SwitchLogData *)header;
+    if (header->len > sizeof(SwitchLogData) ||
+            header->len < sizeof(SwitchLogData) - LOG_DATA_SIZE) {
+        cmd.sendCmd(CMD_MSG, "bad log data payload");
+        return;
+    }
+    // forwarded as a single binary argument, the PC side takes the records
+    // from the packet length
+    SwitchLogData data;
+    memset(data.data, 0, sizeof(data.data));
+    memcpy(&data, pkt, header->len);
+    cmd.sendCmdStart(CMD_LOG_DATA);
+    cmd.sendCmdArg(nodeId);
+    cmd.sendCmdBinArg(data);
+    cmd.sendCmdEnd();
+}
+
+/* Answers the encoding a switch offers with its status.  The answer waits
+   for the next offer if commands for another switch are pending. */
+void handleEncoding(byte nodeId, SwitchPacket *header) {
+    if (header->len != sizeof(SwitchEncoding)) {
+        cmd.sendCmd(CMD_MSG, "bad encoding payload");
+        return;
+    }
+    if (command.length() && command.nodeId != nodeId)
+        return;
+    SwitchEncoding *offer = (SwitchEncoding *)header;
+    SwitchEncoding *pkt = (SwitchEncoding *)command.reserve(
+            nodeId, sizeof(SwitchEncoding));
+    if (!pkt)
+        return;
+    pkt->type = SwitchPacket::ENCODING;
+    pkt->len = sizeof(SwitchEncoding);
+    pkt->version = min(offer->version, HUB_ENCODING);
+}
+
+void handleSequence(byte nodeId, SwitchPacket *header) {
+    if (header->len != sizeof(SwitchSequence)) {
+        cmd.sendCmd(CMD_MSG, "bad sequence payload");
+        return;
+    }
+    sequences.sequence(nodeId, *(SwitchSequence *)header);
+}
+
 void handleIncomingPacket() {
     if (!radio.CRCPass()) {
         return;
@@ -241,23 +529,72 @@ void handleIncomingPacket() {
     byte nodeId = radio.GetSender();
     byte data[RF12_MAXDATA];
     byte datalen = *radio.DataLen;
-    memcpy(data, (void *)radio.Data, datalen);
+    if (datalen && COMPACT_IS_MARKER(radio.Data[0])) {
+        // the switch sends no more than the structs fit in a packet
+        datalen = compactDecode((const byte *)radio.Data, datalen, data,
+                                sizeof(data));
+        // not acknowledged, the switch sends its events again
+        if (!datalen) {
+            cmd.sendCmd(CMD_MSG, "bad compact packet");
+            return;
+        }
+    }
+    else
+        memcpy(data, (void *)radio.Data, datalen);
     unsigned char offset = 0;
     bool ackRequested = radio.ACKRequested();
-    while (offset < datalen) {
+    SwitchSequence *numbered = NULL;
+    // a packet holds one or more sub-packets, e.g. the touch events of
+    // several gangs.  The events of a retry that were seen before are
+    // acknowledged again but not forwarded.
+    sequences.start();
+    while (offset + sizeof(SwitchPacket) <= datalen) {
         SwitchPacket *header = (SwitchPacket *)(data + offset);
+        if (header->len < sizeof(SwitchPacket) ||
+                offset + header->len > datalen) {
+            cmd.sendCmd(CMD_MSG, "bad packet length");
+            break;
+        }
         switch (header->type) {
+            case SwitchPacket::SEQUENCE:
+                handleSequence(nodeId, header);
+                if (header->len == sizeof(SwitchSequence))
+                    numbered = (SwitchSequence *)header;
+                break;
             case SwitchPacket::TOUCH_EVENT:
-                handleTouchEvent(nodeId);
+                if (sequences.accept(nodeId))
+                    handleTouchEvent(nodeId, header);
+                break;
+            case SwitchPacket::TOUCH_CORRECTION:
+                if (sequences.accept(nodeId))
+                    handleTouchCorrection(nodeId, header);
                 break;
             case SwitchPacket::STATUS_UPDATE:
-                handleStatusUpdate(nodeId);
+                handleStatusUpdate(nodeId, header);
+                break;
+            case SwitchPacket::ENERGY_STATUS:
+                handleEnergyStatus(nodeId, header);
+                break;
+            case SwitchPacket::BOOT_STATUS:
+                handleBootStatus(nodeId, header);
                 break;
             case SwitchPacket::DUMP_REPLY:
-                handleSettingsDump(nodeId);
+                handleSettingsDump(nodeId, header);
                 break;
             case SwitchPacket::I2C_REPLY:
-                handleI2CReply(nodeId);
+                handleI2CReply(nodeId, header);
+                break;
+            case SwitchPacket::STREAM_DATA:
+                handleStreamData(nodeId, header);
+                break;
+            case SwitchPacket::SLIDER_DATA:
+                handleSliderData(nodeId, header);
+                break;
+            case SwitchPacket::LOG_DATA:
+                handleLogData(nodeId, header);
+                break;
+            case SwitchPacket::ENCODING:
+                handleEncoding(nodeId, header);
                 break;
             default:
                 cmd.sendCmd(CMD_MSG, "unknown event");
@@ -267,10 +604,12 @@ void handleIncomingPacket() {
     }
 
     if (ackRequested) {
+        command.received(nodeId, numbered);
         if (command.nodeId == nodeId) {
-            cmd.sendCmd(0, "Sending command packet");
+            cmd.sendCmd(0, command.sent ? "Sending command packet again" :
+                        "Sending command packet");
             radio.SendACK((void *)&command.pkt, command.length());
-            command.reset();
+            command.acked(numbered);
         }
         else
             radio.SendACK();
@@ -0,0 +1,88 @@
+#ifndef COMMANDQUEUE_H
+#define COMMANDQUEUE_H
+
+#if ARDUINO >= 100
+  #include <Arduino.h> // Arduino 1.0
+#else
+  #include <WProgram.h> // Arduino 0022
+#endif
+
+#include "SwitchProtocol.h"
+
+// The commands of the hub for a single switch, sent with the ACK of its
+// next packet.  The bytes sent with the ACK of a numbered packet are kept
+// until the switch shows it got them: the ACK may be lost or cut off, and
+// the switch then sends the events again with the same number flagged
+// SEQUENCE_RETRY before anything else.  Any other packet from it means the
+// ACK arrived.
+struct CommandQueue {
+    byte nodeId;
+    byte pkt[RF12_MAXDATA];
+    byte *current;
+    // the last CONFIGURE_RANGE, extended while it is the last sub-packet
+    SwitchConfigureRange *range;
+    // the first sent bytes went out with the ACK of the packet numbered
+    // sequence
+    byte sent;
+    byte sequence;
+
+    void reset() {
+        nodeId = 0;
+        current = pkt;
+        range = NULL;
+        sent = 0;
+    }
+
+    // the switch got the sent bytes, the commands queued since stay
+    void delivered() {
+        byte queued = length() - sent;
+        memmove(pkt, pkt + sent, queued);
+        current = pkt + queued;
+        sent = 0;
+        if (!queued)
+            reset();
+    }
+
+    // takes a packet from nodeId, numbered is its SwitchSequence or NULL.
+    // Only a retry of the packet the sent bytes answered leaves them.
+    void received(byte nodeId, const SwitchSequence *numbered) {
+        if (nodeId == this->nodeId && sent &&
+                !(numbered && (numbered->flags & SEQUENCE_RETRY) &&
+                  numbered->sequence == sequence))
+            delivered();
+    }
+
+    // the ACK of the packet took the commands, a packet without a
+    // SwitchSequence is not sent again so they are dropped.  Sent
+    // sub-packets are not extended.
+    void acked(const SwitchSequence *numbered) {
+        if (numbered) {
+            sent = length();
+            sequence = numbered->sequence;
+            range = NULL;
+        }
+        else
+            reset();
+    }
+
+    bool available(byte sz) {
+        return sizeof(pkt) - (current - pkt) >= sz;
+    }
+
+    byte *reserve(byte nodeId, byte size) {
+        if (nodeId != this->nodeId)
+            reset();
+        if (!available(size))
+            return NULL;
+        this->nodeId = nodeId;
+        byte *ret = current;
+        current += size;
+        return ret;
+    }
+
+    byte length() {
+        return current - pkt;
+    }
+};
+
+#endif // COMMANDQUEUE_H
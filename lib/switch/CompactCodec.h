@@ -0,0 +1,314 @@
+#ifndef COMPACTCODEC_H
+#define COMPACTCODEC_H
+
+#if ARDUINO >= 100
+  #include <Arduino.h> // Arduino 1.0
+#else
+  #include <WProgram.h> // Arduino 0022
+#endif
+
+#include "SwitchProtocol.h"
+
+// The compact encoding of a packet of SwitchPacket structs, negotiated with
+// ENCODING packets.  A compact packet starts with COMPACT_MARKER | version,
+// the first byte of a packet of structs is a PacketType and always below
+// it.  Each sub-packet then starts with a byte holding its COMPACT_* type
+// in the top 3 bits and the length of what follows in the lower 5:
+//   TOUCH:      gesture << 4 | electrode, repeat, gang
+//   CORRECTION: reportedGesture << 4 | reportedElectrode,
+//               gesture << 4 | electrode, gang
+//   STATUS:     batteryLevel - COMPACT_VCC_MV (zigzag varint),
+//               batteryDays + 1 (varint, 0 for unknown), statusCount,
+//               touchWakes, falseWakes, droppedEvents (varints, version
+//               3), settingsCrc (16 bit)
+//   ENERGY:     the counters of SwitchEnergy (varints)
+//   SEQUENCE:   sequence, flags (version 2)
+//   STRUCT:     the struct of any other sub-packet as it is
+// Trailing zero bytes of TOUCH, CORRECTION and SEQUENCE are left out.  A varint is
+// 7 bits per byte, least significant first, the top bit set on all but the
+// last byte.  Packets from the hub are always structs.
+#define COMPACT_VERSION     3
+#define COMPACT_MARKER      0xC0
+#define COMPACT_IS_MARKER(b) (((b) & 0xF0) == COMPACT_MARKER)
+
+#define COMPACT_TOUCH       0
+#define COMPACT_CORRECTION  1
+#define COMPACT_STATUS      2
+#define COMPACT_ENERGY      3
+#define COMPACT_SEQUENCE    4
+#define COMPACT_STRUCT      7
+#define COMPACT_MAX_LEN     0x1F
+
+// the battery level is sent as the difference to this
+#define COMPACT_VCC_MV      3300
+
+// writes v as a varint to p, returns its length
+static inline byte
+compactPutVarint(byte *p, unsigned long v)
+{
+    byte n = 0;
+    while (v >= 0x80) {
+        p[n++] = (v & 0x7F) | 0x80;
+        v >>= 7;
+    }
+    p[n++] = v;
+    return n;
+}
+
+// reads the varint at p into v, returns its length, 0 if it does not end
+// before end
+static inline byte
+compactGetVarint(const byte *p, const byte *end, unsigned long &v)
+{
+    v = 0;
+    for (byte n = 0; n < 5 && p + n < end; ++n) {
+        v |= (unsigned long)(p[n] & 0x7F) << (7 * n);
+        if (!(p[n] & 0x80))
+            return n + 1;
+    }
+    return 0;
+}
+
+// encodes the sub-packet pkt to out in version, at most pkt->len + 1
+// bytes, returns the length
+static inline byte
+compactEncodePacket(const SwitchPacket *pkt, byte *out, byte version)
+{
+    byte *p = out + 1;
+    byte type = COMPACT_STRUCT;
+    switch (pkt->type) {
+        case SwitchPacket::TOUCH_EVENT: {
+            const TouchEvent *e = (const TouchEvent *)pkt;
+            // a chord including the center electrode (bit 4) or any of
+            // electrodes 8-11 does not fit the nibble
+            if (pkt->len != sizeof(TouchEvent) || e->gesture > 0xF ||
+                e->electrode > 0xF || e->electrodeHigh)
+                break;
+            *p++ = e->gesture << 4 | e->electrode;
+            *p++ = e->repeat;
+            *p++ = e->gang;
+            type = COMPACT_TOUCH;
+            break;
+        }
+        case SwitchPacket::TOUCH_CORRECTION: {
+            const TouchCorrection *c = (const TouchCorrection *)pkt;
+            if (pkt->len != sizeof(TouchCorrection) ||
+                c->reportedGesture > 0xF || c->reportedElectrode > 0xF ||
+                c->gesture > 0xF || c->electrode > 0xF ||
+                c->reportedElectrodeHigh || c->electrodeHigh)
+                break;
+            *p++ = c->reportedGesture << 4 | c->reportedElectrode;
+            *p++ = c->gesture << 4 | c->electrode;
+            *p++ = c->gang;
+            type = COMPACT_CORRECTION;
+            break;
+        }
+        case SwitchPacket::STATUS_UPDATE: {
+            const SwitchStatus *s = (const SwitchStatus *)pkt;
+            if (pkt->len != sizeof(SwitchStatus))
+                break;
+            long vcc = s->batteryLevel - COMPACT_VCC_MV;
+            p += compactPutVarint(p, vcc < 0 ? ~((unsigned long)vcc << 1) :
+                                              (unsigned long)vcc << 1);
+            p += compactPutVarint(p, (s->batteryDays + 1) & 0xFFFF);
+            p += compactPutVarint(p, s->statusCount);
+            p += compactPutVarint(p, s->touchWakes);
+            p += compactPutVarint(p, s->falseWakes);
+            if (version >= 3)
+                p += compactPutVarint(p, s->droppedEvents);
+            *p++ = s->settingsCrc & 0xFF;
+            *p++ = s->settingsCrc >> 8;
+            type = COMPACT_STATUS;
+            break;
+        }
+        case SwitchPacket::ENERGY_STATUS: {
+            const SwitchEnergy *e = (const SwitchEnergy *)pkt;
+            if (pkt->len != sizeof(SwitchEnergy))
+                break;
+            p += compactPutVarint(p, e->awakeMs);
+            p += compactPutVarint(p, e->standbyMs);
+            p += compactPutVarint(p, e->i2cMs);
+            p += compactPutVarint(p, e->txMs);
+            p += compactPutVarint(p, e->ackWaitMs);
+            p += compactPutVarint(p, e->wakes);
+            type = COMPACT_ENERGY;
+            break;
+        }
+        case SwitchPacket::SEQUENCE: {
+            const SwitchSequence *q = (const SwitchSequence *)pkt;
+            if (pkt->len != sizeof(SwitchSequence) || version < 2)
+                break;
+            *p++ = q->sequence;
+            *p++ = q->flags;
+            type = COMPACT_SEQUENCE;
+            break;
+        }
+    }
+    if (type == COMPACT_STRUCT) {
+        out[0] = COMPACT_STRUCT << 5;
+        memcpy(out + 1, pkt, pkt->len);
+        return pkt->len + 1;
+    }
+    if (type == COMPACT_TOUCH || type == COMPACT_CORRECTION ||
+        type == COMPACT_SEQUENCE) {
+        while (p > out + 2 && !p[-1])
+            --p;
+    }
+    out[0] = type << 5 | (p - out - 1);
+    return p - out;
+}
+
+// Encodes the packet of len bytes of sub-packets in data to out, which
+// holds size bytes, in the version the hub selected.  Returns the length,
+// 0 if the encoding is no shorter.
+static inline byte
+compactEncode(const byte *data, byte len, byte *out, byte size,
+              byte version = COMPACT_VERSION)
+{
+    byte pos = 0;
+    byte n = 1;
+    out[0] = COMPACT_MARKER | version;
+    while (pos + sizeof(SwitchPacket) <= len) {
+        const SwitchPacket *pkt = (const SwitchPacket *)(data + pos);
+        if (pkt->len < sizeof(SwitchPacket) || pos + pkt->len > len ||
+            n + pkt->len + 1 > size)
+            return 0;
+        n += compactEncodePacket(pkt, out + n, version);
+        pos += pkt->len;
+    }
+    return n < len ? n : 0;
+}
+
+// reads the varint fields of a STATUS or ENERGY sub-packet, returns false
+// if they do not end at end
+static inline bool
+compactGetFields(const byte *p, const byte *end, unsigned long *v, byte n)
+{
+    for (byte i = 0; i < n; ++i) {
+        byte len = compactGetVarint(p, end, v[i]);
+        if (!len)
+            return false;
+        p += len;
+    }
+    return p == end;
+}
+
+// Decodes the compact packet of len bytes in data to the sub-packet
+// structs in out, which holds size bytes.  Returns their length, 0 if the
+// packet is malformed, of a later version or does not fit.
+static inline byte
+compactDecode(const byte *data, byte len, byte *out, byte size)
+{
+    if (!len || !COMPACT_IS_MARKER(data[0]) ||
+        (data[0] & 0x0F) > COMPACT_VERSION)
+        return 0;
+    byte version = data[0] & 0x0F;
+    byte pos = 1;
+    byte n = 0;
+    while (pos < len) {
+        byte type = data[pos] >> 5;
+        const byte *p = data + pos + 1;
+        byte plen = data[pos] & COMPACT_MAX_LEN;
+        if (type == COMPACT_STRUCT) {
+            if (pos + 1 + sizeof(SwitchPacket) > len)
+                return 0;
+            plen = ((const SwitchPacket *)p)->len;
+            if (plen < sizeof(SwitchPacket))
+                return 0;
+        }
+        if (pos + 1 + plen > len)
+            return 0;
+        const byte *end = p + plen;
+        pos += 1 + plen;
+
+        // the fields left out are zero
+        byte field[3] = { 0, 0, 0 };
+        if (type == COMPACT_TOUCH || type == COMPACT_CORRECTION ||
+            type == COMPACT_SEQUENCE) {
+            if (!plen || plen > sizeof(field))
+                return 0;
+            memcpy(field, p, plen);
+        }
+        unsigned long v[6];
+        switch (type) {
+            case COMPACT_TOUCH: {
+                if (n + sizeof(TouchEvent) > size)
+                    return 0;
+                TouchEvent e;
+                e.gesture = field[0] >> 4;
+                e.electrode = field[0] & 0x0F;
+                e.repeat = field[1];
+                e.gang = field[2];
+                memcpy(out + n, &e, sizeof(e));
+                n += sizeof(e);
+                break;
+            }
+            case COMPACT_CORRECTION: {
+                if (n + sizeof(TouchCorrection) > size)
+                    return 0;
+                TouchCorrection c;
+                c.reportedGesture = field[0] >> 4;
+                c.reportedElectrode = field[0] & 0x0F;
+                c.gesture = field[1] >> 4;
+                c.electrode = field[1] & 0x0F;
+                c.gang = field[2];
+                memcpy(out + n, &c, sizeof(c));
+                n += sizeof(c);
+                break;
+            }
+            case COMPACT_STATUS: {
+                if (n + sizeof(SwitchStatus) > size || plen < 2 ||
+                    !compactGetFields(p, end - 2, v, version < 3 ? 5 : 6))
+                    return 0;
+                SwitchStatus s;
+                s.batteryLevel = COMPACT_VCC_MV + (v[0] & 1 ?
+                    -(long)(v[0] >> 1) - 1 : (long)(v[0] >> 1));
+                s.batteryDays = (v[1] - 1) & 0xFFFF;
+                s.statusCount = v[2];
+                s.touchWakes = v[3];
+                s.falseWakes = v[4];
+                s.droppedEvents = version < 3 ? 0 : v[5];
+                s.settingsCrc = end[-2] | (end[-1] << 8);
+                memcpy(out + n, &s, sizeof(s));
+                n += sizeof(s);
+                break;
+            }
+            case COMPACT_ENERGY: {
+                if (n + sizeof(SwitchEnergy) > size ||
+                    !compactGetFields(p, end, v, 6))
+                    return 0;
+                SwitchEnergy e;
+                e.awakeMs = v[0];
+                e.standbyMs = v[1];
+                e.i2cMs = v[2];
+                e.txMs = v[3];
+                e.ackWaitMs = v[4];
+                e.wakes = v[5];
+                memcpy(out + n, &e, sizeof(e));
+                n += sizeof(e);
+                break;
+            }
+            case COMPACT_SEQUENCE: {
+                if (n + sizeof(SwitchSequence) > size || plen > 2)
+                    return 0;
+                SwitchSequence q;
+                q.sequence = field[0];
+                q.flags = field[1];
+                memcpy(out + n, &q, sizeof(q));
+                n += sizeof(q);
+                break;
+            }
+            case COMPACT_STRUCT:
+                if (n + plen > size)
+                    return 0;
+                memcpy(out + n, p, plen);
+                n += plen;
+                break;
+            default:
+                return 0;
+        }
+    }
+    return n;
+}
+
+#endif // COMPACTCODEC_H
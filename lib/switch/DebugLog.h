@@ -0,0 +1,37 @@
+#ifndef DEBUGLOG_H
+#define DEBUGLOG_H
+
+#include <stdint.h>
+
+// Binary debug log.  A switch built with DEBUG_LOG records its DEBUG()
+// output into a RAM ring (switch/src/LogRing.h) instead of printing it, so
+// a debug build keeps the timing of a production one.  A record is:
+//   size:   bytes of the record including this one
+//   id:     little endian, LOG_ID() of the DEBUG() call
+//   ms:     little endian 32 bit millis() at the record
+//   args:   a LOG_* tag and the value of each argument that is not a string
+//           literal, the decoder reads the literals from the source
+// The id is the module of the source file (LOG_MODULE, defined by each file
+// using DEBUG()) and the line the DEBUG() call starts on, so the records
+// decode against the sources the switch was built from.
+//
+// The records are sent when asked for: over the serial port as a line of
+// LOG_PREFIX followed by the record bytes in hex per record when
+// LOG_REQUEST_CHAR is received, over the radio in LOG_DATA packets on a
+// LOG_REQUEST.  pc/lighthub/log.py decodes both.
+#define LOG_PREFIX          "#L"
+#define LOG_REQUEST_CHAR    'L'
+#define LOG_HEADER_SIZE     7
+#define LOG_MAX_RECORD      32
+#define LOG_ID(module, line)    (((module) << 12) | ((line) & 0x0FFF))
+
+// argument tags, values little endian
+#define LOG_U8              1   // any value 0 - 255
+#define LOG_I16             2
+#define LOG_U16             3
+#define LOG_I32             4
+#define LOG_U32             5
+#define LOG_STR             6   // length byte, up to LOG_MAX_STR chars
+#define LOG_MAX_STR         8
+
+#endif // DEBUGLOG_H
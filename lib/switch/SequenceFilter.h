@@ -0,0 +1,75 @@
+#ifndef SEQUENCEFILTER_H
+#define SEQUENCEFILTER_H
+
+#if ARDUINO >= 100
+  #include <Arduino.h> // Arduino 1.0
+#else
+  #include <WProgram.h> // Arduino 0022
+#endif
+
+#include "SwitchProtocol.h"
+
+// node ids of the RFM12B
+#define SEQUENCE_NODES      32
+
+// Drops the touch events a switch sends again because their ACK was lost.
+// An event is new if its number is ahead of the last one seen from its
+// node by less than half the 8 bit range.  A packet flagged
+// SEQUENCE_RESTART starts the numbering over unless it repeats the first
+// number of the previous restart packet, i.e. it is a retry of that.  A
+// switch numbers the events after each power on from a count kept in its
+// EEPROM, consecutive power ons do not start alike.
+// Packets without a SwitchSequence pass as they are.
+class SequenceFilter {
+    public:
+        SequenceFilter() : numbered(false), next(0) {
+            memset(nodes, 0, sizeof(nodes));
+        }
+
+        // starts a packet from a node
+        void start() { numbered = false; }
+
+        // takes the SwitchSequence numbering the events that follow
+        void sequence(byte nodeId, const SwitchSequence &pkt) {
+            Node &n = nodes[nodeId % SEQUENCE_NODES];
+            if (pkt.flags & SEQUENCE_RESTART) {
+                if (!n.restartSeen || n.restartFirst != pkt.sequence)
+                    n.last = pkt.sequence - 1;
+                n.restartSeen = true;
+                n.restartFirst = pkt.sequence;
+            }
+            else {
+                if (!n.known)
+                    n.last = pkt.sequence - 1;
+                n.restartSeen = false;
+            }
+            n.known = true;
+            numbered = true;
+            next = pkt.sequence;
+        }
+
+        // true if the next event of the packet is new
+        bool accept(byte nodeId) {
+            if (!numbered)
+                return true;
+            Node &n = nodes[nodeId % SEQUENCE_NODES];
+            byte seq = next++;
+            if ((signed char)(seq - n.last) <= 0)
+                return false;
+            n.last = seq;
+            return true;
+        }
+
+    protected:
+        struct Node {
+            byte last;
+            byte restartFirst;
+            bool restartSeen;
+            bool known;
+        };
+        Node nodes[SEQUENCE_NODES];
+        bool numbered;
+        byte next;
+};
+
+#endif // SEQUENCEFILTER_H
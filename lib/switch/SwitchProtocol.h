@@ -3,6 +3,33 @@
 
 #include "SwitchSettings.h"
 
+// the layout of the packets, raised when a struct changes.  A switch
+// reports it in its SwitchBoot, switches before version 2 do not.
+//   1: the first layout
+//   2: TouchEvent and TouchCorrection carry the gang, SwitchBoot the
+//      version, SwitchStatus the battery estimate and wake counts and
+//      SwitchI2CReply a count.  A version 1 hub rejects all of them.
+//   3: TouchEvent and TouchCorrection carry electrodes 8-11 of a chord,
+//      the SwitchI2CReply of a failed read a value.  A version 2 hub
+//      rejects the events.
+//   4: SwitchStatus carries the dropped events.  A version 3 hub rejects
+//      the status.
+// The hub takes the packets of older switches, version 1 ones send a
+// SwitchStatusV1.  Their settings are laid out differently, the hub
+// rejects a dump and CONFIGURE offsets do not match.
+#define SWITCH_PROTOCOL_VERSION 4
+
+// maximum number of registers returned by a single I2C_REQUEST
+#define I2C_MAX_READ    32
+// encoded electrode samples carried by a single STREAM_DATA packet
+#define STREAM_DATA_SIZE    (RF12_MAXDATA - 6)
+// slider position changes carried by a single SLIDER_DATA packet
+#define SLIDER_MAX_DELTAS   16
+// debug log bytes carried by a single LOG_DATA packet
+#define LOG_DATA_SIZE       (RF12_MAXDATA - 5)
+// settings bytes carried by a single CONFIGURE_RANGE packet
+#define CONFIGURE_RANGE_SIZE (RF12_MAXDATA - 4)
+
 struct SwitchPacket {
     SwitchPacket(unsigned char type, unsigned char len) :
         type(type), len(len) {}
@@ -18,24 +45,142 @@ struct SwitchPacket {
         I2C_REQUEST,
         I2C_REPLY,
         I2C_SET,
+        TOUCH_CORRECTION,
+        STREAM_REQUEST,
+        STREAM_DATA,
+        SLIDER_DATA,
+        ENERGY_STATUS,
+        LOG_REQUEST,
+        LOG_DATA,
+        BOOT_STATUS,
+        CONFIGURE_RANGE,
+        ENCODING,
+        SEQUENCE,
     };
     unsigned char type;
     unsigned char len;
 };
 
+// the events of several gangs (MPR121s of a multi-gang plate) finishing
+// together are sent as sub-packets of a single packet
 struct TouchEvent : SwitchPacket {
-    TouchEvent() : SwitchPacket(TOUCH_EVENT, sizeof(TouchEvent)) {}
+    TouchEvent() : SwitchPacket(TOUCH_EVENT, sizeof(TouchEvent)),
+        electrodeHigh(0) {}
     unsigned char gesture;
     unsigned char electrode;
     unsigned char repeat;
+    unsigned char gang;
+    // bits 8-11 of the electrode bitmap of a chord, electrode holds 0-7
+    unsigned char electrodeHigh;
+};
+
+// replaces a gesture that was reported before its sequence completed
+struct TouchCorrection : SwitchPacket {
+    TouchCorrection() : SwitchPacket(TOUCH_CORRECTION, sizeof(TouchCorrection)),
+        reportedElectrodeHigh(0), electrodeHigh(0) {}
+    unsigned char reportedGesture;
+    unsigned char reportedElectrode;
+    unsigned char gesture;
+    unsigned char electrode;
+    unsigned char gang;
+    // bits 8-11 of the electrode bitmaps of chords
+    unsigned char reportedElectrodeHigh;
+    unsigned char electrodeHigh;
 };
 
 struct SwitchStatus : SwitchPacket {
     SwitchStatus() : SwitchPacket(STATUS_UPDATE, sizeof(SwitchStatus)) {}
+    // the mean of a few Vcc readings in mV
+    long batteryLevel;
+    // estimated days until Vcc falls to BatterySettings::cutoffMv,
+    // 0xFFFF until the switch has seen a few days of it falling
+    unsigned int batteryDays;
+    unsigned int statusCount;
+    // touch interrupt wakeups since boot and how many of them did not end
+    // in an enabled gesture
+    unsigned int touchWakes;
+    unsigned int falseWakes;
+    // crc16() of the SwitchSettings in use, the PC dumps them only when it
+    // differs from its copy
+    unsigned int settingsCrc;
+    // touch events and corrections given up without an ACK since boot
+    unsigned int droppedEvents;
+};
+
+// the SwitchStatus of protocol 1 switches
+struct SwitchStatusV1 : SwitchPacket {
+    SwitchStatusV1() : SwitchPacket(STATUS_UPDATE, sizeof(SwitchStatusV1)) {}
     long batteryLevel;
     unsigned int statusCount;
 };
 
+// where the switch spends its energy, sent with each SwitchStatus in the
+// same packet.  All counters run since boot.  The time powered down is the
+// time since boot less awakeMs and standbyMs.
+struct SwitchEnergy : SwitchPacket {
+    SwitchEnergy() : SwitchPacket(ENERGY_STATUS, sizeof(SwitchEnergy)) {}
+    // MCU running, including the times below
+    unsigned long awakeMs;
+    // MCU in standby, the watchdog sleeps of touch sequences
+    unsigned long standbyMs;
+    unsigned long i2cMs;
+    // radio sending and listening for ACKs
+    unsigned long txMs;
+    unsigned long ackWaitMs;
+    // wakeups from sleep by any source
+    unsigned long wakes;
+};
+
+// the phases of setup() timed by SwitchBoot
+enum BootPhase {
+    BOOT_SERIAL,                // serial port
+    BOOT_CONFIG,                // loading the settings from EEPROM
+    BOOT_RADIO,                 // RFM12B initialization
+    BOOT_TOUCH,                 // MPR121 configuration of all gangs
+    BOOT_PHASES
+};
+
+// SwitchBoot::flags
+// the MPR121s kept their configuration across a soft reset
+#define BOOT_WARM           0x01
+
+// the time setup() spent in each phase, sent once with the first status
+// after a reset.  The status itself is not included.
+struct SwitchBoot : SwitchPacket {
+    SwitchBoot() : SwitchPacket(BOOT_STATUS, sizeof(SwitchBoot)),
+        protocol(SWITCH_PROTOCOL_VERSION) {}
+    unsigned char flags;
+    unsigned long phaseUs[BOOT_PHASES];
+    // SWITCH_PROTOCOL_VERSION, version 1 switches send the struct without
+    unsigned char protocol;
+};
+
+// Negotiates the compact encoding of CompactCodec.h.  A switch sends the
+// highest version it supports with each status until the hub answers with
+// the version the switch sends from then on, 0 for the structs as they are.
+struct SwitchEncoding : SwitchPacket {
+    SwitchEncoding() : SwitchPacket(ENCODING, sizeof(SwitchEncoding)) {}
+    unsigned char version;
+};
+
+// SwitchSequence::flags
+// sent until the hub acknowledged a packet after a reset, the hub takes the
+// sequence as it comes
+#define SEQUENCE_RESTART    0x01
+// the packet repeats events of a packet that was not acknowledged, the hub
+// sends the commands of its ACK again
+#define SEQUENCE_RETRY      0x02
+
+// Numbers the TOUCH_EVENT and TOUCH_CORRECTION sub-packets following it,
+// the first one is sequence and each next one one more, those ahead of it
+// are not numbered.  The switch sends an event again until a packet holding
+// it is acknowledged, the hub drops the events it has seen.
+struct SwitchSequence : SwitchPacket {
+    SwitchSequence() : SwitchPacket(SEQUENCE, sizeof(SwitchSequence)) {}
+    unsigned char sequence;
+    unsigned char flags;
+};
+
 struct SwitchReset : SwitchPacket {
     SwitchReset() : SwitchPacket(RESET, sizeof(SwitchReset)) {}
     unsigned char resetSettings;
@@ -51,6 +196,15 @@ struct SwitchConfigure : SwitchPacket {
     SwitchConfigureByte cfg;
 };
 
+// sets count consecutive bytes of the settings from offset, a whole
+// SwitchSettings takes two packets.  len covers only the count values.
+struct SwitchConfigureRange : SwitchPacket {
+    SwitchConfigureRange() : SwitchPacket(CONFIGURE_RANGE, sizeof(SwitchConfigureRange)) {}
+    unsigned char offset;
+    unsigned char count;
+    unsigned char value[CONFIGURE_RANGE_SIZE];
+};
+
 struct SwitchDumpSettings : SwitchPacket {
     SwitchDumpSettings() : SwitchPacket(DUMP_REPLY, sizeof(SwitchDumpSettings)) {}
     SwitchSettings settings;
@@ -60,13 +214,19 @@ struct SwitchI2CRequest : SwitchPacket {
     SwitchI2CRequest() : SwitchPacket(I2C_REQUEST, sizeof(SwitchI2CRequest)) {}
     unsigned char address;
     unsigned char reg;
+    // number of consecutive registers to read (1 - I2C_MAX_READ), requests
+    // without this field read a single register
+    unsigned char count;
 };
 
+// variable length, len covers only the count values that were read and at
+// least one.  Protocol 1 switches send a single value in place of count.
 struct SwitchI2CReply : SwitchPacket {
     SwitchI2CReply() : SwitchPacket(I2C_REPLY, sizeof(SwitchI2CReply)) {}
     unsigned char address;
     unsigned char reg;
-    unsigned char val;
+    unsigned char count;
+    unsigned char val[I2C_MAX_READ];
 };
 
 struct SwitchI2CSet : SwitchPacket {
@@ -76,4 +236,60 @@ struct SwitchI2CSet : SwitchPacket {
     unsigned char val;
 };
 
+// starts (or with samples == 0 stops) streaming the raw electrode data
+struct SwitchStreamRequest : SwitchPacket {
+    SwitchStreamRequest() : SwitchPacket(STREAM_REQUEST, sizeof(SwitchStreamRequest)) {}
+    unsigned char period;       // period_t between samples
+    unsigned int samples;       // total number of samples to stream
+};
+
+// Filtered data and baselines of the enabled electrodes, proximity last.
+// The first sample is a keyframe, per channel the filtered value (16 bit
+// little endian) and the baseline byte.  Following samples hold a signed
+// byte filtered delta per channel, -128 escapes an absolute 16 bit value,
+// then a bitmask of changed baselines ((channels + 7) / 8 bytes) followed by
+// the new baseline of each set bit.  len covers only the used data.
+struct SwitchStreamData : SwitchPacket {
+    SwitchStreamData() : SwitchPacket(STREAM_DATA, sizeof(SwitchStreamData)) {}
+    unsigned char sequence;     // packet counter, gaps are lost packets
+    unsigned char period;
+    unsigned char channels;
+    unsigned char samples;
+    unsigned char data[STREAM_DATA_SIZE];
+};
+
+// SwitchSliderData::flags
+// the finger left the slider, the last packet of a slide
+#define SLIDER_END          0x01
+
+// Positions of a finger held on the slider (the vertical electrodes), 0 at
+// the bottom electrode to 255 at the top, one sample every period.  position
+// is the first sample, delta[] the signed change to each following one.  A
+// SLIDER_END packet may hold no samples.  len covers only the used deltas.
+struct SwitchSliderData : SwitchPacket {
+    SwitchSliderData() : SwitchPacket(SLIDER_DATA, sizeof(SwitchSliderData)) {}
+    unsigned char gang;
+    unsigned char sequence;     // packet of the slide, 0 starts a slide
+    unsigned char flags;
+    unsigned char period;       // period_t between samples
+    unsigned char samples;      // position and deltas
+    unsigned char position;
+    signed char delta[SLIDER_MAX_DELTAS];
+};
+
+// SwitchLogData::flags
+// the last packet of the records held when the log was requested
+#define LOG_END             0x01
+
+// Debug log records of a DEBUG_LOG build, see DebugLog.h, sent in reply to
+// a LOG_REQUEST (a bare SwitchPacket) and removed from the switch.  data
+// holds whole records, len covers only the used data.  A switch built
+// without DEBUG_LOG does not answer.
+struct SwitchLogData : SwitchPacket {
+    SwitchLogData() : SwitchPacket(LOG_DATA, sizeof(SwitchLogData)) {}
+    unsigned int dropped;       // records overwritten before this packet
+    unsigned char flags;
+    unsigned char data[LOG_DATA_SIZE];
+};
+
 #endif // SWITCHPROTOCOL_H
@@ -0,0 +1,36 @@
+#if ARDUINO >= 100
+  #include <Arduino.h> // Arduino 1.0
+#else
+  #include <WProgram.h> // Arduino 0022
+#endif
+
+#include "SwitchSettings.h"
+
+#define _NONE   TOUCH_UNKNOWN
+#define _TAP    TOUCH_TAP
+#define _DBL    TOUCH_DOUBLE_TAP
+#define _UP     TOUCH_SWIPE_UP
+#define _DOWN   TOUCH_SWIPE_DOWN
+#define _LEFT   TOUCH_SWIPE_LEFT
+#define _RIGHT  TOUCH_SWIPE_RIGHT
+
+const byte defaultGestureTable[GESTURE_TABLE_SIZE] PROGMEM = {
+    // one touch, columns are the electrode
+    //          top    left   bottom right  center other
+    GESTURE_ROW(_TAP,  _TAP,  _TAP,  _TAP,  _TAP,  _TAP),
+    // two touches, rows are the first electrode, columns the last
+    GESTURE_ROW(_DBL,  _NONE, _DOWN, _NONE, _NONE, _NONE),     // top
+    GESTURE_ROW(_NONE, _DBL,  _NONE, _RIGHT,_NONE, _NONE),     // left
+    GESTURE_ROW(_UP,   _NONE, _DBL,  _NONE, _NONE, _NONE),     // bottom
+    GESTURE_ROW(_NONE, _LEFT, _NONE, _DBL,  _NONE, _NONE),     // right
+    GESTURE_ROW(_UP,   _LEFT, _DOWN, _RIGHT,_DBL,  _NONE),     // center
+    // "other" covers several electrodes, so it can't tell a double tap
+    GESTURE_ROW(_NONE, _NONE, _NONE, _NONE, _NONE, _NONE),     // other
+    // three or more touches
+    GESTURE_ROW(_NONE, _NONE, _DOWN, _NONE, _NONE, _NONE),     // top
+    GESTURE_ROW(_NONE, _NONE, _NONE, _RIGHT,_NONE, _NONE),     // left
+    GESTURE_ROW(_UP,   _NONE, _NONE, _NONE, _NONE, _NONE),     // bottom
+    GESTURE_ROW(_NONE, _LEFT, _NONE, _NONE, _NONE, _NONE),     // right
+    GESTURE_ROW(_NONE, _NONE, _NONE, _NONE, _NONE, _NONE),     // center
+    GESTURE_ROW(_NONE, _NONE, _NONE, _NONE, _NONE, _NONE),     // other
+};
@@ -7,7 +7,7 @@
 
 // current version of the firmware
 #define FIRMWARE_MAJOR_VERSION  0
-#define FIRMWARE_MINOR_VERSION  1
+#define FIRMWARE_MINOR_VERSION  12
 
 // RFM12B default settings
 #define GATEWAYID           1
@@ -26,8 +26,59 @@ enum TouchGesture {
     TOUCH_SWIPE_LEFT,
     TOUCH_SWIPE_RIGHT,
     TOUCH_PROXIMITY,
+    // several electrodes touched at once, TouchEvent::electrode holds the
+    // bitmap of electrodes 0-7 and TouchEvent::electrodeHigh of 8-11
+    TOUCH_CHORD,
 };
 
+// gesture ids are 4 bits, GestureSettings::getEnabled() holds a bit for each
+typedef char gesturesFitMask[TOUCH_CHORD < 16 ? 1 : -1];
+
+#define GESTURE_BIT(g)      (1U << (g))
+#define GESTURE_SWIPES      (GESTURE_BIT(TOUCH_SWIPE_UP) | \
+                             GESTURE_BIT(TOUCH_SWIPE_DOWN) | \
+                             GESTURE_BIT(TOUCH_SWIPE_LEFT) | \
+                             GESTURE_BIT(TOUCH_SWIPE_RIGHT))
+#define GESTURE_ALL         (0xFFFF & ~GESTURE_BIT(TOUCH_UNKNOWN))
+
+// Gesture table
+// Maps a touch sequence to a gesture id through its packed key: the number
+// of touches (1, 2 or 3+) and the roles of the first and last electrodes
+// touched.  Gesture ids are 4 bits, so the hub may define its own ids 9-15.
+#define ROLE_TOP            0       // same order as ElectrodeType
+#define ROLE_LEFT           1
+#define ROLE_BOTTOM         2
+#define ROLE_RIGHT          3
+#define ROLE_CENTER         4
+#define ROLE_OTHER          5
+#define GESTURE_ROLES       6
+#define GESTURE_KEYS        (GESTURE_ROLES + 2 * GESTURE_ROLES * GESTURE_ROLES)
+#define GESTURE_TABLE_SIZE  (GESTURE_KEYS / 2)
+
+// index into the gesture table for a sequence of len touches
+static inline byte gestureKey(byte len, byte first, byte last) {
+    if (len <= 1)
+        return first;
+    if (len == 2)
+        return GESTURE_ROLES + first * GESTURE_ROLES + last;
+    return GESTURE_ROLES * (GESTURE_ROLES + 1) + first * GESTURE_ROLES + last;
+}
+
+// two gesture ids per byte, the even key in the low nibble
+#define GESTURE_PAIR(a, b)  ((a) | ((b) << 4))
+#define GESTURE_ROW(t, l, b, r, c, o) \
+    GESTURE_PAIR(t, l), GESTURE_PAIR(b, r), GESTURE_PAIR(c, o)
+
+// the gesture table of new settings, in flash, see SwitchSettings.cpp
+extern const byte defaultGestureTable[GESTURE_TABLE_SIZE] PROGMEM;
+
+// GestureSettings::flags
+// report a gesture on release once no other enabled gesture can follow
+#define GESTURE_EARLY_COMMIT    0x01
+// report the current gesture on every release and send a TOUCH_CORRECTION
+// if the sequence turns into a different gesture before it times out
+#define GESTURE_SPECULATIVE     0x02
+
 struct SleepSettings {
     byte touch;
     byte release;
@@ -36,6 +87,20 @@ struct SleepSettings {
     byte replyWakeLock;
     byte statusInterval;
     byte statusScaler;
+    // repeat ticks of a held electrode are sent as one TouchEvent carrying
+    // their count, the first tick of a hold is sent right away
+    byte repeatCoalesce;
+    unsigned int repeatMs;
+    // acceleration, the repeat period shortens by one step every
+    // repeatAccel ticks down to repeatFastest, 0 keeps it at repeat
+    byte repeatAccel;
+    byte repeatFastest;
+    // the ACK wait shrinks to this percentile of the observed round trips,
+    // at most replyWakeLock, 0 always waits replyWakeLock
+    byte ackPercentile;
+    // a status due within statusPiggyback * 2^statusScaler ms is sent with
+    // the next acknowledged touch event instead of on its own, 0 never
+    byte statusPiggyback;
 
     SleepSettings() :
         touch(SLEEP_500MS),
@@ -44,7 +109,117 @@ struct SleepSettings {
         repeat(SLEEP_250MS),
         replyWakeLock(30),      // keep mcu awake at most 30ms for ACK replies
         statusInterval(110),    // interval * 2^scaler = status update time (ms)
-        statusScaler(15)        // 110 * 2^15 = 3,604,480 ms ~= 1 hr
+        statusScaler(15),       // 110 * 2^15 = 3,604,480 ms ~= 1 hr
+        repeatCoalesce(8),      // send every 8 ticks
+        repeatMs(500),          // or 500ms after the first unsent tick
+        repeatAccel(4),         // 250ms, 120ms after 4 ticks, 60ms after 8
+        repeatFastest(SLEEP_60MS),
+        ackPercentile(95),
+        statusPiggyback(22)     // 22 * 2^15 ms ~= 12 min
+    {
+    }
+};
+
+struct GestureSettings {
+    byte enabled;               // GESTURE_BIT() mask of gestures 0-7 in use
+    byte doubleTapElectrodes;   // electrodes 0-7 with a double tap in use
+    byte flags;
+    byte table[GESTURE_TABLE_SIZE];
+    byte chordMs;               // max ms between the touches of a chord
+    unsigned int swipeMs;       // max average ms between swipe touches
+    byte enabledHigh;           // and of gestures 8-15, TOUCH_CHORD and the
+                                // ids the hub defines in the table
+    byte doubleTapElectrodesHigh; // and of electrodes 8-11
+
+    GestureSettings() :
+        enabled(GESTURE_ALL & 0xFF),
+        doubleTapElectrodes(0xFF),
+        flags(GESTURE_EARLY_COMMIT),
+        chordMs(40),
+        swipeMs(250),
+        enabledHigh(GESTURE_ALL >> 8),
+        doubleTapElectrodesHigh(0x0F)
+    {
+        memcpy_P(table, defaultGestureTable, sizeof(table));
+    }
+
+    // the GESTURE_BIT() mask of all gestures in use
+    unsigned int getEnabled() const {
+        return enabled | (unsigned int)enabledHigh << 8;
+    }
+    void setEnabled(unsigned int gestures) {
+        enabled = gestures & 0xFF;
+        enabledHigh = gestures >> 8;
+    }
+
+    // the bitmask of all electrodes with a double tap in use
+    unsigned int getDoubleTap() const {
+        return doubleTapElectrodes |
+            (unsigned int)doubleTapElectrodesHigh << 8;
+    }
+    void setDoubleTap(unsigned int electrodes) {
+        doubleTapElectrodes = electrodes & 0xFF;
+        doubleTapElectrodesHigh = electrodes >> 8;
+    }
+};
+
+// CalibrationSettings::flags
+// recompute the touch/release thresholds from the noise measured on idle
+// status wakeups.  Off by default, it changes the touch sensitivity.
+#define CALIBRATION_ENABLED     0x01
+
+struct CalibrationSettings {
+    byte flags;
+    byte margin;                // touch threshold = noise * margin / 4
+    byte minTouch;              // touch threshold limits for the electrodes
+    byte maxTouch;
+    byte proximityTouch;        // minimum proximity touch threshold
+    byte samples;               // noise samples taken on each idle wakeup
+    byte wakeups;               // idle wakeups per threshold update
+
+    CalibrationSettings() :
+        flags(0),
+        margin(8),
+        minTouch(4),
+        maxTouch(24),
+        proximityTouch(2),
+        samples(8),
+        wakeups(4)
+    {
+    }
+};
+
+// SliderSettings::flags
+// report a finger held on the vertical electrodes as a stream of slider
+// positions instead of repeated touch events
+#define SLIDER_ENABLED          0x01
+
+struct SliderSettings {
+    byte flags;
+    byte period;                // sleep period between position samples
+    byte samples;               // positions per SLIDER_DATA packet
+    byte deadband;              // smaller position changes are not reported
+    byte minSignal;             // summed electrode signal of a finger
+    byte smoothing;             // position low pass, 1 / 2^smoothing per sample
+
+    SliderSettings() :
+        flags(0),
+        period(SLEEP_30MS),
+        samples(8),
+        deadband(4),
+        minSignal(8),
+        smoothing(1)
+    {
+    }
+};
+
+struct BatterySettings {
+    // the switch stops working below, the status reports the days left
+    // until the battery trend reaches it
+    unsigned int cutoffMv;
+
+    BatterySettings() :
+        cutoffMv(2200)          // RFM12B minimum supply
     {
     }
 };
@@ -74,6 +249,10 @@ struct SwitchSettings {
     RFM12BSettings rfm12b;
     MPR121Settings mpr121;
     SleepSettings sleep;
+    GestureSettings gesture;
+    CalibrationSettings calibration;
+    SliderSettings slider;
+    BatterySettings battery;
 };
 
 #endif // SWITCH_SETTINGS_H
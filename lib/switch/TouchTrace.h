@@ -0,0 +1,47 @@
+#ifndef TOUCHTRACE_H
+#define TOUCHTRACE_H
+
+#include <stdint.h>
+
+// Touch trace, a recording of the MPR121 touch status for replaying touch
+// sessions offline.  A trace is a sequence of 4 byte records:
+//   ms:     little endian, time since the previous record (saturates)
+//   status: little endian, ELE0_7 | ELE8_PROX << 8 after a change
+// A session ends with a record that has TRACE_END set in status, its low
+// bits hold the gesture (TRACE_GESTURE) and electrode (TRACE_ELECTRODE)
+// reported for the session, the electrodes 0-7 of a chord.
+//
+// Over the serial port each record is a line of TRACE_PREFIX followed by
+// the 4 record bytes in hex, so traces can be cut out of a debug log.
+#define TRACE_RECORD_SIZE   4
+#define TRACE_PREFIX        "#T"
+#define TRACE_END           0x4000
+#define TRACE_GESTURE(s)    (((s) >> 8) & 0x0F)
+#define TRACE_ELECTRODE(s)  ((s) & 0xFF)
+
+struct TraceRecord {
+    uint16_t ms;
+    uint16_t status;
+};
+
+// packs a record into its 4 byte form
+static inline void traceEncode(const TraceRecord &r, uint8_t *buf) {
+    buf[0] = r.ms & 0xFF;
+    buf[1] = r.ms >> 8;
+    buf[2] = r.status & 0xFF;
+    buf[3] = r.status >> 8;
+}
+
+static inline TraceRecord traceDecode(const uint8_t *buf) {
+    TraceRecord r;
+    r.ms = buf[0] | (buf[1] << 8);
+    r.status = buf[2] | (buf[3] << 8);
+    return r;
+}
+
+// end of session record for a reported gesture
+static inline uint16_t traceEnd(uint8_t gesture, uint8_t electrode) {
+    return TRACE_END | ((gesture & 0x0F) << 8) | electrode;
+}
+
+#endif // TOUCHTRACE_H
@@ -1,8 +1,38 @@
 #ifndef DEBUG_H
 #define DEBUG_H
 
-#if !defined(NDEBUG)
+#if !defined(NDEBUG) && defined(DEBUG_LOG)
 #include "cpp_magic.h"
+#include "LogRing.h"
+
+// binary records into the LogRing, see DebugLog.h.  Each file using DEBUG()
+// defines its LOG_MODULE before including this file.
+#if !defined(LOG_MODULE)
+#error "LOG_MODULE is not defined"
+#endif
+
+#define _DEBUG_ARG(x)       LogRing::arg(x);
+#define DEBUG(...) \
+    do { \
+        LogRing::begin(LOG_ID(LOG_MODULE, __LINE__)); \
+        MAP(_DEBUG_ARG, EMPTY, __VA_ARGS__) \
+        LogRing::end(); \
+    } while(0)
+#define DEBUG_(...)         DEBUG(__VA_ARGS__)
+#define DEBUG_FMT(a, b) \
+    do { \
+        LogRing::begin(LOG_ID(LOG_MODULE, __LINE__)); \
+        LogRing::arg(a); \
+        LogRing::end(); \
+    } while(0)
+#define DEBUG_FMT_(a, b)    DEBUG_FMT(a, b)
+
+#elif !defined(NDEBUG)
+#include "cpp_magic.h"
+
+// DEBUG() prints to the serial port, code waiting for the output to drain
+// checks DEBUG_SERIAL
+#define DEBUG_SERIAL
 
 #define _DEBUG_PRINT(x)     Serial.print(x);
 #define _DEBUG_IT(x, next)  _DEBUG_PRINT(x)
@@ -20,3 +20,17 @@ int EEPROM_readAnything(int ee, T& value)
         *p++ = EEPROM.read(ee++);
     return i;
 }
+
+// CRC-16/CCITT of len bytes, pass the result of a previous call as crc to
+// continue it
+static inline unsigned int
+crc16(const void *data, unsigned int len, unsigned int crc = 0xFFFF)
+{
+    const byte *p = (const byte *)data;
+    while (len--) {
+        crc ^= (unsigned int)*p++ << 8;
+        for (byte i = 0; i < 8; ++i)
+            crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+    return crc & 0xFFFF;
+}
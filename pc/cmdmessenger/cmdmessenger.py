@@ -51,6 +51,12 @@ class CmdMessengerWriter(object):
     def send_int16(self, arg):
         self._send_unescaped_field(int(arg))
 
+    def send_uint16(self, arg):
+        arg = int(arg)
+        if not 0 <= arg <= 0xFFFF:
+            raise ValueError('{} is not an unsigned 16 bit value'.format(arg))
+        self._send_unescaped_field(arg)
+
     def send_int32(self, arg):
         self._send_unescaped_field(int(arg))
 
@@ -1,6 +1,9 @@
 import binascii
 import cmd
 from cmdmessenger import CmdMessengerHandler
+from lighthub import log
+from lighthub import shadow
+from lighthub import stream
 from lighthub.hub import (LightSwitchHub,
                           Command,
                           Gesture,
@@ -9,6 +12,16 @@ from lighthub.hub import (LightSwitchHub,
 
 
 class Handler(CmdMessengerHandler):
+    # file receiving the streamed electrode data as CSV
+    capture = None
+    last_sequence = None
+    # last energy counters of each node
+    energy = {}
+    # DEBUG() calls of the switch sources, read on the first log
+    log_messages = None
+    # the settings of each node as last dumped
+    settings = shadow.SettingsShadow()
+
     @CmdMessengerHandler.handler(cmdid=Command.msg)
     def handle_debug(self, msg):
         print("hub: {}".format(msg.read_str()))
@@ -17,23 +30,87 @@ class Handler(CmdMessengerHandler):
     def handle_touch_event(self, msg):
         nodeid = msg.read_int8()
         gesture = Gesture(msg.read_int8())
-        electrode = Electrode(msg.read_int8())
+        electrode = msg.read_int16()
+        if gesture == Gesture.chord:
+            # bitmap of the electrodes 0-11 touched together, those without
+            # a name as their number
+            electrode = [Electrode(i) if i < len(Electrode) else i
+                         for i in range(12) if electrode & (1 << i)]
+        else:
+            electrode = Electrode(electrode)
         repeat = msg.read_int8()
-        print('[{}] gesture: {}, electrode: {}, repeat: {}'.format(nodeid,
-            gesture, electrode, repeat))
+        gang = msg.read_int8()
+        print('[{}:{}] gesture: {}, electrode: {}, repeat: {}'.format(nodeid,
+            gang, gesture, electrode, repeat))
+
+    @CmdMessengerHandler.handler(cmdid=Command.touch_correction)
+    def handle_touch_correction(self, msg):
+        nodeid = msg.read_int8()
+        reported = Gesture(msg.read_int8())
+        reported_electrode = msg.read_int16()
+        gesture = Gesture(msg.read_int8())
+        electrode = msg.read_int16()
+        gang = msg.read_int8()
+        print('[{}:{}] correction: {} ({}) -> {} ({})'.format(nodeid, gang,
+            reported, reported_electrode, gesture, electrode))
 
     @CmdMessengerHandler.handler(cmdid=Command.status_event)
     def handle_status_event(self, msg):
         nodeid = msg.read_int8()
         vcc = msg.read_int32()
+        days = msg.read_int16() & 0xFFFF
         count = msg.read_int16()
-        print("[{}] status: vcc {}, count {}".format(nodeid, vcc, count))
+        wakes = msg.read_int16()
+        false_wakes = msg.read_int16()
+        crc = msg.read_int16() & 0xFFFF
+        dropped = msg.read_int16() & 0xFFFF
+        rate = 100.0 * false_wakes / wakes if wakes else 0.0
+        print("[{}] status: vcc {} ({} days left), count {}, wakes {}, "
+              "false {} ({:.1f}%), dropped events {}".format(nodeid, vcc,
+                '?' if days == 0xFFFF else days, count, wakes, false_wakes,
+                rate, dropped))
+        if not self.settings.status(nodeid, crc):
+            print("[{}] settings {:#06x} differ from the shadow, dump to "
+                  "refresh".format(nodeid, crc))
+
+    @CmdMessengerHandler.handler(cmdid=Command.energy_event)
+    def handle_energy_event(self, msg):
+        nodeid = msg.read_int8()
+        names = ('awake', 'standby', 'i2c', 'tx', 'ack', 'wakes')
+        counters = [msg.read_int32() for name in names]
+        print("[{}] energy: {}".format(nodeid, ', '.join(
+            '{} {}'.format(n, c) for n, c in zip(names, counters))))
+        # the share of the awake time since the previous status, a
+        # smaller count means the switch restarted
+        last = self.energy.get(nodeid)
+        self.energy[nodeid] = counters
+        if not last or counters[0] < last[0]:
+            return
+        delta = [c - l for c, l in zip(counters, last)]
+        awake = delta[0] or 1
+        print("[{}] since last: awake {}ms, standby {}ms, {} wakes; "
+              "i2c {:.1f}%, tx {:.1f}%, ack {:.1f}% of awake".format(nodeid,
+                delta[0], delta[1], delta[5], 100.0 * delta[2] / awake,
+                100.0 * delta[3] / awake, 100.0 * delta[4] / awake))
+
+    @CmdMessengerHandler.handler(cmdid=Command.boot_event)
+    def handle_boot_event(self, msg):
+        nodeid = msg.read_int8()
+        flags = msg.read_int8()
+        names = ('serial', 'config', 'radio', 'touch')
+        phases = [msg.read_int32() for name in names]
+        protocol = msg.read_int8()
+        print("[{}] {} boot in {:.1f}ms: {}, protocol {}".format(nodeid,
+            'warm' if flags & 0x01 else 'cold', sum(phases) / 1000.0,
+            ', '.join('{} {:.1f}ms'.format(n, us / 1000.0)
+                      for n, us in zip(names, phases)), protocol))
 
     @CmdMessengerHandler.handler(cmdid=Command.dump_settings)
     def handle_dump_settings(self, msg):
         nodeid = msg.read_int8()
         print("[{}] Dump settings:".format(nodeid))
         settings = msg.read_bytes()
+        self.settings.dumped(nodeid, settings)
         settings = str(binascii.hexlify(settings), 'ascii')
         settings = [settings[i:i+2] for i in range(0, len(settings), 2)]
         for i in range(0, len(settings), 8):
@@ -44,9 +121,63 @@ class Handler(CmdMessengerHandler):
         nodeid = msg.read_int8()
         address = msg.read_int8()
         register = msg.read_int8()
-        value = msg.read_int8()
-        print("[{}] i2c {:#04x}, register {:#04x} : {:#04x}".format(
-            nodeid, address, register, value))
+        count = msg.read_int8()
+        values = [msg.read_int8() for i in range(count)]
+        for i in range(0, count, 8):
+            print("[{}] i2c {:#04x}, register {:#04x} : {}".format(
+                nodeid, address, register + i,
+                ' '.join('{:#04x}'.format(v) for v in values[i:i+8])))
+
+    @CmdMessengerHandler.handler(cmdid=Command.stream_data)
+    def handle_stream_data(self, msg):
+        nodeid = msg.read_int8()
+        pkt = stream.decode(msg.read_bytes())
+        if self.last_sequence is not None and \
+                pkt.sequence != (self.last_sequence + 1) & 0xFF:
+            print('[{}] stream: lost packets before {}'.format(nodeid,
+                pkt.sequence))
+        self.last_sequence = pkt.sequence
+        if not self.capture:
+            print('[{}] stream: {} samples'.format(nodeid, len(pkt.samples)))
+            return
+        for sample in pkt.samples:
+            row = [nodeid, pkt.sequence]
+            for filtered, baseline in sample:
+                row += [filtered, baseline]
+            self.capture.write(','.join(str(v) for v in row) + '\n')
+        self.capture.flush()
+
+    @CmdMessengerHandler.handler(cmdid=Command.log_data)
+    def handle_log_data(self, msg):
+        nodeid = msg.read_int8()
+        data = msg.read_bytes()
+        # SwitchLogData: len, dropped, flags, records
+        length = data[1]
+        dropped = data[2] | (data[3] << 8)
+        flags = data[4]
+        if self.log_messages is None:
+            self.log_messages = log.load_messages()
+        if dropped:
+            print('[{}] log: {} records overwritten'.format(nodeid, dropped))
+        for record in log.decode(data[5:length]):
+            print('[{}] {}'.format(nodeid,
+                log.format_record(record, self.log_messages)))
+        # LOG_END
+        if flags & 0x01:
+            print('[{}] log: end'.format(nodeid))
+
+    @CmdMessengerHandler.handler(cmdid=Command.slider_data)
+    def handle_slider_data(self, msg):
+        nodeid = msg.read_int8()
+        gang = msg.read_int8()
+        sequence = msg.read_int8()
+        flags = msg.read_int8()
+        period = msg.read_int8()
+        positions = [msg.read_int8() for i in range(msg.read_int8())]
+        # SLIDER_END
+        end = ', end' if flags & 0x01 else ''
+        print('[{}:{}] slider {}: {} every {}ms{}'.format(nodeid, gang,
+            sequence, positions, 16 << period, end))
 
 
 class ControllerShell(cmd.Cmd):
@@ -151,20 +282,88 @@ class ControllerShell(cmd.Cmd):
         except LightSwitchHubTimeout:
             print('No ACK received')
 
+    def do_setbytes(self, args):
+        '''Sets consecutive configuration bytes, given offset and hex
+           bytes: setbytes 0x10 0a0b0c'''
+        offset, args = args.partition(' ')[::2]
+        data, args = args.partition(' ')[::2]
+        if not self.nodeid or not offset or not data:
+            print('Missing required argument')
+            return
+        try:
+            msg = self.hub.setbytes(self.nodeid, int(offset, 0),
+                                    bytes.fromhex(data))
+            print('Tap switch {} to set configuration.'.format(self.nodeid))
+            n = msg.read_int8()
+            o = msg.read_int8()
+            c = msg.read_int8()
+            print('nodeid:{} offset:{:#04x} count:{}'.format(n,o,c))
+        except ValueError as e:
+            print('Bad bytes: {}'.format(e))
+        except LightSwitchHubTimeout:
+            print('No ACK received')
+
+    def do_shadow(self, args):
+        '''Keeps the settings dumped in a file, without one lists the nodes
+           whose status does not match them: shadow [settings.json]'''
+        handlers = self.hub.handlers
+        if args:
+            handlers.settings = shadow.SettingsShadow(args)
+            print('{} nodes in {}'.format(len(handlers.settings.settings),
+                                          args))
+            return
+        stale = handlers.settings.stale()
+        print('{} nodes reported, dump {}'.format(
+            len(handlers.settings.reported),
+            ' '.join(str(n) for n in stale) if stale else 'none'))
+
+    def do_configure(self, args):
+        '''Configures the current switch from a file of its settings,
+           sending only the ranges that differ from the shadow:
+           configure settings.bin'''
+        if not self.nodeid or not args:
+            print('Missing required argument')
+            return
+        with open(args, 'rb') as f:
+            settings = f.read()
+        handlers = self.hub.handlers
+        ranges = handlers.settings.configure(self.nodeid, settings)
+        if not ranges:
+            print('Switch {} is configured'.format(self.nodeid))
+            return
+        # one ACK payload per tap
+        room = shadow.RANGE_SIZE + shadow.RANGE_HEADER_SIZE
+        try:
+            for offset, data in ranges:
+                if len(data) + shadow.RANGE_HEADER_SIZE > room:
+                    break
+                self.hub.setbytes(self.nodeid, offset, data)
+                handlers.settings.sent(self.nodeid, offset, data)
+                room -= len(data) + shadow.RANGE_HEADER_SIZE
+        except LightSwitchHubTimeout:
+            print('No ACK received')
+        left = handlers.settings.configure(self.nodeid, settings)
+        print('Tap switch {} to set configuration{}.'.format(self.nodeid,
+            ', then configure again' if left else ''))
+
     def do_geti2c(self, args):
-        '''Gets an I2C register value, given address, register: geti2c 0x5A 0x20'''
+        '''Gets I2C register values, given address, register and an optional
+           count of consecutive registers: geti2c 0x5A 0x20 [4]'''
         address, args = args.partition(' ')[::2]
         register, args = args.partition(' ')[::2]
+        count, args = args.partition(' ')[::2]
         if not self.nodeid or not address or not register:
             print('Missing required argument')
             return
         try:
-            msg = self.hub.geti2c(self.nodeid, address, register)
+            msg = self.hub.geti2c(self.nodeid, address, register, count or '1')
             print('Tap switch {} to get register.'.format(self.nodeid))
             n = msg.read_int8()
             a = msg.read_int8()
             r = msg.read_int8()
-            print('nodeid:{} address:{:#04x} register:{:#04x}'.format(n,a,r))
+            c = msg.read_int8()
+            print('nodeid:{} address:{:#04x} register:{:#04x} count:{}'.format(
+                n,a,r,c))
         except LightSwitchHubTimeout:
             print('No ACK received')
 
@@ -189,6 +388,42 @@ class ControllerShell(cmd.Cmd):
         except LightSwitchHubTimeout:
             print('No ACK received')
 
+    def do_stream(self, args):
+        '''Streams raw electrode data, given the sleep period (period_t,
+           0 = 15ms) between samples, the number of samples and an optional
+           CSV file: stream 0 4000 [capture.csv].  stream 0 0 stops.'''
+        period, args = args.partition(' ')[::2]
+        samples, args = args.partition(' ')[::2]
+        path, args = args.partition(' ')[::2]
+        if not self.nodeid or not period or not samples:
+            print('Missing required argument')
+            return
+        handlers = self.hub.handlers
+        if handlers.capture:
+            handlers.capture.close()
+            handlers.capture = None
+        if path:
+            handlers.capture = open(path, 'w')
+        handlers.last_sequence = None
+        try:
+            msg = self.hub.stream(self.nodeid, period, samples)
+            print('Tap switch {} to start streaming.'.format(self.nodeid))
+        except ValueError as e:
+            print(e)
+        except LightSwitchHubTimeout:
+            print('No ACK received')
+
+    def do_log(self, args):
+        'Requests the debug log of a switch built with LOG=1'
+        if not self.nodeid:
+            print('Must select a node first')
+            return
+        try:
+            msg = self.hub.log(self.nodeid)
+            print('Tap switch {} to send its log.'.format(self.nodeid))
+        except LightSwitchHubTimeout:
+            print('No ACK received')
+
     def do_exit(self, args):
         'Exits the shell'
         if hasattr(self, 'hub') and self.hub.connected:
@@ -15,6 +15,21 @@ class Command(Enum):
     get_i2c         = 7
     set_i2c         = 8
     status_request  = 9
+    touch_correction = 10
+    stream_data     = 11
+    stream_request  = 12
+    slider_data     = 13
+    energy_event    = 14
+    log_request     = 15
+    log_data        = 16
+    boot_event      = 17
+    set_bytes       = 18
+
+# settings bytes a CONFIGURE_RANGE packet carries, RF12_MAXDATA - 4
+CONFIGURE_RANGE_SIZE = 124
+# settings bytes per set_bytes command, hex encoded in the hub's 64 byte
+# serial buffer
+SET_BYTES_CHUNK = 24
 
 class Electrode(Enum):
     '''Electrode names'''
@@ -33,6 +48,8 @@ class Gesture(Enum):
     swipe_down  = 4
     swipe_left  = 5
     swipe_right = 6
+    proximity   = 7
+    chord       = 8
 
 
 class LightSwitchHubTimeout(Exception):
@@ -122,12 +139,30 @@ class LightSwitchHub(object):
             w.send_int8(int(value, 0))
         return self.input_thread.wait_for_ack(self.ack_timeout)
 
-    def geti2c(self, nodeid, address, register):
-        '''Gets an I2C register value'''
+    def setbytes(self, nodeid, offset, data):
+        '''Sets consecutive configuration bytes from offset, up to
+           CONFIGURE_RANGE_SIZE of them reach the switch with a single tap.
+           Sent in chunks the hub's serial buffer holds, which it joins
+           into one packet, returns the ACK of the last.'''
+        data = bytes(data)
+        if not data or len(data) > CONFIGURE_RANGE_SIZE:
+            raise ValueError('1 to {} bytes'.format(CONFIGURE_RANGE_SIZE))
+        msg = None
+        for i in range(0, len(data), SET_BYTES_CHUNK):
+            with self.messenger.writer(cmdid=Command.set_bytes) as w:
+                w.send_int8(nodeid)
+                w.send_int8(offset + i)
+                w.send_str(data[i:i + SET_BYTES_CHUNK].hex())
+            msg = self.input_thread.wait_for_ack(self.ack_timeout)
+        return msg
+
+    def geti2c(self, nodeid, address, register, count='1'):
+        '''Gets one or more consecutive I2C register values'''
         with self.messenger.writer(cmdid=Command.get_i2c) as w:
             w.send_int8(nodeid)
             w.send_int8(int(address, 0))
             w.send_int8(int(register, 0))
+            w.send_int8(int(count, 0))
         return self.input_thread.wait_for_ack(self.ack_timeout)
 
     def seti2c(self, nodeid, address, register, value):
@@ -139,3 +174,21 @@ class LightSwitchHub(object):
             w.send_int8(int(register, 0))
             w.send_int8(int(value, 0))
         return self.input_thread.wait_for_ack(self.ack_timeout)
+
+    def log(self, nodeid):
+        '''Requests the debug log of a switch built with DEBUG_LOG'''
+        with self.messenger.writer(cmdid=Command.log_request) as w:
+            w.send_int16(nodeid)
+        return self.input_thread.wait_for_ack(self.ack_timeout)
+
+    def stream(self, nodeid, period, samples):
+        '''Streams raw electrode data, given the sleep period (period_t)
+           between samples and the number of samples, 0 stops the stream'''
+        samples = int(samples, 0)
+        if not 0 <= samples <= 0xFFFF:
+            raise ValueError('0 to 65535 samples')
+        with self.messenger.writer(cmdid=Command.stream_request) as w:
+            w.send_int8(nodeid)
+            w.send_int8(int(period, 0))
+            w.send_uint16(samples)
+        return self.input_thread.wait_for_ack(self.ack_timeout)
@@ -0,0 +1,249 @@
+'''Decoder for the binary debug log of a switch built with DEBUG_LOG.  See
+lib/switch/DebugLog.h for the format.  The DEBUG() calls are read from the
+sources the switch was built from:
+
+    python3 -m lighthub.log [-s DIR]... capture.log
+
+decodes the "#L" lines of a serial capture, or a binary file of records.'''
+
+import argparse
+import os
+import re
+import struct
+import sys
+
+LOG_PREFIX = '#L'
+HEADER_SIZE = 7
+
+U8, I16, U16, I32, U32, STR = range(1, 7)
+VALUES = {
+    U8: '<B',
+    I16: '<h',
+    U16: '<H',
+    I32: '<i',
+    U32: '<I',
+}
+
+# the repository sources, relative to this file
+DEFAULT_SOURCES = [
+    os.path.join(os.path.dirname(__file__), '..', '..', 'switch', 'src'),
+    os.path.join(os.path.dirname(__file__), '..', '..', 'lib', 'switch'),
+]
+
+_module = re.compile(r'^\s*#define\s+LOG_MODULE\s+(\d+)', re.M)
+_call = re.compile(r'\bDEBUG(_FMT_?|_)?\(')
+_bases = {'HEX': 16, 'DEC': 10, 'OCT': 8, 'BIN': 2}
+
+
+def log_id(module, line):
+    return (module << 12) | (line & 0x0FFF)
+
+
+class Message(object):
+    def __init__(self, path, line, args, base=None):
+        self.path = path
+        self.line = line
+        # the argument expressions, string literals unquoted in literals
+        self.args = args
+        self.literals = [_literal(a) for a in args]
+        # the number base of a DEBUG_FMT()
+        self.base = base
+
+    def format(self, values):
+        '''The text the DEBUG() call printed, given its recorded values.'''
+        out = []
+        values = list(values)
+        for arg, literal in zip(self.args, self.literals):
+            if literal is not None:
+                out.append(literal)
+            elif values:
+                out.append(_format_value(values.pop(0), self.base))
+            else:
+                out.append('<{}>'.format(arg))
+        return ''.join(out)
+
+
+class Record(object):
+    def __init__(self, id, ms, values):
+        self.id = id
+        self.ms = ms
+        self.values = values
+
+
+def _literal(arg):
+    if len(arg) >= 2 and arg[0] == '"' and arg[-1] == '"':
+        return arg[1:-1].encode().decode('unicode_escape')
+    return None
+
+
+def _format_value(value, base):
+    if isinstance(value, str) or base in (None, 10):
+        return str(value)
+    if base == 16:
+        return '{:X}'.format(value)
+    if base == 8:
+        return '{:o}'.format(value)
+    return '{:b}'.format(value)
+
+
+def _split_args(text):
+    '''Splits the arguments of a call at the top level commas.'''
+    args = []
+    depth = 0
+    quote = None
+    start = 0
+    i = 0
+    while i < len(text):
+        c = text[i]
+        if quote:
+            if c == '\\':
+                i += 1
+            elif c == quote:
+                quote = None
+        elif c in '"\'':
+            quote = c
+        elif c in '([{':
+            depth += 1
+        elif c in ')]}':
+            depth -= 1
+        elif c == ',' and depth == 0:
+            args.append(text[start:i].strip())
+            start = i + 1
+        i += 1
+    last = text[start:].strip()
+    if last or args:
+        args.append(last)
+    return args
+
+
+def _call_args(source, start):
+    '''The argument text of the call whose '(' is at start.'''
+    depth = 0
+    quote = None
+    i = start
+    while i < len(source):
+        c = source[i]
+        if quote:
+            if c == '\\':
+                i += 1
+            elif c == quote:
+                quote = None
+        elif c in '"\'':
+            quote = c
+        elif c == '(':
+            depth += 1
+        elif c == ')':
+            depth -= 1
+            if depth == 0:
+                return source[start + 1:i]
+        i += 1
+    raise ValueError('unterminated call at {}'.format(start))
+
+
+def parse_source(path, text=None):
+    '''Returns {id: Message} of the DEBUG() calls of a source file, empty
+    if it does not define a LOG_MODULE.'''
+    if text is None:
+        with open(path) as f:
+            text = f.read()
+    module = _module.search(text)
+    if not module:
+        return {}
+    module = int(module.group(1))
+    messages = {}
+    for m in _call.finditer(text):
+        # the macro definitions in debug.h
+        if text[text.rfind('\n', 0, m.start()) + 1:m.start()].lstrip() \
+                .startswith('#'):
+            continue
+        line = text.count('\n', 0, m.start()) + 1
+        args = _split_args(_call_args(text, m.end() - 1))
+        base = None
+        if m.group(1) and m.group(1).startswith('_FMT'):
+            base = _bases.get(args[1], 10) if len(args) > 1 else 10
+            args = args[:1]
+        messages[log_id(module, line)] = Message(path, line, args, base)
+    return messages
+
+
+def load_messages(dirs=None):
+    '''Returns {id: Message} of the sources in dirs.'''
+    messages = {}
+    for d in dirs or DEFAULT_SOURCES:
+        for name in sorted(os.listdir(d)):
+            if name.endswith(('.cpp', '.h')):
+                messages.update(parse_source(os.path.join(d, name)))
+    return messages
+
+
+def decode(data):
+    '''Decodes the records in data, a bytes object of whole records.'''
+    records = []
+    pos = 0
+    while pos < len(data):
+        size = data[pos]
+        if size < HEADER_SIZE or pos + size > len(data):
+            raise ValueError('truncated log record at {}'.format(pos))
+        id, ms = struct.unpack_from('<HI', data, pos + 1)
+        values = []
+        i = pos + HEADER_SIZE
+        end = pos + size
+        while i < end:
+            tag = data[i]
+            i += 1
+            if tag == STR and i < end:
+                n = data[i]
+                values.append(data[i + 1:i + 1 + n].decode('latin-1'))
+                i += 1 + n
+            elif tag in VALUES:
+                fmt = VALUES[tag]
+                if i + struct.calcsize(fmt) <= end:
+                    values.append(struct.unpack_from(fmt, data, i)[0])
+                i += struct.calcsize(fmt)
+            else:
+                raise ValueError('bad log argument tag {}'.format(tag))
+        if i != end:
+            raise ValueError('truncated log record at {}'.format(pos))
+        records.append(Record(id, ms, values))
+        pos = end
+    return records
+
+
+def read_capture(text):
+    '''The record bytes of the LOG_PREFIX lines of a serial capture.'''
+    data = bytearray()
+    for line in text.splitlines():
+        line = line.strip()
+        if line.startswith(LOG_PREFIX):
+            data += bytes.fromhex(line[len(LOG_PREFIX):])
+    return bytes(data)
+
+
+def format_record(record, messages):
+    msg = messages.get(record.id)
+    if not msg:
+        text = 'unknown message {:04x} {}'.format(record.id, record.values)
+        where = '?'
+    else:
+        text = msg.format(record.values)
+        where = '{}:{}'.format(os.path.basename(msg.path), msg.line)
+    return '{:>10} {:<26} {}'.format(record.ms, where, text)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Decodes a switch debug log')
+    parser.add_argument('-s', '--source', action='append',
+                        help='source directory, repeatable')
+    parser.add_argument('file')
+    args = parser.parse_args()
+    with open(args.file, 'rb') as f:
+        data = f.read()
+    if LOG_PREFIX.encode() in data:
+        data = read_capture(data.decode('latin-1'))
+    messages = load_messages(args.source)
+    for record in decode(data):
+        print(format_record(record, messages))
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,105 @@
+'''Shadow copies of the settings of the switches.  Each status carries the
+CRC-16 of the settings a switch uses; while it matches the copy of the last
+dump the settings are known without dumping them again, and a change is
+pushed as the ranges that differ from the copy.'''
+
+import json
+
+# settings bytes a CONFIGURE_RANGE packet carries, see lighthub.hub
+RANGE_SIZE = 124
+# bytes of a CONFIGURE_RANGE besides the values, ranges closer than this
+# are joined
+RANGE_HEADER_SIZE = 4
+
+
+def crc16(data, crc=0xFFFF):
+    '''CRC-16/CCITT as crc16() in lib/switch/util.h computes it'''
+    for b in data:
+        crc ^= b << 8
+        for i in range(8):
+            crc = (crc << 1) ^ 0x1021 if crc & 0x8000 else crc << 1
+        crc &= 0xFFFF
+    return crc
+
+
+def diff(old, new, size=RANGE_SIZE):
+    '''The (offset, bytes) ranges of new that differ from old, each at most
+       size bytes.  Unchanged bytes between two changes are sent along if
+       that takes fewer bytes than another range.'''
+    ranges = []
+    for i in range(len(new)):
+        if i < len(old) and old[i] == new[i]:
+            continue
+        if ranges and i - ranges[-1][1] <= RANGE_HEADER_SIZE and \
+                i - ranges[-1][0] < size:
+            ranges[-1][1] = i + 1
+        else:
+            ranges.append([i, i + 1])
+    return [(start, bytes(new[start:end])) for start, end in ranges]
+
+
+class SettingsShadow(object):
+    def __init__(self, path=None):
+        # settings of the last dump of each node
+        self.settings = {}
+        # the settings being configured, the shadow with the ranges sent
+        self.pending = {}
+        # the CRC of the last status of each node
+        self.reported = {}
+        self.path = path
+        if path:
+            try:
+                with open(path) as f:
+                    nodes = json.load(f)
+            except FileNotFoundError:
+                nodes = {}
+            self.settings = {int(n): bytes.fromhex(s)
+                             for n, s in nodes.items()}
+
+    def save(self):
+        if not self.path:
+            return
+        with open(self.path, 'w') as f:
+            json.dump({str(n): s.hex() for n, s in self.settings.items()},
+                      f, indent=1, sort_keys=True)
+
+    def dumped(self, nodeid, settings):
+        '''Takes the settings of a dump as the shadow of a node'''
+        self.settings[nodeid] = bytes(settings)
+        self.pending.pop(nodeid, None)
+        self.reported[nodeid] = crc16(settings)
+        self.save()
+
+    def status(self, nodeid, crc):
+        '''Checks the CRC of a status against the shadow, a match of the
+           pending settings makes them the shadow.  Returns True if the
+           settings of the node are known.'''
+        self.reported[nodeid] = crc
+        pending = self.pending.get(nodeid)
+        if pending is not None and crc16(pending) == crc:
+            self.dumped(nodeid, pending)
+        return self.known(nodeid)
+
+    def known(self, nodeid):
+        settings = self.settings.get(nodeid)
+        return settings is not None and \
+            crc16(settings) == self.reported.get(nodeid)
+
+    def stale(self):
+        '''The nodes whose last status does not match their shadow'''
+        return sorted(n for n in self.reported if not self.known(n))
+
+    def configure(self, nodeid, settings):
+        '''The ranges to send to configure a node with settings, all of
+           them if there is no shadow'''
+        base = self.pending.get(nodeid, self.settings.get(nodeid, b''))
+        return diff(base, settings)
+
+    def sent(self, nodeid, offset, data):
+        '''Records a range sent to a node'''
+        base = bytearray(self.pending.get(nodeid,
+                                          self.settings.get(nodeid, b'')))
+        if len(base) < offset + len(data):
+            base.extend(bytes(offset + len(data) - len(base)))
+        base[offset:offset + len(data)] = data
+        self.pending[nodeid] = bytes(base)
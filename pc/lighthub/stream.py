@@ -0,0 +1,52 @@
+'''Decoder for the raw electrode data streamed by a switch.  See
+SwitchStreamData in lib/switch/SwitchProtocol.h for the format.'''
+
+HEADER_SIZE = 6
+ESCAPE = 0x80
+
+
+class StreamPacket(object):
+    def __init__(self, sequence, period, channels, samples):
+        self.sequence = sequence
+        self.period = period
+        self.channels = channels
+        # list of samples, each a list of (filtered, baseline) per channel
+        self.samples = samples
+
+
+def decode(data):
+    '''Decodes a STREAM_DATA packet, data starts with the packet header.'''
+    length = data[1]
+    sequence, period, channels, count = data[2:HEADER_SIZE]
+    pos = HEADER_SIZE
+    samples = []
+    filtered = [0] * channels
+    baseline = [0] * channels
+
+    def take(n):
+        nonlocal pos
+        if pos + n > length:
+            raise ValueError('truncated stream packet')
+        pos += n
+        return data[pos - n:pos]
+
+    for s in range(count):
+        if s == 0:
+            for i in range(channels):
+                lsb, msb, base = take(3)
+                filtered[i] = lsb | (msb << 8)
+                baseline[i] = base
+        else:
+            for i in range(channels):
+                delta = take(1)[0]
+                if delta == ESCAPE:
+                    lsb, msb = take(2)
+                    filtered[i] = lsb | (msb << 8)
+                else:
+                    filtered[i] += delta - 256 if delta > 127 else delta
+            mask = take((channels + 7) // 8)
+            for i in range(channels):
+                if mask[i >> 3] & (1 << (i & 7)):
+                    baseline[i] = take(1)[0]
+        samples.append(list(zip(filtered, baseline)))
+    return StreamPacket(sequence, period, channels, samples)
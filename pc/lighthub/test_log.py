@@ -0,0 +1,55 @@
+from lighthub import log
+import struct
+import unittest
+
+SOURCE = '''#define LOG_MODULE  3
+#include "debug.h"
+
+void f() {
+    DEBUG("ack: ", rtt, " window: ",
+          window);
+    DEBUG("i2c set: ", success ? "success" : "error");
+    DEBUG_FMT(value, HEX);
+}
+'''
+
+class TestLog(unittest.TestCase):
+
+    def record(self, line, ms, args):
+        data = struct.pack('<HI', log.log_id(3, line), ms) + bytes(args)
+        return bytes([len(data) + 1]) + data
+
+    def setUp(self):
+        self.messages = log.parse_source('test.cpp', SOURCE)
+
+    def test_source(self):
+        self.assertEqual(sorted(m.line for m in self.messages.values()),
+                         [5, 7, 8])
+        msg = self.messages[log.log_id(3, 5)]
+        self.assertEqual(msg.args, ['"ack: "', 'rtt', '" window: "',
+                                    'window'])
+
+    def test_values(self):
+        data = self.record(5, 1000, [log.U8, 4, log.U16, 0x2C, 0x01])
+        data += self.record(7, 0x12345678, [log.STR, 5] + list(b'error'))
+        data += self.record(8, 1001, [log.I16, 0xAB, 0x00])
+        records = log.decode(data)
+        self.assertEqual([r.ms for r in records], [1000, 0x12345678, 1001])
+        text = [self.messages[r.id].format(r.values) for r in records]
+        self.assertEqual(text, ['ack: 4 window: 300', 'i2c set: error',
+                                'AB'])
+
+    def test_capture(self):
+        data = self.record(5, 7, [log.I32, 0xFF, 0xFF, 0xFF, 0xFF,
+                                  log.U8, 9])
+        capture = 'touch: 1\r\n#L{}\r\n'.format(data.hex().upper())
+        records = log.decode(log.read_capture(capture))
+        self.assertEqual(records[0].values, [-1, 9])
+
+    def test_truncated(self):
+        data = self.record(5, 0, [log.U16, 0x2C])
+        with self.assertRaises(ValueError):
+            log.decode(data)
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,65 @@
+from lighthub import shadow
+import os
+import tempfile
+import unittest
+
+class TestShadow(unittest.TestCase):
+
+    def test_crc(self):
+        # CRC-16/CCITT-FALSE check value
+        self.assertEqual(shadow.crc16(b'123456789'), 0x29B1)
+
+    def test_diff(self):
+        old = bytes(range(40))
+        new = bytearray(old)
+        new[2] = 0xFF
+        new[5] = 0xFF
+        new[30] = 0xFF
+        self.assertEqual(shadow.diff(old, new),
+                         [(2, b'\xff\x03\x04\xff'), (30, b'\xff')])
+        self.assertEqual(shadow.diff(old, old), [])
+
+    def test_diff_size(self):
+        ranges = shadow.diff(b'', bytes(164))
+        self.assertEqual([(o, len(d)) for o, d in ranges], [(0, 124),
+                                                            (124, 40)])
+
+    def test_status(self):
+        settings = bytes(range(100))
+        s = shadow.SettingsShadow()
+        self.assertFalse(s.status(2, shadow.crc16(settings)))
+        self.assertEqual(s.stale(), [2])
+        s.dumped(2, settings)
+        self.assertTrue(s.status(2, shadow.crc16(settings)))
+        self.assertEqual(s.stale(), [])
+        self.assertFalse(s.status(2, 0x1234))
+        self.assertEqual(s.stale(), [2])
+
+    def test_configure(self):
+        settings = bytes(range(100))
+        s = shadow.SettingsShadow()
+        s.dumped(2, settings)
+        new = bytearray(settings)
+        new[10] = 0
+        new[90] = 0
+        ranges = s.configure(2, new)
+        self.assertEqual(ranges, [(10, b'\x00'), (90, b'\x00')])
+        # sent one tap at a time, the rest is still to send
+        s.sent(2, *ranges[0])
+        self.assertEqual(s.configure(2, new), [(90, b'\x00')])
+        s.sent(2, *ranges[1])
+        self.assertEqual(s.configure(2, new), [])
+        # the status of the configured switch takes the pending settings
+        self.assertTrue(s.status(2, shadow.crc16(new)))
+        self.assertEqual(s.settings[2], bytes(new))
+
+    def test_file(self):
+        with tempfile.TemporaryDirectory() as d:
+            path = os.path.join(d, 'shadow.json')
+            s = shadow.SettingsShadow(path)
+            s.dumped(3, b'\x01\x02')
+            s = shadow.SettingsShadow(path)
+            self.assertEqual(s.settings, {3: b'\x01\x02'})
+
+if __name__ == '__main__':
+    unittest.main()
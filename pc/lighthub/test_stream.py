@@ -0,0 +1,49 @@
+from cmdmessenger.cmdmessenger import CmdMessengerWriter
+from lighthub import stream
+import io
+import unittest
+
+class TestStream(unittest.TestCase):
+
+    def packet(self, channels, count, data):
+        header = bytes([13, 6 + len(data), 3, 0, channels, count])
+        # the hub forwards the whole packet, unused bytes are zero
+        return header + bytes(data) + bytes(122 - len(data))
+
+    def test_keyframe(self):
+        pkt = stream.decode(self.packet(2, 1, [0xBC, 0x02, 0xAF,
+                                               0x10, 0x01, 0x44]))
+        self.assertEqual(pkt.sequence, 3)
+        self.assertEqual(pkt.channels, 2)
+        self.assertEqual(pkt.samples, [[(700, 0xAF), (272, 0x44)]])
+
+    def test_deltas(self):
+        data = [0xBC, 0x02, 0xAF, 0x10, 0x01, 0x44,
+                # +1, -2, no baseline change
+                0x01, 0xFE, 0x00,
+                # escaped 0x3FF, +0, second baseline changed
+                0x80, 0xFF, 0x03, 0x00, 0x02, 0x45]
+        pkt = stream.decode(self.packet(2, 3, data))
+        self.assertEqual(pkt.samples, [
+            [(700, 0xAF), (272, 0x44)],
+            [(701, 0xAF), (270, 0x44)],
+            [(1023, 0xAF), (270, 0x45)],
+        ])
+
+    def test_truncated(self):
+        with self.assertRaises(ValueError):
+            stream.decode(self.packet(2, 2, [0xBC, 0x02, 0xAF,
+                                             0x10, 0x01, 0x44, 0x01]))
+
+    def test_sample_count(self):
+        # the request carries the count unsigned, the firmware field is
+        out = io.BytesIO()
+        w = CmdMessengerWriter(out, b',', b';', b'/', 12)
+        w.send_uint16(40000)
+        self.assertEqual(out.getvalue(), b',40000')
+        for count in (-1, 0x10000):
+            with self.assertRaises(ValueError):
+                w.send_uint16(count)
+
+if __name__ == '__main__':
+    unittest.main()
@@ -17,14 +17,35 @@ else
     echo "no node id specified"
 fi
 
+if [ -n "$LOG" ]; then
+    echo "recording debug output in the binary log"
+    LOG="-DDEBUG_LOG"
+    DEBUG=1
+fi
+
 if [ -z "$DEBUG" ]; then
     DEBUG="-DNDEBUG"
 else
     DEBUG=""
 fi
 
+if [ -n "$FASTI2C" ]; then
+    echo "using 400kHz i2c fast mode"
+    FASTI2C="-DMPR121_FAST_MODE"
+fi
+
+if [ -n "$TRACE" ]; then
+    echo "writing touch traces to the serial port"
+    TRACE="-DTOUCH_TRACE"
+fi
+
+if [ -n "$GANGS" ]; then
+    echo "touch sensors: $GANGS"
+    GANGS="-DTOUCH_GANGS=$GANGS"
+fi
+
 echo "building..."
-ino build -f "-DNETWORKID=$NETWORKID $NODEID $DEBUG \
+ino build -f "-DNETWORKID=$NETWORKID $NODEID $DEBUG $LOG $FASTI2C $TRACE $GANGS \
               -ffunction-sections -fdata-sections -g -Os -w" || die
 
 if [ "$1" != "-n" ]; then
@@ -0,0 +1,48 @@
+#include "AckWindow.h"
+
+AckWindow::AckWindow() : total(0), probe(false)
+{
+    memset(counts, 0, sizeof(counts));
+}
+
+void
+AckWindow::count(byte bucket)
+{
+    if (counts[bucket] == 0xFF) {
+        // keep the histogram following recent round trips
+        total = 0;
+        for (byte i = 0; i < ACK_BUCKETS; ++i) {
+            counts[i] >>= 1;
+            total += counts[i];
+        }
+    }
+    counts[bucket]++;
+    total++;
+}
+
+void
+AckWindow::add(unsigned int rttMs)
+{
+    probe = false;
+    unsigned int bucket = rttMs / ACK_BUCKET_MS;
+    count(bucket < ACK_BUCKETS ? bucket : ACK_BUCKETS - 1);
+}
+
+byte
+AckWindow::getWindow(byte percentile, byte limit)
+{
+    if (!percentile || probe || total < ACK_MIN_SAMPLES)
+        return limit;
+    // round trips within the percentile, rounded up
+    unsigned long target = ((unsigned long)total * percentile + 99) / 100;
+    unsigned int seen = 0;
+    byte bucket = 0;
+    for (; bucket < ACK_BUCKETS - 1; ++bucket) {
+        seen += counts[bucket];
+        if (seen >= target)
+            break;
+    }
+    // the end of the bucket plus a bucket of margin
+    unsigned int window = (bucket + 2) * ACK_BUCKET_MS;
+    return window < limit ? window : limit;
+}
@@ -0,0 +1,48 @@
+#ifndef ACKWINDOW_H
+#define ACKWINDOW_H
+
+#if ARDUINO >= 100
+  #include <Arduino.h> // Arduino 1.0
+#else
+  #include <WProgram.h> // Arduino 0022
+#endif
+
+// histogram of the ACK round trips, ACK_BUCKETS buckets of ACK_BUCKET_MS
+#define ACK_BUCKET_MS       2
+#define ACK_BUCKETS         16
+// round trips recorded before the window adapts
+#define ACK_MIN_SAMPLES     8
+// air time of a byte at the RFM12B default of 38.3kbps, an ACK that is
+// coming in when the window closes is listened to until it is complete
+#define ACK_BYTE_US         209
+// the bytes after the length in the RFM12B packet header, the CRC
+#define ACK_TRAILER         2
+
+// Learns how long to listen for an ACK from the round trips observed.  The
+// window is a percentile of the recent round trips plus a bucket of margin.
+// A lost ACK cannot be told from a late one, so after a miss the next ACK
+// is waited for with the full window: a late round trip is recorded and
+// widens the window.
+class AckWindow {
+    public:
+        AckWindow();
+
+        // records the round trip of a received ACK in ms
+        void add(unsigned int rttMs);
+        // records an ACK that did not arrive within the window
+        void miss() { probe = true; }
+        // returns the ms to listen for an ACK, at most limit.  limit until
+        // ACK_MIN_SAMPLES round trips were recorded or if percentile is 0.
+        byte getWindow(byte percentile, byte limit);
+
+    protected:
+        void count(byte bucket);
+
+        // decays, halved when a bucket saturates
+        byte counts[ACK_BUCKETS];
+        unsigned int total;
+        // the next wait uses the full window
+        bool probe;
+};
+
+#endif // ACKWINDOW_H
@@ -0,0 +1,105 @@
+#ifndef BATTERYTREND_H
+#define BATTERYTREND_H
+
+#if ARDUINO >= 100
+  #include <Arduino.h> // Arduino 1.0
+#else
+  #include <WProgram.h> // Arduino 0022
+#endif
+
+// daily averages of the battery voltage kept for the trend
+#define BATTERY_POINTS          16
+#define BATTERY_DAY_MS          86400000UL
+// days averaged before the remaining days are estimated
+#define BATTERY_MIN_POINTS      3
+// the least the line must fall over the days kept, less is noise
+#define BATTERY_MIN_DROP_MV     4
+// the newest days fitted on their own to catch the knee of the curve
+#define BATTERY_RECENT_POINTS   4
+// getDaysLeft() while there is no falling trend
+#define BATTERY_DAYS_UNKNOWN    0xFFFF
+
+// Estimates the days until the battery reaches its cutoff voltage from a
+// least squares line through the daily averages of the Vcc readings.  A
+// reading varies by a few ADC counts, the line follows the discharge of
+// the last BATTERY_POINTS days.  The discharge speeds up at the knee of the
+// curve, a line through the last BATTERY_RECENT_POINTS days shows that
+// first and the sooner of the two crossings is taken.
+class BatteryTrend {
+    public:
+        BatteryTrend() : count(0), next(0), dayStart(0), sum(0), samples(0) {}
+
+        // records a reading of mv taken at now (ms), closes the day when
+        // BATTERY_DAY_MS passed since its first reading
+        void add(unsigned long now, unsigned int mv) {
+            if (samples && now - dayStart >= BATTERY_DAY_MS) {
+                points[next] = sum / samples;
+                next = (next + 1) % BATTERY_POINTS;
+                if (count < BATTERY_POINTS)
+                    count++;
+                samples = 0;
+            }
+            if (!samples) {
+                dayStart = now;
+                sum = 0;
+            }
+            sum += mv;
+            samples++;
+        }
+
+        // returns the days until the line crosses cutoffMv, 0 once it did
+        // and BATTERY_DAYS_UNKNOWN without BATTERY_MIN_POINTS days or if the
+        // voltage does not fall by BATTERY_MIN_DROP_MV
+        unsigned int getDaysLeft(unsigned int cutoffMv) const {
+            if (count < BATTERY_MIN_POINTS)
+                return BATTERY_DAYS_UNKNOWN;
+            unsigned int days = getDaysLeft(count, cutoffMv);
+            if (count > BATTERY_RECENT_POINTS) {
+                unsigned int recent = getDaysLeft(BATTERY_RECENT_POINTS,
+                                                  cutoffMv);
+                if (recent < days)
+                    days = recent;
+            }
+            return days;
+        }
+
+    protected:
+        // as above for the line through the newest n points
+        unsigned int getDaysLeft(byte n, unsigned int cutoffMv) const {
+            // x in days from the oldest point, y in mV above the newest
+            // point to keep the sums small
+            unsigned int newest = points[(next + BATTERY_POINTS - 1) %
+                                         BATTERY_POINTS];
+            long sx = 0, sy = 0, sxx = 0, sxy = 0;
+            for (byte x = 0; x < n; ++x) {
+                byte i = (next + BATTERY_POINTS - n + x) % BATTERY_POINTS;
+                long y = (long)points[i] - newest;
+                sx += x;
+                sy += y;
+                sxx += (long)x * x;
+                sxy += x * y;
+            }
+            // slope = num / den mV per day
+            long num = n * sxy - sx * sy;
+            long den = n * sxx - sx * sx;
+            if (-num * (n - 1) < BATTERY_MIN_DROP_MV * den)
+                return BATTERY_DAYS_UNKNOWN;
+            // the line at the newest day, times n * den
+            long level = sy * den + num * ((long)n * (n - 1) - sx);
+            long above = level + ((long)newest - (long)cutoffMv) * n * den;
+            if (above <= 0)
+                return 0;
+            unsigned long days = above / (-num * n);
+            return days < BATTERY_DAYS_UNKNOWN ? days : BATTERY_DAYS_UNKNOWN - 1;
+        }
+
+        unsigned int points[BATTERY_POINTS];
+        byte count;
+        byte next;
+        // the day being averaged
+        unsigned long dayStart;
+        unsigned long sum;
+        unsigned int samples;
+};
+
+#endif // BATTERYTREND_H
@@ -0,0 +1,239 @@
+#define LOG_MODULE  3
+#include <stddef.h>
+#include <EEPROM.h>
+#include "ConfigStore.h"
+#include "util.h"
+#include "debug.h"
+
+// the sections of SwitchSettings after its header
+enum ConfigSection {
+    SECTION_RFM12B,
+    SECTION_MPR121,
+    SECTION_SLEEP,
+    SECTION_GESTURE,
+    SECTION_CALIBRATION,
+    SECTION_SLIDER,
+    SECTION_BATTERY,
+    SECTIONS
+};
+
+// where each section is in SwitchSettings
+static const byte sectionOffset[SECTIONS] = {
+    offsetof(SwitchSettings, rfm12b),
+    offsetof(SwitchSettings, mpr121),
+    offsetof(SwitchSettings, sleep),
+    offsetof(SwitchSettings, gesture),
+    offsetof(SwitchSettings, calibration),
+    offsetof(SwitchSettings, slider),
+    offsetof(SwitchSettings, battery),
+};
+
+struct ConfigLayout {
+    byte minor;
+    byte size[SECTIONS];
+};
+
+#define RFM12B      sizeof(RFM12BSettings)
+#define MPR121      sizeof(MPR121Settings)
+#define SLEEP_1     offsetof(SleepSettings, repeatCoalesce)
+#define SLEEP_7     offsetof(SleepSettings, ackPercentile)
+#define SLEEP_8     offsetof(SleepSettings, statusPiggyback)
+#define SLEEP       sizeof(SleepSettings)
+#define GESTURE_2   offsetof(GestureSettings, table)
+#define GESTURE_3   offsetof(GestureSettings, chordMs)
+#define GESTURE_5   offsetof(GestureSettings, enabledHigh)
+#define GESTURE_11  offsetof(GestureSettings, doubleTapElectrodesHigh)
+#define GESTURE     sizeof(GestureSettings)
+#define CALIBRATION sizeof(CalibrationSettings)
+#define SLIDER      sizeof(SliderSettings)
+#define BATTERY     sizeof(BatterySettings)
+
+// The size of each section in the settings of a minor version, packed as
+// avr-gcc lays them out.  Appending a field to a section: replace the
+// sizeof() of the section in the earlier rows by the offsetof() of the new
+// field and add a row for the new FIRMWARE_MINOR_VERSION.
+static const ConfigLayout layouts[] = {
+    { 1,  { RFM12B, MPR121, SLEEP_1, 0, 0, 0, 0 } },
+    { 2,  { RFM12B, MPR121, SLEEP_1, GESTURE_2, 0, 0, 0 } },
+    { 3,  { RFM12B, MPR121, SLEEP_1, GESTURE_3, 0, 0, 0 } },
+    { 4,  { RFM12B, MPR121, SLEEP_1, GESTURE_3, CALIBRATION, 0, 0 } },
+    { 5,  { RFM12B, MPR121, SLEEP_1, GESTURE_5, CALIBRATION, 0, 0 } },
+    { 6,  { RFM12B, MPR121, SLEEP_1, GESTURE_5, CALIBRATION, SLIDER, 0 } },
+    { 7,  { RFM12B, MPR121, SLEEP_7, GESTURE_5, CALIBRATION, SLIDER, 0 } },
+    { 8,  { RFM12B, MPR121, SLEEP_8, GESTURE_5, CALIBRATION, SLIDER, 0 } },
+    { 9,  { RFM12B, MPR121, SLEEP, GESTURE_5, CALIBRATION, SLIDER, 0 } },
+    { 10, { RFM12B, MPR121, SLEEP, GESTURE_5, CALIBRATION, SLIDER, BATTERY } },
+    { 11, { RFM12B, MPR121, SLEEP, GESTURE_11, CALIBRATION, SLIDER, BATTERY } },
+    { 12, { RFM12B, MPR121, SLEEP, GESTURE, CALIBRATION, SLIDER, BATTERY } },
+};
+#define LAYOUTS     (sizeof(layouts) / sizeof(layouts[0]))
+
+// a record of the current layout in a slot, checked at compile time
+typedef char configFitsSlot[CONFIG_RECORD_SIZE(sizeof(SwitchSettings)) <=
+                            CONFIG_SLOT_SIZE ? 1 : -1];
+// the slots leave a byte for the power on count
+typedef char bootCountFits[CONFIG_BOOT_ADDR < CONFIG_EEPROM_SIZE ? 1 : -1];
+
+static const ConfigLayout *
+findLayout(byte minor)
+{
+    for (byte i = 0; i < LAYOUTS; ++i) {
+        if (layouts[i].minor == minor)
+            return &layouts[i];
+    }
+    return NULL;
+}
+
+// packs settings in the current layout, returns the length
+static byte
+pack(const SwitchSettings &settings, byte *blob)
+{
+    const ConfigLayout *layout = &layouts[LAYOUTS - 1];
+    const byte *s = (const byte *)&settings;
+    memcpy(blob, &settings.header, sizeof(settings.header));
+    byte len = sizeof(settings.header);
+    for (byte i = 0; i < SECTIONS; ++i) {
+        memcpy(blob + len, s + sectionOffset[i], layout->size[i]);
+        len += layout->size[i];
+    }
+    return len;
+}
+
+bool
+ConfigStore::migrate(const byte *blob, byte len, SwitchSettings &settings)
+{
+    SwitchSettings::Header header;
+    if (len < sizeof(header))
+        return false;
+    memcpy(&header, blob, sizeof(header));
+    const ConfigLayout *layout = findLayout(header.minor);
+    if (header.major != FIRMWARE_MAJOR_VERSION || !layout)
+        return false;
+
+    unsigned int total = sizeof(header);
+    for (byte i = 0; i < SECTIONS; ++i)
+        total += layout->size[i];
+    if (total > len)
+        return false;
+
+    // a section is never smaller in the current layout, the fields it
+    // lacks in blob keep their values
+    byte *s = (byte *)&settings;
+    byte pos = sizeof(header);
+    for (byte i = 0; i < SECTIONS; ++i) {
+        memcpy(s + sectionOffset[i], blob + pos, layout->size[i]);
+        pos += layout->size[i];
+    }
+    settings.header = SwitchSettings::Header();
+    return true;
+}
+
+byte
+ConfigStore::readRecord(byte slot, byte *blob)
+{
+    int addr = slot * CONFIG_SLOT_SIZE;
+    byte header[CONFIG_HEADER_SIZE];
+    for (byte i = 0; i < CONFIG_HEADER_SIZE; ++i)
+        header[i] = EEPROM.read(addr++);
+    byte len = header[CONFIG_HEADER_SIZE - 1];
+    if (header[0] != CONFIG_MAGIC ||
+        CONFIG_RECORD_SIZE(len) > CONFIG_SLOT_SIZE)
+        return 0;
+    for (byte i = 0; i < len; ++i)
+        blob[i] = EEPROM.read(addr++);
+    unsigned int crc = EEPROM.read(addr) | (EEPROM.read(addr + 1) << 8);
+    if (crc16(blob, len, crc16(header, sizeof(header))) != crc)
+        return 0;
+    return len;
+}
+
+byte
+ConfigStore::load(SwitchSettings &settings)
+{
+    // the sequence numbers of the slots holding a record
+    unsigned int sequences[CONFIG_SLOTS];
+    bool candidate[CONFIG_SLOTS];
+    for (byte i = 0; i < CONFIG_SLOTS; ++i) {
+        int addr = i * CONFIG_SLOT_SIZE;
+        candidate[i] = EEPROM.read(addr) == CONFIG_MAGIC;
+        sequences[i] = EEPROM.read(addr + 1) | (EEPROM.read(addr + 2) << 8);
+    }
+
+    // the newest intact record, a torn one falls back to the previous
+    byte blob[CONFIG_SLOT_SIZE];
+    for (byte tries = 0; tries < CONFIG_SLOTS; ++tries) {
+        byte newest = 0xFF;
+        for (byte i = 0; i < CONFIG_SLOTS; ++i) {
+            if (candidate[i] && (newest == 0xFF ||
+                    (int16_t)(sequences[i] - sequences[newest]) > 0))
+                newest = i;
+        }
+        if (newest == 0xFF)
+            break;
+        candidate[newest] = false;
+        byte len = readRecord(newest, blob);
+        if (!len) {
+            DEBUG("config: bad record in slot ", newest);
+            continue;
+        }
+        // the newest record stays the newest even if it is not usable
+        slot = newest;
+        sequence = sequences[newest];
+        DEBUG("config: slot ", slot, " sequence ", sequence);
+        if (!migrate(blob, len, settings))
+            return CONFIG_NONE;
+        return blob[1] == FIRMWARE_MINOR_VERSION ? CONFIG_LOADED :
+            CONFIG_MIGRATED;
+    }
+
+    // the settings earlier firmware saved in place
+    for (byte i = 0; i < sizeof(blob); ++i)
+        blob[i] = EEPROM.read(i);
+    if (!migrate(blob, sizeof(blob), settings))
+        return CONFIG_NONE;
+    DEBUG("config: saved in place by version ", blob[1]);
+    return CONFIG_MIGRATED;
+}
+
+byte
+ConfigStore::countBoot()
+{
+    byte count = EEPROM.read(CONFIG_BOOT_ADDR) + 1;
+    EEPROM.write(CONFIG_BOOT_ADDR, count);
+    return count;
+}
+
+bool
+ConfigStore::commit(const SwitchSettings &settings)
+{
+    byte record[CONFIG_SLOT_SIZE];
+    byte len = pack(settings, record + CONFIG_HEADER_SIZE);
+    unsigned int seq = (sequence + 1) & 0xFFFF;
+    record[0] = CONFIG_MAGIC;
+    record[1] = seq & 0xFF;
+    record[2] = seq >> 8;
+    record[3] = len;
+    unsigned int crc = crc16(record, CONFIG_HEADER_SIZE + len);
+    record[CONFIG_HEADER_SIZE + len] = crc & 0xFF;
+    record[CONFIG_HEADER_SIZE + len + 1] = crc >> 8;
+
+    // the slot after the newest record holds the oldest one.  Without a
+    // record slot 0 may hold the settings saved in place, spare them until
+    // the record is written.
+    byte next = slot == 0xFF ? 1 % CONFIG_SLOTS : (slot + 1) % CONFIG_SLOTS;
+    int addr = next * CONFIG_SLOT_SIZE;
+    for (byte i = 0; i < CONFIG_RECORD_SIZE(len); ++i, ++addr) {
+        if (EEPROM.read(addr) != record[i])
+            EEPROM.write(addr, record[i]);
+    }
+    DEBUG("config: committed slot ", next, " sequence ", seq);
+
+    addr = next * CONFIG_SLOT_SIZE;
+    for (byte i = 0; i < CONFIG_RECORD_SIZE(len); ++i, ++addr) {
+        if (EEPROM.read(addr) != record[i])
+            return false;
+    }
+    slot = next;
+    sequence = seq;
+    return true;
+}
@@ -0,0 +1,74 @@
+#ifndef CONFIGSTORE_H
+#define CONFIGSTORE_H
+
+#if ARDUINO >= 100
+  #include <Arduino.h> // Arduino 1.0
+#else
+  #include <WProgram.h> // Arduino 0022
+#endif
+
+#include "SwitchSettings.h"
+
+// the EEPROM is divided into CONFIG_SLOTS slots of CONFIG_SLOT_SIZE bytes,
+// the slot size must not change so that older firmware's records are found
+#define CONFIG_EEPROM_SIZE  (E2END + 1)
+#define CONFIG_SLOT_SIZE    170
+#define CONFIG_SLOTS        (CONFIG_EEPROM_SIZE / CONFIG_SLOT_SIZE)
+// the first byte after the slots counts the power ons
+#define CONFIG_BOOT_ADDR    (CONFIG_SLOTS * CONFIG_SLOT_SIZE)
+// first byte of a record, never the major version at the start of the
+// settings saved in place at offset 0 by earlier firmware
+#define CONFIG_MAGIC        0xC5
+// magic, sequence and length, then the settings and their CRC
+#define CONFIG_HEADER_SIZE  4
+#define CONFIG_RECORD_SIZE(len) (CONFIG_HEADER_SIZE + (len) + 2)
+
+// ConfigStore::load()
+#define CONFIG_NONE         0
+#define CONFIG_LOADED       1
+// of an older minor version or saved in place, commit it again
+#define CONFIG_MIGRATED     2
+
+// Journal of the settings in EEPROM.  Each commit writes a record with a
+// sequence number one higher to the slot after the newest, overwriting
+// the oldest, so the EEPROM wears evenly and a commit cut short by a
+// reset leaves the previous record intact.  A CRC covers every record.
+// Settings of an older minor version are migrated section by section:
+// fields are only ever appended to a section, the ones a record lacks
+// keep their defaults.
+class ConfigStore {
+    public:
+        ConfigStore() : slot(0xFF), sequence(0) {}
+
+        // loads the newest intact record into settings, or the settings an
+        // earlier firmware saved in place.  Returns CONFIG_NONE, settings
+        // left alone, if there are none or of another major version.
+        byte load(SwitchSettings &settings);
+        // writes settings to the next slot, bytes that are unchanged in it
+        // are not written.  Returns false if the record did not read back.
+        bool commit(const SwitchSettings &settings);
+
+        // the slot of the newest record, 0xFF if there is none
+        byte getSlot() const { return slot; }
+        unsigned int getSequence() const { return sequence; }
+
+        // counts a power on and returns the count, the events after it are
+        // numbered from there so the hub tells them from a retry of those
+        // of the previous power on
+        static byte countBoot();
+
+        // copies the sections of the settings in blob, len bytes of the
+        // layout of blob's header, into settings
+        static bool migrate(const byte *blob, byte len,
+                            SwitchSettings &settings);
+
+    protected:
+        // reads the record in slot into blob, returns its length, 0 if it
+        // is not intact
+        byte readRecord(byte slot, byte *blob);
+
+        byte slot;
+        unsigned int sequence;
+};
+
+#endif // CONFIGSTORE_H
@@ -0,0 +1,39 @@
+#ifndef DUTYCOUNTER_H
+#define DUTYCOUNTER_H
+
+#if ARDUINO >= 100
+  #include <Arduino.h> // Arduino 1.0
+#else
+  #include <WProgram.h> // Arduino 0022
+#endif
+
+// time spent in a code path since boot, summed from micros() intervals.
+// micros() stops while the MCU sleeps, so only awake time is counted.
+class DutyCounter {
+    public:
+        DutyCounter() : ms(0), us(0), startedAt(0) {}
+
+        // starts an interval
+        void start() { startedAt = micros(); }
+        // ends the interval started by start()
+        void stop() { add(micros() - startedAt); }
+
+        void add(unsigned long elapsed) {
+            // intervals are short, avoid the 32 bit division
+            elapsed += us;
+            while (elapsed >= 1000) {
+                elapsed -= 1000;
+                ms++;
+            }
+            us = elapsed;
+        }
+
+        unsigned long getMs() const { return ms; }
+
+    protected:
+        unsigned long ms;
+        unsigned int us;
+        unsigned long startedAt;
+};
+
+#endif // DUTYCOUNTER_H
@@ -0,0 +1,79 @@
+#include "ElectrodeStream.h"
+
+// marks a delta that does not fit a byte, the absolute value follows
+#define STREAM_ESCAPE   0x80
+
+ElectrodeStream::ElectrodeStream() : size(0)
+{
+    packet.sequence = 0;
+    reset(0);
+}
+
+void
+ElectrodeStream::reset(byte period)
+{
+    if (packet.samples)
+        packet.sequence++;
+    packet.period = period;
+    packet.channels = 0;
+    packet.samples = 0;
+    size = 0;
+    packet.len = sizeof(packet) - STREAM_DATA_SIZE;
+}
+
+bool
+ElectrodeStream::add(byte channels, const unsigned int *filtered,
+                     const byte *baseline)
+{
+    // worst case: an escaped delta per channel, the baseline mask and every
+    // baseline changed
+    byte buf[3 * STREAM_MAX_CHANNELS + (STREAM_MAX_CHANNELS + 7) / 8];
+    byte n = 0;
+
+    if (channels > STREAM_MAX_CHANNELS)
+        channels = STREAM_MAX_CHANNELS;
+    // the channel count can only change with a new packet
+    if (packet.samples && channels != packet.channels)
+        return false;
+
+    if (!packet.samples) {
+        for (byte i = 0; i < channels; ++i) {
+            buf[n++] = filtered[i] & 0xFF;
+            buf[n++] = filtered[i] >> 8;
+            buf[n++] = baseline[i];
+        }
+    }
+    else {
+        for (byte i = 0; i < channels; ++i) {
+            int delta = (int)filtered[i] - (int)lastFiltered[i];
+            if (delta > -128 && delta < 128)
+                buf[n++] = (byte)delta;
+            else {
+                buf[n++] = STREAM_ESCAPE;
+                buf[n++] = filtered[i] & 0xFF;
+                buf[n++] = filtered[i] >> 8;
+            }
+        }
+        byte *mask = buf + n;
+        n += (channels + 7) / 8;
+        memset(mask, 0, (channels + 7) / 8);
+        for (byte i = 0; i < channels; ++i) {
+            if (baseline[i] == lastBaseline[i])
+                continue;
+            mask[i >> 3] |= 1 << (i & 7);
+            buf[n++] = baseline[i];
+        }
+    }
+
+    if (size + n > STREAM_DATA_SIZE || packet.samples == 0xFF)
+        return false;
+
+    memcpy(packet.data + size, buf, n);
+    size += n;
+    packet.len += n;
+    packet.channels = channels;
+    packet.samples++;
+    memcpy(lastFiltered, filtered, channels * sizeof(*filtered));
+    memcpy(lastBaseline, baseline, channels);
+    return true;
+}
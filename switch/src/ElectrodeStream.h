@@ -0,0 +1,40 @@
+#ifndef ELECTRODESTREAM_H
+#define ELECTRODESTREAM_H
+
+#if ARDUINO >= 100
+  #include <Arduino.h> // Arduino 1.0
+#else
+  #include <WProgram.h> // Arduino 0022
+#endif
+
+#include "SwitchProtocol.h"
+#include "TouchSequence.h"
+
+#define STREAM_MAX_CHANNELS MPR121_CHANNELS
+
+// delta encodes electrode samples into STREAM_DATA packets, see
+// SwitchStreamData for the format
+class ElectrodeStream {
+    public:
+        ElectrodeStream();
+
+        // starts a new packet, the next sample is a keyframe
+        void reset(byte period);
+        // appends a sample
+        // returns false if the packet has no room left for it, send the
+        // packet and reset() before adding it again
+        bool add(byte channels, const unsigned int *filtered,
+                 const byte *baseline);
+        // returns true if no samples were added since reset()
+        bool isEmpty() { return !packet.samples; }
+
+        // the packet to send, packet.len is kept up to date
+        SwitchStreamData packet;
+
+    protected:
+        byte size;
+        unsigned int lastFiltered[STREAM_MAX_CHANNELS];
+        byte lastBaseline[STREAM_MAX_CHANNELS];
+};
+
+#endif // ELECTRODESTREAM_H
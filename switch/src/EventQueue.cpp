@@ -0,0 +1,99 @@
+#include "EventQueue.h"
+
+EventQueue::EventQueue() :
+    len(0), count(0), sequence(0), restart(true), unsent(false),
+    attempts(0), retryAt(0), dropped(0)
+{
+}
+
+void
+EventQueue::begin(byte sequence, bool restart)
+{
+    this->sequence = sequence;
+    this->restart = restart;
+}
+
+void
+EventQueue::drop(byte n)
+{
+    for (byte i = 0; i < n && count; ++i) {
+        byte first = ((const SwitchPacket *)data)->len;
+        len -= first;
+        memmove(data, data + first, len);
+        count--;
+        sequence++;
+        dropped++;
+    }
+}
+
+void
+EventQueue::add(const SwitchPacket &pkt)
+{
+    if (pkt.len > sizeof(data))
+        return;
+    while (len + pkt.len > sizeof(data))
+        drop(1);
+    memcpy(data + len, &pkt, pkt.len);
+    len += pkt.len;
+    count++;
+    unsent = true;
+}
+
+bool
+EventQueue::isDue(unsigned long now)
+{
+    if (!count)
+        return false;
+    return unsent || (long)(now - retryAt) >= 0;
+}
+
+bool
+EventQueue::getRetryAt(unsigned long &at)
+{
+    if (!count || unsent)
+        return false;
+    at = retryAt;
+    return true;
+}
+
+byte
+EventQueue::fill(byte *buf)
+{
+    if (!count)
+        return 0;
+    SwitchSequence pkt;
+    pkt.sequence = sequence;
+    pkt.flags = restart ? SEQUENCE_RESTART : 0;
+    if (attempts)
+        pkt.flags |= SEQUENCE_RETRY;
+    memcpy(buf, &pkt, sizeof(pkt));
+    memcpy(buf + sizeof(pkt), data, len);
+    unsent = false;
+    return sizeof(pkt) + len;
+}
+
+void
+EventQueue::acked()
+{
+    sequence += count;
+    len = 0;
+    count = 0;
+    attempts = 0;
+    restart = false;
+}
+
+void
+EventQueue::missed(unsigned long now)
+{
+    if (!count)
+        return;
+    if (++attempts >= EVENT_RETRY_MAX) {
+        drop(count);
+        attempts = 0;
+        return;
+    }
+    // the clock at a miss varies enough to spread the retries of switches
+    // hit by the same interference
+    retryAt = now + ((unsigned long)EVENT_RETRY_MS << (attempts - 1)) +
+              now % EVENT_RETRY_MS;
+}
@@ -0,0 +1,71 @@
+#ifndef EVENTQUEUE_H
+#define EVENTQUEUE_H
+
+#if ARDUINO >= 100
+  #include <Arduino.h> // Arduino 1.0
+#else
+  #include <WProgram.h> // Arduino 0022
+#endif
+
+#include "SwitchProtocol.h"
+
+// bytes of queued touch events and corrections, about 5 events
+#define EVENT_QUEUE_SIZE    32
+// the first retry after a missed ACK, doubled with each further miss, plus
+// up to as much again of jitter
+#define EVENT_RETRY_MS      100
+// sends of the queued events before they are dropped
+#define EVENT_RETRY_MAX     5
+
+// Holds the touch events and corrections until a packet carrying them is
+// acknowledged.  The events are numbered consecutively for the hub to drop
+// the ones it has seen, a SwitchSequence ahead of them carries the number
+// of the first one.  Events queued while earlier ones wait for their retry
+// are sent with them in one packet, the earliest are dropped if the queue
+// overflows or after EVENT_RETRY_MAX sends without an ACK.
+class EventQueue {
+    public:
+        EventQueue();
+
+        // numbers the events from sequence, restart flags the packets with
+        // SEQUENCE_RESTART until the first ACK
+        void begin(byte sequence, bool restart);
+        // queues an event or correction
+        void add(const SwitchPacket &pkt);
+        bool isEmpty() { return !count; }
+        // true if events were queued since the last send or their retry is
+        // due at now (ms)
+        bool isDue(unsigned long now);
+        // the time of the retry, false if no retry is pending
+        bool getRetryAt(unsigned long &at);
+        // writes the SwitchSequence and the events to buf, which holds
+        // sizeof(SwitchSequence) + EVENT_QUEUE_SIZE bytes, returns their
+        // length.  SEQUENCE_RETRY flags them after a missed ACK.
+        byte fill(byte *buf);
+        // the packet last filled was acknowledged
+        void acked();
+        // the packet last filled was not acknowledged at now (ms)
+        void missed(unsigned long now);
+        // the number of the next event queued
+        byte getNext() { return sequence + count; }
+        // events dropped without an ACK
+        unsigned int getDropped() { return dropped; }
+
+    protected:
+        void drop(byte n);
+
+        byte data[EVENT_QUEUE_SIZE];
+        byte len;
+        byte count;
+        // the number of the first queued event
+        byte sequence;
+        bool restart;
+        // events were queued since the last send
+        bool unsent;
+        // sends without an ACK
+        byte attempts;
+        unsigned long retryAt;
+        unsigned int dropped;
+};
+
+#endif // EVENTQUEUE_H
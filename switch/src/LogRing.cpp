@@ -0,0 +1,112 @@
+#include "LogRing.h"
+
+#if defined(DEBUG_LOG)
+
+byte LogRing::record[LOG_MAX_RECORD];
+byte LogRing::recordLen = 0;
+byte LogRing::ring[LOG_RING_SIZE];
+unsigned int LogRing::head = 0;
+unsigned int LogRing::used = 0;
+unsigned int LogRing::dropped = 0;
+
+void
+LogRing::begin(unsigned int id)
+{
+    unsigned long ms = millis();
+    recordLen = 1;
+    record[recordLen++] = id & 0xFF;
+    record[recordLen++] = id >> 8;
+    for (byte i = 0; i < 4; ++i)
+        record[recordLen++] = ms >> (8 * i);
+}
+
+void
+LogRing::put(const void *data, byte len)
+{
+    // arguments that do not fit are left out
+    if (recordLen + len > LOG_MAX_RECORD)
+        return;
+    memcpy(record + recordLen, data, len);
+    recordLen += len;
+}
+
+void
+LogRing::arg(long value)
+{
+    if (value >= 0 && value <= 0xFF) {
+        byte v[2] = { LOG_U8, (byte)value };
+        put(v, sizeof(v));
+    }
+    else if (value >= -32768L && value <= 32767L) {
+        byte v[3] = { LOG_I16, (byte)value, (byte)(value >> 8) };
+        put(v, sizeof(v));
+    }
+    else {
+        byte v[5] = { LOG_I32, (byte)value, (byte)(value >> 8),
+                      (byte)(value >> 16), (byte)(value >> 24) };
+        put(v, sizeof(v));
+    }
+}
+
+void
+LogRing::arg(unsigned long value)
+{
+    if (value <= 0xFF) {
+        byte v[2] = { LOG_U8, (byte)value };
+        put(v, sizeof(v));
+    }
+    else if (value <= 0xFFFF) {
+        byte v[3] = { LOG_U16, (byte)value, (byte)(value >> 8) };
+        put(v, sizeof(v));
+    }
+    else {
+        byte v[5] = { LOG_U32, (byte)value, (byte)(value >> 8),
+                      (byte)(value >> 16), (byte)(value >> 24) };
+        put(v, sizeof(v));
+    }
+}
+
+void
+LogRing::str(const char *s)
+{
+    byte len = strlen(s);
+    if (len > LOG_MAX_STR)
+        len = LOG_MAX_STR;
+    byte v[2 + LOG_MAX_STR] = { LOG_STR, len };
+    memcpy(v + 2, s, len);
+    put(v, 2 + len);
+}
+
+void
+LogRing::end()
+{
+    record[0] = recordLen;
+    // make room by dropping the oldest records
+    while (LOG_RING_SIZE - used < recordLen) {
+        byte size = ring[head];
+        head = (head + size) % LOG_RING_SIZE;
+        used -= size;
+        dropped++;
+    }
+    unsigned int tail = (head + used) % LOG_RING_SIZE;
+    for (byte i = 0; i < recordLen; ++i)
+        ring[(tail + i) % LOG_RING_SIZE] = record[i];
+    used += recordLen;
+}
+
+byte
+LogRing::read(byte *buf, byte max)
+{
+    byte n = 0;
+    while (used && ring[head] <= max - n) {
+        byte size = ring[head];
+        for (byte i = 0; i < size; ++i)
+            buf[n++] = ring[(head + i) % LOG_RING_SIZE];
+        head = (head + size) % LOG_RING_SIZE;
+        used -= size;
+    }
+    dropped = 0;
+    return n;
+}
+
+#endif // DEBUG_LOG
@@ -0,0 +1,56 @@
+#ifndef LOGRING_H
+#define LOGRING_H
+
+#if ARDUINO >= 100
+  #include <Arduino.h> // Arduino 1.0
+#else
+  #include <WProgram.h> // Arduino 0022
+#endif
+
+#include <stddef.h>
+#include "DebugLog.h"
+
+// bytes of RAM holding the records
+#ifndef LOG_RING_SIZE
+#define LOG_RING_SIZE       256
+#endif
+
+// The DEBUG() records of a DEBUG_LOG build, see DebugLog.h.  A record is
+// built by begin(), arg() for each argument and end(), which moves it into
+// the ring and overwrites the oldest records if it is full.
+class LogRing {
+    public:
+        static void begin(unsigned int id);
+        static void arg(int value) { arg((long)value); }
+        static void arg(unsigned int value) { arg((unsigned long)value); }
+        static void arg(long value);
+        static void arg(unsigned long value);
+        // string literals are not recorded, the decoder knows them
+        template <size_t N>
+        static void arg(const char (&)[N]) {}
+        template <class T>
+        static void arg(T *const &s) { str(s); }
+        static void end();
+
+        // bytes of the records held
+        static unsigned int size() { return used; }
+        // records overwritten since the last read()
+        static unsigned int getDropped() { return dropped; }
+        // moves whole records to buf, oldest first, at most max bytes.
+        // Returns the bytes moved, 0 if the oldest record does not fit.
+        static byte read(byte *buf, byte max);
+
+    protected:
+        static void put(const void *data, byte len);
+        static void str(const char *s);
+
+        static byte record[LOG_MAX_RECORD];
+        static byte recordLen;
+        static byte ring[LOG_RING_SIZE];
+        // oldest record
+        static unsigned int head;
+        static unsigned int used;
+        static unsigned int dropped;
+};
+
+#endif // LOGRING_H
@@ -0,0 +1,185 @@
+#include "PowerScheduler.h"
+
+// only the touch IRQ and the status timer wake up an idle switch, the
+// watchdog runs while a sequence waits for its next event
+const PowerStateInfo powerStates[POWER_STATES] = {
+    // POWER_IDLE
+    { MODE_POWER_DOWN, WAKE_TOUCH | WAKE_RADIO, PERIOD_NONE },
+    // POWER_TOUCHING
+    { MODE_STANDBY, WAKE_TOUCH | WAKE_WATCHDOG | WAKE_RADIO, PERIOD_TOUCH },
+    // POWER_RELEASED
+    { MODE_STANDBY, WAKE_TOUCH | WAKE_WATCHDOG | WAKE_RADIO, PERIOD_RELEASE },
+    // POWER_PROXIMITY
+    { MODE_STANDBY, WAKE_TOUCH | WAKE_WATCHDOG | WAKE_RADIO,
+      PERIOD_PROXIMITY },
+    // POWER_REPEATING
+    { MODE_STANDBY, WAKE_TOUCH | WAKE_WATCHDOG | WAKE_RADIO, PERIOD_REPEAT },
+    // POWER_SLIDING
+    { MODE_STANDBY, WAKE_TOUCH | WAKE_WATCHDOG | WAKE_RADIO, PERIOD_SLIDER },
+    // POWER_STATUS, touches are serviced once the status is sent
+    { MODE_AWAKE, 0, PERIOD_NONE },
+    // POWER_AWAITING_ACK, at most SleepSettings::replyWakeLock
+    { MODE_AWAKE, WAKE_ACK, PERIOD_NONE },
+};
+
+// a change of the touch status starts the period of the new status, the end
+// of a period repeats the event while touched and finishes the gesture
+// otherwise
+#define CHANGES                                                             \
+    { POWER_TOUCHING, ACTION_CHANGE },                                      \
+    { POWER_PROXIMITY, ACTION_CHANGE },                                     \
+    { POWER_RELEASED, ACTION_CHANGE }
+#define TIMEOUTS                                                            \
+    { POWER_REPEATING, ACTION_REPEAT },                                     \
+    { POWER_SLIDING, ACTION_SLIDE },                                        \
+    { POWER_IDLE, ACTION_FINISH },                                          \
+    { POWER_IDLE, ACTION_NONE }
+
+const PowerTransition powerTransitions[POWER_TOUCH_STATES][POWER_EVENTS] = {
+    // POWER_IDLE, has no period to end
+    { CHANGES,
+      { POWER_IDLE, ACTION_NONE },
+      { POWER_IDLE, ACTION_NONE },
+      { POWER_IDLE, ACTION_NONE },
+      { POWER_IDLE, ACTION_NONE } },
+    // POWER_TOUCHING
+    { CHANGES, TIMEOUTS },
+    // POWER_RELEASED
+    { CHANGES, TIMEOUTS },
+    // POWER_PROXIMITY
+    { CHANGES, TIMEOUTS },
+    // POWER_REPEATING
+    { CHANGES, TIMEOUTS },
+    // POWER_SLIDING, keeps sampling at the slider period while touched
+    { { POWER_SLIDING, ACTION_CHANGE | ACTION_KEEP_PERIOD },
+      { POWER_PROXIMITY, ACTION_CHANGE },
+      { POWER_RELEASED, ACTION_CHANGE },
+      TIMEOUTS },
+};
+
+PowerScheduler::PowerScheduler(byte gangs) :
+    gangs(gangs), radio(POWER_IDLE), sliderEnabled(false)
+{
+    for (byte g = 0; g < MAX_TOUCH_SENSORS; ++g) {
+        state[g] = POWER_IDLE;
+        wakeAt[g] = 0;
+        repeats[g] = 0;
+    }
+    setPeriods(SleepSettings(), SliderSettings());
+}
+
+void
+PowerScheduler::setPeriods(const SleepSettings &sleep,
+                           const SliderSettings &slider)
+{
+    periods[PERIOD_NONE] = SLEEP_FOREVER;
+    periods[PERIOD_TOUCH] = sleep.touch;
+    periods[PERIOD_RELEASE] = sleep.release;
+    periods[PERIOD_PROXIMITY] = sleep.proximity;
+    periods[PERIOD_REPEAT] = sleep.repeat;
+    periods[PERIOD_SLIDER] = slider.period;
+    sliderEnabled = slider.flags & SLIDER_ENABLED;
+    repeatAccel = sleep.repeatAccel;
+    repeatFastest = sleep.repeatFastest;
+}
+
+byte
+PowerScheduler::getPeriod(byte g)
+{
+    byte p = powerStates[state[g]].period;
+    byte period = periods[p];
+    if (p != PERIOD_REPEAT || !repeatAccel || period <= repeatFastest)
+        return period;
+    // one step shorter every repeatAccel ticks
+    byte steps = repeats[g] / repeatAccel;
+    return period - repeatFastest > steps ? period - steps : repeatFastest;
+}
+
+byte
+PowerScheduler::poll(byte g, TouchSequence &touch, unsigned long now)
+{
+    if (touch.isInterrupted()) {
+        unsigned int status = touch.getStatus();
+        touch.update(now);
+        touch.enableInterrupt();
+        // the interrupt line is shared, it may have been another gang
+        if (touch.getStatus() != status) {
+            if (touch.isTouched())
+                return EVENT_TOUCH;
+            return touch.isProximity() ? EVENT_PROXIMITY : EVENT_RELEASE;
+        }
+    }
+
+    if (powerStates[state[g]].period == PERIOD_NONE ||
+        (long)(now - wakeAt[g]) < 0)
+        return EVENT_NONE;
+    // the period ended w/o an interrupt
+    if (!touch.isTouched() && !touch.isProximity())
+        return EVENT_TIMEOUT;
+    touch.update(now);
+    if (sliderEnabled && touch.isOnSlider())
+        return EVENT_ON_SLIDER;
+    return EVENT_HELD;
+}
+
+byte
+PowerScheduler::handle(byte g, byte event, unsigned long now)
+{
+    const PowerTransition &t = powerTransitions[state[g]][event];
+    state[g] = t.next;
+    if ((t.action & ~ACTION_KEEP_PERIOD) == ACTION_REPEAT) {
+        if (repeats[g] < 0xFF)
+            repeats[g]++;
+    }
+    else if (!(t.action & ACTION_KEEP_PERIOD))
+        repeats[g] = 0;
+    if (!(t.action & ACTION_KEEP_PERIOD))
+        wakeAt[g] = now + ((unsigned long)WDT_SLICE_MS << getPeriod(g));
+    return t.action & ~ACTION_KEEP_PERIOD;
+}
+
+byte
+PowerScheduler::enter(byte state)
+{
+    byte previous = radio;
+    radio = state;
+    return previous;
+}
+
+byte
+PowerScheduler::getState()
+{
+    if (radio != POWER_IDLE)
+        return radio;
+    byte s = POWER_IDLE;
+    for (byte g = 0; g < gangs; ++g) {
+        if (powerStates[state[g]].mode > powerStates[s].mode)
+            s = state[g];
+    }
+    return s;
+}
+
+bool
+PowerScheduler::getWakeAt(unsigned long &at)
+{
+    bool timed = false;
+    for (byte g = 0; g < gangs; ++g) {
+        if (powerStates[state[g]].period == PERIOD_NONE)
+            continue;
+        if (!timed || (long)(wakeAt[g] - at) < 0)
+            at = wakeAt[g];
+        timed = true;
+    }
+    return timed;
+}
+
+bool
+PowerScheduler::isDueSoon(unsigned long now)
+{
+    for (byte g = 0; g < gangs; ++g) {
+        if (powerStates[state[g]].period != PERIOD_NONE &&
+            (long)(wakeAt[g] - now) < WDT_SLICE_MS)
+            return true;
+    }
+    return false;
+}
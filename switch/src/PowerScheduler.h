@@ -0,0 +1,150 @@
+#ifndef POWERSCHEDULER_H
+#define POWERSCHEDULER_H
+
+#if ARDUINO >= 100
+  #include <Arduino.h> // Arduino 1.0
+#else
+  #include <WProgram.h> // Arduino 0022
+#endif
+
+#include "SwitchSettings.h"
+#include "TouchSequence.h"
+
+// nominal length of the shortest watchdog sleep
+#define WDT_SLICE_MS        16
+
+// power states of the switch.  Each gang is in one of the touch states, the
+// node is in a radio state while it sends or listens and otherwise in the
+// touch state of the gang that needs the most power.
+enum PowerState {
+    // touch states
+    POWER_IDLE,             // nothing touched, waiting for a touch
+    POWER_TOUCHING,         // touched, waiting for a release or a repeat
+    POWER_RELEASED,         // released, waiting for the sequence to end
+    POWER_PROXIMITY,        // a hand near the plate
+    POWER_REPEATING,        // held, repeat events
+    POWER_SLIDING,          // held on the slider, sampling its position
+    // radio states
+    POWER_STATUS,           // calibrating and sending the status
+    POWER_AWAITING_ACK,     // listening for the ACK of a packet
+    POWER_STATES
+};
+#define POWER_TOUCH_STATES  (POWER_SLIDING + 1)
+
+// sleep modes of the MCU, in the order of the power they draw
+enum PowerMode {
+    MODE_POWER_DOWN,        // powerDown(SLEEP_FOREVER), watchdog off
+    MODE_STANDBY,           // powerStandby() in watchdog slices
+    MODE_AWAKE,             // running, the radio is on
+};
+
+// wake sources of a state
+#define WAKE_TOUCH          0x01    // MPR121 IRQ
+#define WAKE_WATCHDOG       0x02    // end of a watchdog slice
+#define WAKE_RADIO          0x04    // RFM12B wakeup timer, the status interval
+#define WAKE_ACK            0x08    // ACK received or replyWakeLock passed
+
+// the sleep period of a state
+enum PowerPeriod {
+    PERIOD_NONE,
+    PERIOD_TOUCH,           // SleepSettings::touch
+    PERIOD_RELEASE,         // SleepSettings::release
+    PERIOD_PROXIMITY,       // SleepSettings::proximity
+    PERIOD_REPEAT,          // SleepSettings::repeat, accelerated
+    PERIOD_SLIDER,          // SliderSettings::period
+    POWER_PERIODS
+};
+
+struct PowerStateInfo {
+    byte mode;
+    byte wakes;
+    byte period;
+};
+
+// what ends the sleep of a gang, see PowerScheduler::poll()
+enum PowerEvent {
+    EVENT_TOUCH,            // touch status changed, an electrode is touched
+    EVENT_PROXIMITY,        // touch status changed, proximity only
+    EVENT_RELEASE,          // touch status changed, nothing touched
+    EVENT_HELD,             // the period ended, still touched
+    EVENT_ON_SLIDER,        // the period ended, held on the slider
+    EVENT_TIMEOUT,          // the period ended, nothing touched
+    EVENT_DONE,             // the gesture was reported ahead of its timeout
+    POWER_EVENTS,
+    EVENT_NONE = 0xFF
+};
+
+// what the firmware does on a transition
+enum PowerAction {
+    ACTION_NONE,
+    ACTION_CHANGE,          // the touch status changed, commitEarly()
+    ACTION_REPEAT,          // a repeat event
+    ACTION_SLIDE,           // a slider sample
+    ACTION_FINISH,          // report the gesture and start a new sequence
+};
+// the transition keeps the running period
+#define ACTION_KEEP_PERIOD  0x80
+
+struct PowerTransition {
+    byte next;
+    byte action;
+};
+
+extern const PowerStateInfo powerStates[POWER_STATES];
+extern const PowerTransition powerTransitions[POWER_TOUCH_STATES][POWER_EVENTS];
+
+// Runs the touch states of the gangs through powerTransitions and tells the
+// main loop how to sleep.  Has no hardware dependencies besides the
+// TouchSequences, so the host benchmarks run the same state machine.
+class PowerScheduler {
+    public:
+        PowerScheduler(byte gangs);
+
+        // the sleep periods of the states and the repeat acceleration
+        void setPeriods(const SleepSettings &sleep,
+                        const SliderSettings &slider);
+
+        // returns the event that ended the sleep of gang g, EVENT_NONE if
+        // there was none.  Reads the touch status after an interrupt and
+        // re-enables it, the interrupt line may be shared with other gangs.
+        byte poll(byte g, TouchSequence &touch, unsigned long now);
+        // moves gang g to the state following the event and starts its
+        // period, returns the ACTION_* to perform
+        byte handle(byte g, byte event, unsigned long now);
+
+        // enters a radio state, POWER_IDLE to leave it
+        // returns the previous radio state
+        byte enter(byte state);
+
+        byte getState(byte g) { return state[g]; }
+        // the repeat ticks of the current hold of gang g (saturates)
+        byte getRepeats(byte g) { return repeats[g]; }
+        // the period_t of the state of gang g
+        byte getPeriod(byte g);
+        // the radio state or the touch state of the gang in the highest
+        // power mode
+        byte getState();
+        byte getMode() { return powerStates[getState()].mode; }
+        byte getWakes() { return powerStates[getState()].wakes; }
+        bool isIdle(byte g) { return state[g] == POWER_IDLE; }
+
+        // the earliest end of a period, returns false if no gang is in a
+        // timed state
+        bool getWakeAt(unsigned long &wakeAt);
+        // true if a period ends before the next watchdog slice
+        bool isDueSoon(unsigned long now);
+
+    protected:
+        byte gangs;
+        byte state[MAX_TOUCH_SENSORS];
+        unsigned long wakeAt[MAX_TOUCH_SENSORS];
+        byte repeats[MAX_TOUCH_SENSORS];
+        byte radio;
+        // period_t of each PowerPeriod
+        byte periods[POWER_PERIODS];
+        bool sliderEnabled;
+        byte repeatAccel;
+        byte repeatFastest;
+};
+
+#endif // POWERSCHEDULER_H
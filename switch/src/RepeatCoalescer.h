@@ -0,0 +1,52 @@
+#ifndef REPEATCOALESCER_H
+#define REPEATCOALESCER_H
+
+#if ARDUINO >= 100
+  #include <Arduino.h> // Arduino 1.0
+#else
+  #include <WProgram.h> // Arduino 0022
+#endif
+
+#include "SwitchSettings.h"
+
+// collects the repeat ticks of a held electrode, so a TouchEvent carries
+// the count of several ticks, see SleepSettings::repeatCoalesce
+class RepeatCoalescer {
+    public:
+        RepeatCoalescer() : pending(0), held(false), since(0) {}
+
+        // adds a tick at now (ms), returns the number of ticks to send now
+        // or 0 to hold them back
+        byte tick(unsigned long now, const SleepSettings &sleep) {
+            if (!pending)
+                since = now;
+            if (pending < 0xFF)
+                pending++;
+            // the first tick tells the receiver the electrode is held
+            if (!held || pending >= sleep.repeatCoalesce ||
+                now - since >= sleep.repeatMs) {
+                held = true;
+                return take();
+            }
+            return 0;
+        }
+
+        // ends the hold, returns the ticks not sent yet
+        byte flush() {
+            held = false;
+            return take();
+        }
+
+    protected:
+        byte take() {
+            byte n = pending;
+            pending = 0;
+            return n;
+        }
+
+        byte pending;
+        bool held;
+        unsigned long since;
+};
+
+#endif // REPEATCOALESCER_H
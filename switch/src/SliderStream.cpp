@@ -0,0 +1,78 @@
+#include "SliderStream.h"
+
+SliderStream::SliderStream() : smoothed(0), last(0), changed(false)
+{
+    begin(0, 0);
+}
+
+void
+SliderStream::begin(byte gang, byte period)
+{
+    packet.gang = gang;
+    packet.period = period;
+    packet.sequence = 0;
+    packet.flags = 0;
+    packet.samples = 0;
+    packet.len = sizeof(packet) - SLIDER_MAX_DELTAS;
+    changed = false;
+}
+
+byte
+SliderStream::smooth(byte position, byte shift)
+{
+    unsigned int target = (unsigned int)position << 4;
+    // the first position of a slide is taken as is
+    if (!packet.sequence && !packet.samples)
+        smoothed = target;
+    else if (target > smoothed)
+        smoothed += (target - smoothed) >> shift;
+    else
+        smoothed -= (smoothed - target) >> shift;
+    return (smoothed + 8) >> 4;
+}
+
+void
+SliderStream::next()
+{
+    packet.sequence++;
+    packet.flags = 0;
+    packet.samples = 0;
+    packet.len = sizeof(packet) - SLIDER_MAX_DELTAS;
+    changed = false;
+}
+
+bool
+SliderStream::add(byte position, byte deadband)
+{
+    if (packet.samples > SLIDER_MAX_DELTAS)
+        return false;
+
+    byte previous = last;
+    if (!packet.sequence && !packet.samples) {
+        // the start of the slide
+        last = position;
+    }
+    else {
+        int diff = (int)position - last;
+        if (diff <= deadband && diff >= -deadband)
+            diff = 0;
+        // the first position of a packet is absolute, a jump too large for
+        // a delta is reported over several samples
+        else if (packet.samples && diff > 127)
+            diff = 127;
+        else if (packet.samples && diff < -127)
+            diff = -127;
+        if (diff)
+            changed = true;
+        last += diff;
+    }
+
+    if (!packet.samples)
+        packet.position = last;
+    else {
+        packet.delta[packet.samples - 1] = (int)last - previous;
+        packet.len++;
+    }
+    packet.samples++;
+    return true;
+}
@@ -0,0 +1,51 @@
+#ifndef SLIDERSTREAM_H
+#define SLIDERSTREAM_H
+
+#if ARDUINO >= 100
+  #include <Arduino.h> // Arduino 1.0
+#else
+  #include <WProgram.h> // Arduino 0022
+#endif
+
+#include "SwitchProtocol.h"
+
+// delta encodes the slider positions of a slide into SLIDER_DATA packets,
+// see SwitchSliderData for the format
+class SliderStream {
+    public:
+        SliderStream();
+
+        // starts a new slide, period is the period_t between samples
+        void begin(byte gang, byte period);
+        // starts the next packet of the slide
+        void next();
+        // appends a position, changes of up to deadband from the last
+        // reported position are reported as no change
+        // returns false if the packet has no room left for it, send the
+        // packet and next() before adding it again
+        bool add(byte position, byte deadband);
+        // low pass filters the positions of a slide, each sample moves the
+        // result 1 / 2^shift of the way to the new position
+        byte smooth(byte position, byte shift);
+        // marks the packet as the last of the slide
+        void end() { packet.flags |= SLIDER_END; }
+
+        // returns true if the packet tells the receiver something new: the
+        // start or end of the slide or a change of position
+        bool hasNews() { return changed || !packet.sequence ||
+                                (packet.flags & SLIDER_END); }
+        bool isEmpty() { return !packet.samples; }
+
+        // the packet to send, packet.len is kept up to date
+        SwitchSliderData packet;
+
+    protected:
+        // smooth() state, position << 4
+        unsigned int smoothed;
+        // last reported position
+        byte last;
+        // a position in the packet differs from the one reported before
+        bool changed;
+};
+
+#endif // SLIDERSTREAM_H
@@ -0,0 +1,54 @@
+#ifndef STATUSSCHEDULE_H
+#define STATUSSCHEDULE_H
+
+#if ARDUINO >= 100
+  #include <Arduino.h> // Arduino 1.0
+#else
+  #include <WProgram.h> // Arduino 0022
+#endif
+
+#include "SwitchSettings.h"
+
+// keeps the time the next status is due.  The RFM12B wakeup timer sends it
+// on its own, a status due soon rides along with a touch event instead,
+// see SleepSettings::statusPiggyback
+class StatusSchedule {
+    public:
+        StatusSchedule() : dueAt(0) {}
+
+        // a status was sent at now (ms), the next one is due an interval
+        // later
+        void sent(unsigned long now, const SleepSettings &sleep) {
+            dueAt = now + getPeriod(sleep);
+        }
+
+        // true if the status is due within the piggyback window
+        bool isDue(unsigned long now, const SleepSettings &sleep) {
+            if (!sleep.statusPiggyback)
+                return false;
+            unsigned long window =
+                (unsigned long)sleep.statusPiggyback << sleep.statusScaler;
+            return (long)(dueAt - now) <= (long)window;
+        }
+
+        // the wakeup timer interval to the due time, in 2^statusScaler ms,
+        // rounded up and at most statusInterval
+        byte getInterval(unsigned long now, const SleepSettings &sleep) {
+            long left = dueAt - now;
+            if (left <= 0)
+                return 1;
+            unsigned long n = ((unsigned long)left +
+                               (1UL << sleep.statusScaler) - 1) >>
+                              sleep.statusScaler;
+            return n < sleep.statusInterval ? n : sleep.statusInterval;
+        }
+
+        static unsigned long getPeriod(const SleepSettings &sleep) {
+            return (unsigned long)sleep.statusInterval << sleep.statusScaler;
+        }
+
+    protected:
+        unsigned long dueAt;
+};
+
+#endif // STATUSSCHEDULE_H
@@ -0,0 +1,75 @@
+#include "ThresholdCalibration.h"
+
+// module id of the DEBUG() records, see DebugLog.h
+#define LOG_MODULE  2
+#include "debug.h"
+
+ThresholdCalibration::ThresholdCalibration(TouchSequence &touch) :
+    touch(touch), channels(0)
+{
+    reset();
+}
+
+void
+ThresholdCalibration::reset()
+{
+    samples = 0;
+    wakeups = 0;
+    memset(noise, 0, sizeof(noise));
+}
+
+void
+ThresholdCalibration::sample()
+{
+    unsigned int filtered[MPR121_CHANNELS];
+    byte baseline[MPR121_CHANNELS];
+    byte n = touch.readElectrodeData(filtered, baseline);
+    if (!n)
+        return;
+    if (n != channels) {
+        reset();
+        channels = n;
+    }
+
+    for (byte i = 0; i < n; ++i) {
+        // the baseline registers hold the upper 8 of 10 bits
+        int diff = ((int)baseline[i] << 2) - (int)filtered[i];
+        if (diff < 0)
+            diff = -diff;
+        if (diff > 0xFF)
+            diff = 0xFF;
+        if (diff > noise[i])
+            noise[i] = diff;
+    }
+    samples++;
+}
+
+bool
+ThresholdCalibration::update(const CalibrationSettings &settings)
+{
+    if (!samples || ++wakeups < settings.wakeups)
+        return false;
+
+    byte electrodes = channels - (touch.hasProximity() ? 1 : 0);
+    touch.beginBatch();
+    for (byte i = 0; i < channels; ++i) {
+        byte electrode = i < electrodes ? i : (byte)ELECTRODE_PROXIMITY;
+        byte lower = electrode == ELECTRODE_PROXIMITY ?
+            settings.proximityTouch : settings.minTouch;
+        unsigned int threshold = ((unsigned int)noise[i] * settings.margin +
+                                  3) / 4;
+        if (threshold > settings.maxTouch)
+            threshold = settings.maxTouch;
+        if (threshold < lower)
+            threshold = lower;
+        // release halfway back to the baseline
+        byte release = threshold > 1 ? threshold / 2 : 1;
+        DEBUG("calibrate: ", electrode, " noise: ", noise[i], " touch: ",
+              threshold);
+        touch.setTouchThreshold(threshold, electrode);
+        touch.setReleaseThreshold(release, electrode);
+    }
+    bool success = touch.commitBatch();
+    reset();
+    return success;
+}
@@ -0,0 +1,37 @@
+#ifndef THRESHOLDCALIBRATION_H
+#define THRESHOLDCALIBRATION_H
+
+#include "TouchSequence.h"
+#include "SwitchSettings.h"
+
+// Derives the touch/release thresholds from the electrode noise measured
+// while nothing is touched.  The noise of a channel is the largest
+// difference between its filtered data and baseline seen since the last
+// threshold update.
+class ThresholdCalibration {
+    public:
+        ThresholdCalibration(TouchSequence &touch);
+
+        // samples the electrode noise, only call while nothing is touched
+        void sample();
+        // call once per idle wakeup, after its samples.  Every
+        // settings.wakeups calls the thresholds are recomputed and written
+        // in a single batch.  Returns true if the thresholds were updated.
+        bool update(const CalibrationSettings &settings);
+        // discards the samples taken since the last update
+        void reset();
+
+        // noise of a channel in 10 bit counts, channels are in
+        // TouchSequence::readElectrodeData() order
+        byte getNoise(byte channel) { return noise[channel]; }
+        byte getChannels() { return channels; }
+
+    protected:
+        TouchSequence &touch;
+        byte channels;
+        byte samples;
+        byte wakeups;
+        byte noise[MPR121_CHANNELS];
+};
+
+#endif // THRESHOLDCALIBRATION_H
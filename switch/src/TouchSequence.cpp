@@ -2,6 +2,9 @@
 #include <Wire.h>
 #include "MPR121_registers.h"
 #include "MPR121_conf.h"
+
+// module id of the DEBUG() records, see DebugLog.h
+#define LOG_MODULE  1
 #include "debug.h"
 
 // make sure that the MPR121 is stopped when configuring registers
@@ -29,27 +32,53 @@ struct MPR121ConfigLock {
     TouchSequence *inst;
 };
 
-// Interrupt handlers
-static volatile bool interrupted = false;
-static void wakeUpInt0() {
-    detachInterrupt(0);
-    interrupted = true;
-}
-
-static void wakeUpInt1() {
-    detachInterrupt(1);
-    interrupted = true;
+static byte bitCount(unsigned int bits) {
+    byte n = 0;
+    for (; bits; bits &= bits - 1)
+        ++n;
+    return n;
 }
 
 // ===============
 //  TouchSequence
 // ===============
 
+TouchSequence *TouchSequence::instances[MAX_TOUCH_SENSORS];
+DutyCounter TouchSequence::i2cTime;
+
+// Interrupt handlers
+void
+TouchSequence::interrupt(byte pin)
+{
+    detachInterrupt(pin);
+    for (byte i = 0; i < MAX_TOUCH_SENSORS; ++i) {
+        if (instances[i] && instances[i]->interruptPin == pin)
+            instances[i]->interrupted = true;
+    }
+}
+
+void
+TouchSequence::wakeUpInt0()
+{
+    interrupt(0);
+}
+
+void
+TouchSequence::wakeUpInt1()
+{
+    interrupt(1);
+}
+
 TouchSequence::TouchSequence(byte mpr121Addr, byte interruptPin) :
-    interruptPin(interruptPin), idx(0),
-    proximityEvent(false), running(true)
+    interruptPin(interruptPin), interrupted(false), chordMs(0), swipeMs(0),
+    proximityEvent(false), gestures(GESTURE_ALL), doubleTapElectrodes(0xFFF),
+    gestureTable(NULL), running(true), batchDepth(0),
+    syncAutoConfig(false)
 {
+    memset(shadow, 0, sizeof(shadow));
+    memset(dirty, 0, sizeof(dirty));
     mpr121.address    = mpr121Addr;
+    mpr121.touched.all = 0;
     electrodes.top    = ELECTRODE_TOP;
     electrodes.left   = ELECTRODE_LEFT;
     electrodes.bottom = ELECTRODE_BOTTOM;
@@ -57,16 +86,58 @@ TouchSequence::TouchSequence(byte mpr121Addr, byte interruptPin) :
     electrodes.center = ELECTRODE_CENTER;
 }
 
+TouchSequence::~TouchSequence()
+{
+    for (byte i = 0; i < MAX_TOUCH_SENSORS; ++i) {
+        if (instances[i] == this)
+            instances[i] = NULL;
+    }
+}
+
 void
-TouchSequence::begin(MPR121Settings &defaultSettings)
+TouchSequence::attach()
 {
+    // receive the interrupts of our pin
+    byte free = MAX_TOUCH_SENSORS;
+    for (byte i = 0; i < MAX_TOUCH_SENSORS; ++i) {
+        if (instances[i] == this)
+            free = i;
+        else if (!instances[i] && free == MAX_TOUCH_SENSORS)
+            free = i;
+    }
+    if (free < MAX_TOUCH_SENSORS)
+        instances[free] = this;
+    else
+        DEBUG("begin: too many touch sensors");
+
     DEBUG("starting Wire library");
     Wire.begin();
+#if defined(MPR121_FAST_MODE)
+    // the MPR121 supports 400kHz fast mode i2c
+#if defined(TWBR)
+    TWBR = ((F_CPU / 400000L) - 16) / 2;
+#else
+    Wire.setClock(400000L);
+#endif
+#endif
+
+    // load the shadow registers, only settings that differ from what the
+    // MPR121 already holds are written
+    readRegisters(MPR121_SHADOW_FIRST, shadow, MPR121_SHADOW_SIZE);
+    mpr121.ecr = shadow[ECR - MPR121_SHADOW_FIRST];
+    running = mpr121.ecr & 0x3F;
+}
 
+void
+TouchSequence::begin(MPR121Settings &defaultSettings)
+{
+    attach();
     stop();
+    beginBatch();
     applySettings(defaultSettings);
     setTouchThreshold(defaultSettings.touch);
     setReleaseThreshold(defaultSettings.release);
+    commitBatch();
 
     // start in run mode
     run();
@@ -76,62 +147,365 @@ TouchSequence::begin(MPR121Settings &defaultSettings)
     setRegister(ACCR0, 0);
 }
 
+bool
+TouchSequence::resume()
+{
+    attach();
+    DEBUG("resume: ", running ? "running" : "stopped");
+    if (!running)
+        return false;
+    clear();
+    return true;
+}
+
+void
+TouchSequence::configure(MPR121Settings &settings)
+{
+    DEBUG("configure:");
+    byte ecr = mpr121.ecr;
+    // begin() turned auto-configuration off once it ran
+    MPR121Settings s = settings;
+    s.accr0 = 0;
+    beginBatch();
+    applySettings(s);
+    for (byte e = 0; e < ELECTRODE_PROXIMITY; ++e) {
+        setTouchThreshold(s.touch, e);
+        setReleaseThreshold(s.release, e);
+    }
+    commitBatch();
+    // the electrodes in use are set in ECR, written on run
+    if (running && mpr121.ecr != ecr)
+        setRegister(ECR, mpr121.ecr);
+}
+
 void
 TouchSequence::dump()
 {
+#if !defined(NDEBUG)
     DEBUG("Registers: ");
-    for (int i = 0; i < 0x7F; ++i) {
-        if (i % 8 == 0)
-            DEBUG_(i, ": ");
-        DEBUG_FMT_(getRegister(i), HEX);
-        if (i % 8 == 7)
-            DEBUG("");
-        else
+    byte row[8];
+    for (int i = 0; i < 0x7F; i += sizeof(row)) {
+        byte n = getRegisters(i, row, min(0x7F - i, (int)sizeof(row)));
+        DEBUG_(i, ": ");
+        for (byte j = 0; j < n; ++j) {
+            DEBUG_FMT_(row[j], HEX);
             DEBUG_(" ");
+        }
+        DEBUG("");
     }
     DEBUG("");
+#endif
+}
+
+byte
+TouchSequence::readElectrodeData(unsigned int *filtered, byte *baseline)
+{
+    byte electrodes = min(mpr121.ele_en, 12);
+    bool prox = mpr121.eleprox_en != 0;
+    if (!electrodes && !prox)
+        return 0;
+
+    // the electrode data and the baselines (with the proximity data right
+    // in front of them) are two runs of registers, the unused electrode data
+    // in between is only read when it costs less than a second transaction
+    byte data[EPROXBV - ELE0_LSB + 1];
+    byte dataEnd = ELE0_LSB + (electrodes << 1);
+    byte tail = prox ? ELEPROX_LSB : E0BV;
+    byte last = prox ? EPROXBV : E0BV + electrodes - 1;
+    if (tail - dataEnd <= 3)
+        dataEnd = tail;
+    byte n = dataEnd - ELE0_LSB;
+    if (n && getRegisters(ELE0_LSB, data, n) != n)
+        return 0;
+    n = last - tail + 1;
+    if (getRegisters(tail, data + tail - ELE0_LSB, n) != n)
+        return 0;
+
+    byte channels = 0;
+    for (byte i = 0; i < 13; ++i) {
+        if (i == ELECTRODE_PROXIMITY ? !prox : i >= electrodes)
+            continue;
+        byte *lsb = data + (i << 1);
+        filtered[channels] = lsb[0] | ((lsb[1] & 0x03) << 8);
+        baseline[channels] = data[E0BV - ELE0_LSB + i];
+        channels++;
+    }
+    return channels;
+}
+
+bool
+TouchSequence::hasProximity()
+{
+    return mpr121.eleprox_en != 0;
+}
+
+bool
+TouchSequence::isOnSlider()
+{
+    unsigned int slider = (1 << electrodes.bottom) |
+        (1 << electrodes.center) | (1 << electrodes.top);
+    unsigned int touched = mpr121.touched.all & TOUCH_ELECTRODES;
+    return touched && !(touched & ~slider);
+}
+
+int
+TouchSequence::getSliderPosition(byte minSignal)
+{
+    // bottom to top
+    byte slider[3] = { electrodes.bottom, electrodes.center, electrodes.top };
+    byte lo = min(min(slider[0], slider[1]), slider[2]);
+    byte hi = max(max(slider[0], slider[1]), slider[2]);
+    if (hi >= min(mpr121.ele_en, 12))
+        return -1;
+
+    // the data and baselines of the electrodes from lo to hi
+    byte data[24];
+    byte baseline[12];
+    byte n = hi - lo + 1;
+    if (getRegisters(ELE0_LSB + (lo << 1), data, n << 1) != n << 1 ||
+        getRegisters(E0BV + lo, baseline, n) != n)
+        return -1;
+
+    int diff[3];
+    byte peak = 0;
+    for (byte i = 0; i < 3; ++i) {
+        byte e = slider[i] - lo;
+        int filtered = data[e << 1] | ((data[(e << 1) + 1] & 0x03) << 8);
+        diff[i] = ((int)baseline[e] << 2) - filtered;
+        if (diff[i] < 0)
+            diff[i] = 0;
+        if (diff[i] > diff[peak])
+            peak = i;
+    }
+
+    // interpolate between the peak and its stronger neighbour, the far
+    // electrode only adds noise
+    byte other = peak == 1 ? (diff[0] > diff[2] ? 0 : 2) : 1;
+    unsigned int signal = diff[peak] + diff[other];
+    if (!signal || signal < minSignal)
+        return -1;
+    // 0, 127 and 255 at the electrodes
+    unsigned long weighted = (unsigned long)diff[peak] * (peak * 255 / 2) +
+        (unsigned long)diff[other] * (other * 255 / 2);
+    return weighted / signal;
+}
+
+void
+TouchSequence::beginBatch()
+{
+    batchDepth++;
+}
+
+bool
+TouchSequence::commitBatch()
+{
+    if (batchDepth && --batchDepth)
+        return true;
+    // nothing changed, don't disturb the measurements with a stop/run cycle
+    byte changed = syncAutoConfig;
+    for (byte i = 0; i < sizeof(dirty); ++i)
+        changed |= dirty[i];
+    if (!changed)
+        return true;
+    MPR121ConfigLock lock(this);
+    return flush();
+}
+
+bool
+TouchSequence::isCached(byte reg)
+{
+    if (reg < MPR121_SHADOW_FIRST || reg > ACTL)
+        return false;
+    // GPIO data and set/clear/toggle registers act on every write
+    if (reg == GPIODAT || (reg >= GPIOSET && reg <= GPIOTOG))
+        return false;
+    // charge current/time belong to the MPR121 while auto-config is enabled
+    if (reg >= CDC0 && reg <= CDTPROX &&
+            (shadow[ACCR0 - MPR121_SHADOW_FIRST] & 0x01))
+        return false;
+    return true;
+}
+
+bool
+TouchSequence::flush()
+{
+    bool success = true;
+    byte i = 0;
+    while (i < MPR121_SHADOW_SIZE) {
+        if (!(dirty[i >> 3] & (1 << (i & 7)))) {
+            ++i;
+            continue;
+        }
+        // extend the burst over the following dirty registers, bridging
+        // short gaps of unchanged ones which are cheaper to rewrite than to
+        // start a new transaction for
+        byte last = i;
+        for (byte j = i + 1; j < MPR121_SHADOW_SIZE &&
+                j - i < BUFFER_LENGTH - 1 && j - last <= 2; ++j) {
+            byte reg = MPR121_SHADOW_FIRST + j;
+            if (dirty[j >> 3] & (1 << (j & 7)))
+                last = j;
+            else if (!isCached(reg) || reg == ECR)
+                break;
+        }
+        // a failed burst stays dirty, the next commit writes it again
+        if (writeRegisters(MPR121_SHADOW_FIRST + i, shadow + i,
+                           last - i + 1)) {
+            for (; i <= last; ++i)
+                dirty[i >> 3] &= ~(1 << (i & 7));
+        }
+        else {
+            success = false;
+            i = last + 1;
+        }
+    }
+
+    if (syncAutoConfig) {
+        // auto-config wrote its results on the last transition to run mode
+        readRegisters(CDC0, shadow + CDC0 - MPR121_SHADOW_FIRST,
+                      CDTPROX - CDC0 + 1);
+        syncAutoConfig = false;
+    }
+    return success;
 }
 
 bool
 TouchSequence::setRegister(byte reg, byte val)
 {
-    MPR121ConfigLock lock(this, reg != ECR && (reg < 0x72 || reg > 0x7A));
+    if (!isCached(reg) || reg == ECR)
+        return writeRegister(reg, val);
+
+    byte i = reg - MPR121_SHADOW_FIRST;
+    if (shadow[i] == val)
+        return true;
 
 #if defined(DEBUG_REGISTERS)
     DEBUG_("setRegister: 0x");
     DEBUG_FMT_(reg, HEX);
+    DEBUG_(" : 0x");
+    DEBUG_FMT(val, HEX);
 #endif
 
+    if (reg == ACCR0 && (shadow[i] & 0x01) && !(val & 0x01))
+        syncAutoConfig = true;
+    shadow[i] = val;
+    dirty[i >> 3] |= 1 << (i & 7);
+
+    if (batchDepth)
+        return true;
+    MPR121ConfigLock lock(this);
+    return flush();
+}
+
+bool
+TouchSequence::writeRegister(byte reg, byte val)
+{
+    MPR121ConfigLock lock(this, reg != ECR && (reg < GPIOCR0 || reg > GPIOTOG));
+
+#if defined(DEBUG_REGISTERS)
+    DEBUG_("writeRegister: 0x");
+    DEBUG_FMT_(reg, HEX);
+#endif
+
+    i2cTime.start();
     Wire.beginTransmission(mpr121.address);
     Wire.write(reg);
     Wire.write(val);
     byte errorCode = Wire.endTransmission();
+    i2cTime.stop();
 
 #if defined(DEBUG_REGISTERS)
     DEBUG_(" : 0x");
     DEBUG_FMT(val, HEX);
 #endif
 
+    if (errorCode == 0 && reg >= MPR121_SHADOW_FIRST && reg <= ACTL)
+        shadow[reg - MPR121_SHADOW_FIRST] = val;
+
     // automatically update the running flag if ECR is set
     if (errorCode == 0 && reg == ECR) {
         running = val & 0x3F;
 #if defined(DEBUG_REGISTERS)
-        DEBUG("setRegister: ", running ? "running" : "not running");
+        DEBUG("writeRegister: ", running ? "running" : "not running");
 #endif
     }
 
     return errorCode == 0;
 }
 
+bool
+TouchSequence::writeRegisters(byte reg, const byte *buf, byte n)
+{
+    byte count = 0;
+    bool success = true;
+    i2cTime.start();
+    while (count < n) {
+        // the register address shares the Wire buffer with the data
+        byte len = min(n - count, BUFFER_LENGTH - 1);
+        Wire.beginTransmission(mpr121.address);
+        Wire.write(reg + count);
+        Wire.write(buf + count, len);
+        if (Wire.endTransmission() != 0) {
+            success = false;
+            break;
+        }
+        count += len;
+    }
+    i2cTime.stop();
+    return success;
+}
+
 byte
 TouchSequence::getRegister(byte reg)
 {
-    Wire.beginTransmission(mpr121.address);
-    Wire.write(reg);
-    Wire.endTransmission(false);
-    Wire.requestFrom(mpr121.address, (byte)1);
-    Wire.endTransmission();
-    return Wire.read();
+    byte val = 0;
+    getRegisters(reg, &val, 1);
+    return val;
+}
+
+byte
+TouchSequence::getRegisters(byte reg, byte *buf, byte n)
+{
+    byte count = 0;
+    while (count < n) {
+        byte r = reg + count;
+        if (isCached(r)) {
+            buf[count++] = shadow[r - MPR121_SHADOW_FIRST];
+            continue;
+        }
+        // read the run of uncached registers from the MPR121
+        byte len = 1;
+        while (count + len < n && !isCached(r + len))
+            ++len;
+        byte received = readRegisters(r, buf + count, len);
+        count += received;
+        if (received < len)
+            break;
+    }
+    return count;
+}
+
+byte
+TouchSequence::readRegisters(byte reg, byte *buf, byte n)
+{
+    byte count = 0;
+    i2cTime.start();
+    while (count < n) {
+        // the Wire library buffers at most BUFFER_LENGTH bytes per request
+        byte len = min(n - count, BUFFER_LENGTH);
+        Wire.beginTransmission(mpr121.address);
+        Wire.write(reg + count);
+        // repeated start, the register pointer auto-increments on reads
+        if (Wire.endTransmission(false) != 0)
+            break;
+        byte received = Wire.requestFrom(mpr121.address, len);
+        for (byte i = 0; i < received && Wire.available(); ++i)
+            buf[count++] = Wire.read();
+        if (received < len)
+            break;
+    }
+    i2cTime.stop();
+    return count;
 }
 
 void
@@ -148,32 +522,34 @@ TouchSequence::applyFilter(byte baseReg, struct MPR121Filter &filter)
 void
 TouchSequence::setTouchThreshold(byte val, byte ele)
 {
-    MPR121ConfigLock lock(this);
+    beginBatch();
     if (ele < 13)
         setRegister(E0TTH + (ele << 1), val);
     else {
         for (int i = 0; i < 13; ++i)
             setRegister(E0TTH + (i << 1), val);
     }
+    commitBatch();
 }
 
 void
 TouchSequence::setReleaseThreshold(byte val, byte ele)
 {
-    MPR121ConfigLock lock(this);
+    beginBatch();
     if (ele < 13)
         setRegister(E0RTH + (ele << 1), val);
     else {
         for (int i = 0; i < 13; ++i)
             setRegister(E0RTH + (i << 1), val);
     }
+    commitBatch();
 }
 
 void
 TouchSequence::applySettings(MPR121Settings &settings)
 {
     DEBUG("applySettings:");
-    MPR121ConfigLock lock(this);
+    beginBatch();
 
     mpr121.ele_en = settings.electrodes & 0x0F;
     mpr121.eleprox_en = settings.proximityMode & 0x03;
@@ -194,6 +570,7 @@ TouchSequence::applySettings(MPR121Settings &settings)
     setRegister(ACUSL, settings.usl);
     setRegister(ACLSL, settings.lsl);
     setRegister(ACTL, settings.tl);
+    commitBatch();
 }
 
 void
@@ -209,6 +586,27 @@ TouchSequence::setElectrodes(byte total, struct Electrodes &electrodes)
     this->electrodes.center = electrodes.center;
 }
 
+void
+TouchSequence::setGestures(unsigned int gestures,
+        unsigned int doubleTapElectrodes)
+{
+    this->gestures = gestures;
+    this->doubleTapElectrodes = doubleTapElectrodes;
+}
+
+void
+TouchSequence::setTiming(byte chordMs, unsigned int swipeMs)
+{
+    this->chordMs = chordMs;
+    this->swipeMs = swipeMs;
+}
+
+void
+TouchSequence::setGestureTable(const byte *table)
+{
+    gestureTable = table;
+}
+
 void
 TouchSequence::stop()
 {
@@ -237,145 +635,227 @@ TouchSequence::run()
 
 bool
 TouchSequence::update()
+{
+    return update(millis());
+}
+
+bool
+TouchSequence::update(unsigned long now)
 {
     DEBUG("update:");
     int prevTouchedState = mpr121.touched.all;
 
     // clears the interrupt
     interrupted = false;
-    mpr121.touched.status[0] = getRegister(ELE0_7);
-    mpr121.touched.status[1] = getRegister(ELE8_PROX);
+    readRegisters(ELE0_7, mpr121.touched.status, 2);
 
     // test to see if there was a change
     if (!(prevTouchedState ^ mpr121.touched.all))
         return isTouched();
-
-    for (byte i = 0; i < mpr121.ele_en; ++i) {
-        if (isTouched(i)) {
-            if (prevTouchedState & (1 << i))
-                DEBUG("repeat: ", i);
-            else {
-                DEBUG("touch: ", i);
-                seq[idx++] = i;
-                if (idx >= MAX_TOUCH_SEQ)
-                    idx = MAX_TOUCH_SEQ;
+    record(now);
+
+    unsigned int mask = (1 << min(mpr121.ele_en, 12)) - 1;
+    unsigned int held = mpr121.touched.all & mask;
+    unsigned int pressed = held & ~prevTouchedState;
+    for (byte i = 0; i < 12; ++i) {
+        if (pressed & (1 << i)) {
+            DEBUG("touch: ", i);
+            if (!touches) {
+                first = i;
+                firstTouch = now;
             }
+            last = i;
+            lastTouch = now;
+            if (touches < 0xFF)
+                touches++;
         }
+        else if (held & (1 << i))
+            DEBUG("repeat: ", i);
         else if (prevTouchedState & (1 << i))
             DEBUG("release: ", i);
     }
 
-    if (mpr121.touched.eleprox && seq[0] == 0xFF) {
+    if (pressed) {
+        // nothing else was held, a new group of touches starts
+        if (held == pressed)
+            groupStart = now;
+        // only the group that starts the sequence can be a chord
+        if (chordMs && groupStart == firstTouch &&
+                now - groupStart <= chordMs &&
+                bitCount(held) > 1 && bitCount(held) > bitCount(chord)) {
+            chord = held;
+            chordStart = now;
+        }
+    }
+    // a finger sliding across electrodes overlaps them only briefly
+    if (chord && (held & chord) != chord && now - chordStart < 4 * chordMs)
+        chord = 0;
+
+    if (mpr121.touched.eleprox && !touches) {
         proximityEvent = true;
         DEBUG("proximity:");
     }
-    else if (seq[0] != 0xFF)
+    else if (touches)
         proximityEvent = false;
 
     return isTouched();
 }
 
 void
-TouchSequence::clear()
+TouchSequence::record(unsigned long now)
 {
-    DEBUG("clear:");
-    for (int i = 0; i < MAX_TOUCH_SEQ; ++i)
-        seq[i] = 0xFF;
-    idx = 0;
-    mpr121.touched.all = 0;
-    proximityEvent = false;
+    TouchEntry &entry = history[head];
+    unsigned long ms = entries ? now - lastChange : 0;
+    entry.electrodes = mpr121.touched.all & (TOUCH_ELECTRODES | 0x1000);
+    entry.ms = ms > 0xFFFF ? 0xFFFF : ms;
+    lastChange = now;
+    head = (head + 1) % TOUCH_HISTORY;
+    if (entries < TOUCH_HISTORY)
+        entries++;
 }
 
-TouchGesture
-TouchSequence::checkLongSwipe()
+byte
+TouchSequence::getHistory(TouchEntry *buf, byte n)
 {
-    if (idx <= 1)
-        return TOUCH_UNKNOWN;
-
-    if (seq[0] == electrodes.top &&
-        seq[idx - 1] == electrodes.bottom)
-        return TOUCH_SWIPE_DOWN;
-
-    if (seq[0] == electrodes.bottom &&
-        seq[idx - 1] == electrodes.top)
-        return TOUCH_SWIPE_UP;
-
-    if (seq[0] == electrodes.left &&
-        seq[idx - 1] == electrodes.right)
-        return TOUCH_SWIPE_RIGHT;
-
-    if (seq[0] == electrodes.right &&
-        seq[idx - 1] == electrodes.left)
-        return TOUCH_SWIPE_LEFT;
-
-    return TOUCH_UNKNOWN;
+    if (n > entries)
+        n = entries;
+    byte start = (head + TOUCH_HISTORY - n) % TOUCH_HISTORY;
+    for (byte i = 0; i < n; ++i)
+        buf[i] = history[(start + i) % TOUCH_HISTORY];
+    return n;
 }
 
-TouchGesture
-TouchSequence::checkShortSwipe()
+byte
+TouchSequence::getTouchSpan(unsigned long &ms)
 {
-    // short swipes start from the center towards one other direction
-    if (idx != 2)
-        return TOUCH_UNKNOWN;
-
-    if (seq[0] == electrodes.center &&
-        seq[1] == electrodes.bottom)
-        return TOUCH_SWIPE_DOWN;
-
-    if (seq[0] == electrodes.center &&
-        seq[1] == electrodes.top)
-        return TOUCH_SWIPE_UP;
-
-    if (seq[0] == electrodes.center &&
-        seq[1] == electrodes.right)
-        return TOUCH_SWIPE_RIGHT;
+    // a full ring lost the entry before its oldest, whose electrodes then
+    // count as held
+    byte start = (head + TOUCH_HISTORY - entries) % TOUCH_HISTORY;
+    byte i = 0;
+    unsigned int prev = 0;
+    if (entries == TOUCH_HISTORY)
+        prev = history[start + i++].electrodes;
+    byte touches = 0;
+    unsigned long elapsed = 0;
+    ms = 0;
+    for (; i < entries; ++i) {
+        const TouchEntry &entry = history[(start + i) % TOUCH_HISTORY];
+        elapsed += entry.ms;
+        unsigned int pressed = entry.electrodes & TOUCH_ELECTRODES & ~prev;
+        prev = entry.electrodes;
+        if (!pressed)
+            continue;
+        if (!touches)
+            elapsed = 0;
+        ms = elapsed;
+        touches += bitCount(pressed);
+    }
+    return touches;
+}
 
-    if (seq[0] == electrodes.center &&
-        seq[1] == electrodes.left)
-        return TOUCH_SWIPE_LEFT;
+void
+TouchSequence::clear()
+{
+    DEBUG("clear:");
+    touches = 0;
+    first = last = 0xFF;
+    chord = 0;
+    entries = 0;
+    mpr121.touched.all = 0;
+    proximityEvent = false;
+}
 
-    return TOUCH_UNKNOWN;
+byte
+TouchSequence::getRole(byte electrode)
+{
+    if (electrode == electrodes.top)
+        return ROLE_TOP;
+    if (electrode == electrodes.left)
+        return ROLE_LEFT;
+    if (electrode == electrodes.bottom)
+        return ROLE_BOTTOM;
+    if (electrode == electrodes.right)
+        return ROLE_RIGHT;
+    if (electrode == electrodes.center)
+        return ROLE_CENTER;
+    return ROLE_OTHER;
 }
 
 TouchGesture
-TouchSequence::checkTap()
+TouchSequence::lookup(byte key)
 {
-    // must have at least one valid touch entry
-    if (seq[0] == 0xFF)
-        return TOUCH_UNKNOWN;
-
-    if (idx == 1)
-        return TOUCH_TAP;
-
-    if (seq[0] == seq[1] && idx == 2)
-        return TOUCH_DOUBLE_TAP;
-
-    return TOUCH_UNKNOWN;
+    byte pair = gestureTable ? gestureTable[key >> 1] :
+        pgm_read_byte(defaultGestureTable + (key >> 1));
+    return (TouchGesture)(key & 1 ? pair >> 4 : pair & 0x0F);
 }
 
 TouchGesture
 TouchSequence::getGesture()
 {
-    DEBUG_("gesture: ");
-    for (int i = 0; i < MAX_TOUCH_SEQ; ++i) {
-        DEBUG_(seq[i], ' ');
+    DEBUG("gesture: ", touches, " ", first, " -> ", last, " chord ", chord);
+
+    if (touches == 0)
+        return proximityEvent ? TOUCH_PROXIMITY : TOUCH_UNKNOWN;
+    if (chord)
+        return TOUCH_CHORD;
+
+    TouchGesture gesture = lookup(gestureKey(touches, getRole(first),
+                                             getRole(last)));
+    // too slow for a swipe, a finger brushing past or separate taps, either
+    // is not reported.  The recent touches decide, the history holds the
+    // end of a long sequence.
+    if (swipeMs && touches > 1 &&
+            gesture >= TOUCH_SWIPE_UP && gesture <= TOUCH_SWIPE_RIGHT) {
+        unsigned long ms;
+        byte recent = getTouchSpan(ms);
+        if (recent > 1 && ms > (unsigned long)swipeMs * (recent - 1))
+            return TOUCH_UNKNOWN;
     }
-    DEBUG("");
-
-    TouchGesture gesture;
-    if ((gesture = checkShortSwipe()) != TOUCH_UNKNOWN)
-        return gesture;
-
-    if ((gesture = checkLongSwipe()) != TOUCH_UNKNOWN)
-        return gesture;
-
-    if ((gesture = checkTap()) != TOUCH_UNKNOWN)
-        return gesture;
+    return gesture;
+}
 
-    if (seq[0] == 0xFF && proximityEvent)
-        return TOUCH_PROXIMITY;
+bool
+TouchSequence::isEnabled(TouchGesture gesture, byte electrode)
+{
+    if (gesture == TOUCH_UNKNOWN)
+        return false;
+    if (gesture == TOUCH_CHORD && !chordMs)
+        return false;
+    if (gesture == TOUCH_DOUBLE_TAP && !(doubleTapElectrodes & (1U << electrode)))
+        return false;
+    return gestures & GESTURE_BIT(gesture);
+}
 
-    return TOUCH_UNKNOWN;
+bool
+TouchSequence::isComplete()
+{
+    if (isTouched())
+        return false;
+
+    TouchGesture gesture = getGesture();
+    if (gesture == TOUCH_UNKNOWN)
+        return false;
+
+    // a proximity event may still be followed by any touch gesture
+    if (touches == 0)
+        return !(gestures & ~(GESTURE_BIT(TOUCH_PROXIMITY) |
+                              GESTURE_BIT(TOUCH_UNKNOWN) |
+                              GESTURE_BIT(TOUCH_CHORD))) &&
+            !isEnabled(TOUCH_CHORD, 0);
+    // a chord stays a chord
+    if (gesture == TOUCH_CHORD)
+        return true;
+
+    // look up every gesture that one or more further touches could lead to
+    byte role = getRole(first);
+    for (byte len = touches < 2 ? 2 : 3; len <= 3; ++len) {
+        for (byte next = 0; next < GESTURE_ROLES; ++next) {
+            TouchGesture g = lookup(gestureKey(len, role, next));
+            if (g != gesture && isEnabled(g, first))
+                return false;
+        }
+    }
+    return true;
 }
 
 void
@@ -397,7 +877,7 @@ TouchSequence::isInterrupted()
 bool
 TouchSequence::isTouched()
 {
-    return mpr121.touched.all & 0x1FF;
+    return mpr121.touched.all & TOUCH_ELECTRODES;
 }
 
 bool
@@ -415,7 +895,17 @@ TouchSequence::isProximity()
 byte
 TouchSequence::getLastTouch()
 {
-    if (idx)
-        return seq[idx - 1];
-    return seq[0];
+    return last;
+}
+
+unsigned int
+TouchSequence::getStatus()
+{
+    return mpr121.touched.all;
+}
+
+unsigned int
+TouchSequence::getChord()
+{
+    return chord;
 }
@@ -8,11 +8,28 @@
 #endif
 
 #include "SwitchSettings.h"
+#include "DutyCounter.h"
 
-#ifndef MAX_TOUCH_SEQ
-#define MAX_TOUCH_SEQ 4
+// number of touch state snapshots kept in the history ring, the speed of a
+// swipe is judged by the touches it holds
+#ifndef TOUCH_HISTORY
+#define TOUCH_HISTORY 8
 #endif
 
+// MPR121s driven by one MCU, at most one per address (0x5A - 0x5D)
+#ifndef MAX_TOUCH_SENSORS
+#define MAX_TOUCH_SENSORS 4
+#endif
+
+// touch status bits of the electrodes (ELE0 - ELE11)
+#define TOUCH_ELECTRODES    0x0FFF
+
+// configuration registers mirrored in RAM (MHDR - ACTL)
+#define MPR121_SHADOW_FIRST 0x2B
+#define MPR121_SHADOW_SIZE  (0x80 - MPR121_SHADOW_FIRST)
+// 12 electrodes + proximity
+#define MPR121_CHANNELS     13
+
 enum ElectrodeType {
     ELECTRODE_TOP,
     ELECTRODE_LEFT,
@@ -22,6 +39,12 @@ enum ElectrodeType {
     ELECTRODE_PROXIMITY = 12,
 };
 
+// the touched electrodes after a change, bit 12 is the proximity channel
+struct TouchEntry {
+    unsigned int electrodes;
+    unsigned int ms;            // since the previous entry, saturates
+};
+
 struct Electrodes {
     byte top;
     byte bottom;
@@ -36,10 +59,26 @@ class TouchSequence {
         //   mpr121Addr:   i2c address of the MPR121 IC
         //   interruptPin: external hardware interrupt.
         //                 NOTE: 0 for pin 2, 1 for pin 3
+        //                 Several MPR121s may share the pin, their IRQ
+        //                 outputs are open drain.  An interrupt on the pin
+        //                 marks every begin()'d instance using it as
+        //                 interrupted.
         TouchSequence(byte mpr121Addr, byte interruptPin);
+        ~TouchSequence();
 
         // Initialize the TouchSequence instance, MPR121
+        // the instance receives the interrupts of its pin from here on
         void begin(MPR121Settings &defaultSettings);
+        // takes over an MPR121 that a begin() before a soft reset left
+        // configured and running, without stopping it or writing any
+        // register.  Returns false if it is not running, begin() it then.
+        bool resume();
+        // applies changed settings to a begin()'d MPR121, writing only the
+        // registers that differ with a single stop/run cycle.  The touch
+        // and release thresholds of the electrodes are reset to the
+        // settings, those of proximity are left to the caller.  Auto-
+        // configuration stays off.
+        void configure(MPR121Settings &settings);
         // attaches the hardware interrupt
         // the interrupt will automatically be detached when it runs, so
         // enableInterrupt must be called again prior to going to sleep
@@ -49,18 +88,40 @@ class TouchSequence {
         //  electrodes: directional electrodes used for gestures
         void setElectrodes(byte total, Electrodes &electrodes);
 
+        // configure the gestures in use
+        //  gestures:            GESTURE_BIT() mask of enabled gestures
+        //  doubleTapElectrodes: bitmask of electrodes that use double tap
+        void setGestures(unsigned int gestures,
+                unsigned int doubleTapElectrodes);
+        // sets the gesture table used by getGesture(), defaultGestureTable
+        // in flash until then.  The table is not copied.
+        void setGestureTable(const byte *table);
+        // configure the gesture timing
+        //  chordMs: electrodes touched within chordMs of each other at the
+        //           start of a sequence and held together for at least
+        //           4 * chordMs form a TOUCH_CHORD, 0 disables chords
+        //  swipeMs: longest average time between the touches of a swipe
+        //           in the history, slower sequences are not a swipe and
+        //           not reported, 0 for no limit
+        void setTiming(byte chordMs, unsigned int swipeMs);
+
         // checks the sensors for any new inputs and adds them to the touch
         // sequence
         // returns true if an electrode is in touched state (including prox)
         // returns false if no electrodes are touched
         bool update();
+        // as above, now is the current time in ms for the touch history
+        // when millis() does not account for the time spent asleep
+        bool update(unsigned long now);
         // clears the current sequence
         // call this after you've handled a touch sequence and you want to
         // start over fresh
         void clear();
 
-        // returns true if MPR121 external interrupt is active
+        // returns true if the external interrupt of this MPR121 is active
         // returns false otherwise
+        // on a shared pin update() each interrupted instance, the line
+        // stays low until all of them read their touch status
         bool isInterrupted();
 
         // returns true if there is an ongoing touch event
@@ -76,12 +137,31 @@ class TouchSequence {
 
         // returns electrode number of last touched event
         byte getLastTouch();
+        // returns the touch status registers read by the last update(),
+        // ELE0_7 | ELE8_PROX << 8
+        unsigned int getStatus();
+        // returns the electrodes of the widest chord in the sequence
+        unsigned int getChord();
+        // copies up to n of the most recent history entries, oldest first,
+        // and returns the number copied
+        byte getHistory(TouchEntry *buf, byte n);
+        // returns the touches in the history and sets ms to the time from
+        // the first to the last of them
+        byte getTouchSpan(unsigned long &ms);
 
         // returns a gesture type
         // use getLastTouch() for TOUCH_TAP/TOUCH_DOUBLE_TAP to determine
         // which electrode was touched
         TouchGesture getGesture();
 
+        // returns true if nothing is touched and the current sequence can no
+        // longer turn into a different enabled gesture, so getGesture() may
+        // be reported without waiting for the sequence to time out
+        bool isComplete();
+        // returns true if the gesture is in use, gesture ids beyond
+        // TOUCH_PROXIMITY defined by the gesture table are always in use
+        bool isEnabled(TouchGesture gesture, byte electrode);
+
         // returns true if any of the electrodes/proximity sensors are on
         bool isRunning();
         // the default mode after calling begin()
@@ -99,28 +179,109 @@ class TouchSequence {
 
         // for debugging, prints out the registers of the MPR121
         void dump();
+        // reads the 10 bit filtered data and the baseline (upper 8 bits) of
+        // the enabled electrodes, the proximity channel last, in a single
+        // burst.  Returns the number of channels read (up to 13).
+        byte readElectrodeData(unsigned int *filtered, byte *baseline);
+        // returns true if the proximity channel is enabled
+        bool hasProximity();
+
+        // returns true if the touched electrodes are all on the slider, the
+        // vertical electrodes (bottom, center, top).  Proximity is ignored.
+        bool isOnSlider();
+        // returns the finger position along the slider interpolated from
+        // the filtered data of its electrodes, 0 at the bottom electrode to
+        // 255 at the top, or -1 if their summed signal (baseline - filtered)
+        // is below minSignal
+        int getSliderPosition(byte minSignal);
+
+        // starts a batch of register writes.  Writes to configuration
+        // registers are held in RAM until the matching commitBatch(), which
+        // stops the MPR121 once, writes the changed registers in
+        // auto-increment bursts and restores run mode.  Batches may nest.
+        void beginBatch();
+        // returns false if any of the i2c writes failed
+        bool commitBatch();
 
         // i2c set/get functions
+        // configuration registers are served from the RAM copy and writes
+        // that do not change a value are skipped
         bool setRegister(byte reg, byte val);
         byte getRegister(byte reg);
+        // reads n consecutive registers starting at reg into buf, returns
+        // the number of bytes read
+        byte getRegisters(byte reg, byte *buf, byte n);
+
+        // ms spent in i2c transactions by all instances since boot
+        static unsigned long getI2CMs() { return i2cTime.getMs(); }
 
     protected:
+        // receives the interrupts of the pin, starts the i2c bus and loads
+        // the shadow registers from the MPR121
+        void attach();
         void applySettings(struct MPR121Settings&);
         void applyFilter(byte baseReg, struct MPR121Filter&);
 
-        TouchGesture checkShortSwipe();
-        TouchGesture checkLongSwipe();
-        TouchGesture checkTap();
+        // returns true if reg is mirrored in the shadow registers
+        bool isCached(byte reg);
+        // writes the dirty shadow registers, MPR121 must be stopped.  The
+        // registers of a failed write stay dirty.
+        bool flush();
+        // direct i2c access, bypassing the shadow registers
+        bool writeRegister(byte reg, byte val);
+        bool writeRegisters(byte reg, const byte *buf, byte n);
+        byte readRegisters(byte reg, byte *buf, byte n);
+
+        // the gesture table role (ROLE_*) of an electrode
+        byte getRole(byte electrode);
+        TouchGesture lookup(byte key);
+        // adds the current touch status to the history
+        void record(unsigned long now);
+
+        // marks the instances on an interrupt pin as interrupted
+        static void interrupt(byte pin);
+        static void wakeUpInt0();
+        static void wakeUpInt1();
+        static TouchSequence *instances[MAX_TOUCH_SENSORS];
+        static DutyCounter i2cTime;
 
         byte interruptPin;
-        byte seq[MAX_TOUCH_SEQ];
-        byte idx;
+        volatile bool interrupted;
+        // the sequence: number of touches (saturates), the first and last
+        // electrode touched
+        byte touches;
+        byte first;
+        byte last;
+        // widest set of electrodes touched within chordMs of each other
+        unsigned int chord;
+        unsigned long chordStart;
+        // start of the current group of overlapping touches
+        unsigned long groupStart;
+        // first and last touch of the sequence
+        unsigned long firstTouch;
+        unsigned long lastTouch;
+        byte chordMs;
+        unsigned int swipeMs;
+
+        TouchEntry history[TOUCH_HISTORY];
+        byte head;
+        byte entries;
+        unsigned long lastChange;
         // true on a proximity event until a touch/clear
         bool proximityEvent;
         struct Electrodes electrodes;
+        unsigned int gestures;
+        unsigned int doubleTapElectrodes;
+        const byte *gestureTable;
 
         bool running;
 
+        byte shadow[MPR121_SHADOW_SIZE];
+        byte dirty[(MPR121_SHADOW_SIZE + 7) / 8];
+        byte batchDepth;
+        // re-read the auto-configured CDC/CDT registers on the next flush
+        bool syncAutoConfig;
+
         struct {
             byte address;
             union {
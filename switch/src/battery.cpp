@@ -1,4 +1,38 @@
 #include <Arduino.h>
+#include <avr/sleep.h>
+
+// conversions averaged by readVcc()
+#define VCC_SAMPLES     8
+// conversions discarded while the reference settles after selecting it
+#define VCC_SETTLE      4
+
+// set by the ADC interrupt, which wakes the MCU from noise reduction sleep
+static volatile bool converted;
+
+ISR(ADC_vect) {
+    converted = true;
+}
+
+/* Runs a conversion in ADC noise reduction sleep, entering it starts the
+   conversion with the CPU and I/O clocks stopped.  Other interrupts (timer
+   0) end the sleep early, sleep again until the conversion completed. */
+static unsigned int convert() {
+    converted = false;
+    sleep_enable();
+    for (;;) {
+        noInterrupts();
+        if (converted)
+            break;
+        interrupts();
+        sleep_cpu();                    // runs right after sei
+    }
+    interrupts();
+    sleep_disable();
+
+    uint8_t low  = ADCL;                // must read ADCL first, it locks ADCH
+    uint8_t high = ADCH;                // unlocks both
+    return (high << 8) | low;
+}
 
 // From: http://provideyourown.com/2012/secret-arduino-voltmeter-measure-battery-voltage/
 long readVcc() {
@@ -18,16 +52,20 @@ long readVcc() {
     ADMUX = _BV(REFS0) | _BV(MUX3) | _BV(MUX2) | _BV(MUX1);
 #endif
 
-    delay(2);                           // Wait for Vref to settle
-    ADCSRA |= _BV(ADSC);                // Start conversion
-    while (bit_is_set(ADCSRA,ADSC));    // measuring
-
-    uint8_t low  = ADCL;                // must read ADCL first, it locks ADCH
-    uint8_t high = ADCH;                // unlocks both
-
-    long result = (high<<8) | low;
+    // the MCU sleeps through the conversions instead of the delay(2) and
+    // polling ADSC, the first ones are taken while Vref settles
+    set_sleep_mode(SLEEP_MODE_ADC);
+    // writing ADIF clears a stale interrupt flag
+    ADCSRA |= _BV(ADEN) | _BV(ADIE) | _BV(ADIF);
+    for (byte i = 0; i < VCC_SETTLE; ++i)
+        convert();
+    unsigned long sum = 0;
+    for (byte i = 0; i < VCC_SAMPLES; ++i)
+        sum += convert();
+    ADCSRA &= ~_BV(ADIE);
+    if (!sum)
+        return 0;
 
     // Calculate Vcc (in mV); 1125300 = 1.1*1023*1000
-    result = 1125300L / result;
-    return result;  // Vcc in millivolts
+    return 1125300L * VCC_SAMPLES / sum;  // Vcc in millivolts
 }
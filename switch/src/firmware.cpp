@@ -1,15 +1,34 @@
 //
 // Capacitive touch light switch
 //
+
+// module id of the DEBUG() records, see DebugLog.h
+#define LOG_MODULE  0
+
 #include <Arduino.h>
+#include <stddef.h>
 #include <avr/wdt.h>
 #include <EEPROM.h>
 #include <Wire.h>
 #include "LowPower.h"
 #include "TouchSequence.h"
+#include "ElectrodeStream.h"
+#include "SliderStream.h"
+#include "PowerScheduler.h"
+#include "DutyCounter.h"
+#include "RepeatCoalescer.h"
+#include "AckWindow.h"
+#include "EventQueue.h"
+#include "StatusSchedule.h"
+#include "BatteryTrend.h"
+#include "ConfigStore.h"
+#include "ThresholdCalibration.h"
 #include "RFM12B.h"
 #include "SwitchProtocol.h"
 #include "SwitchSettings.h"
+#include "CompactCodec.h"
+#include "TouchTrace.h"
+#include "LogRing.h"
 #include "util.h"
 #include "debug.h"
 
@@ -17,30 +36,158 @@
 #error "NETWORKID must be defined!"
 #endif
 
+// MPR121s of a multi-gang wall plate, gang n is at mpr121Addr + n
+#ifndef TOUCH_GANGS
+#define TOUCH_GANGS 1
+#endif
+#if TOUCH_GANGS < 1 || TOUCH_GANGS > MAX_TOUCH_SENSORS
+#error "TOUCH_GANGS must be 1 - MAX_TOUCH_SENSORS"
+#endif
+
 static const int mpr121Addr         = 0x5A;
-static const int mpr121IntPin       = 1;    // int 1 == pin 3
+// int 1 == pin 3, the IRQ outputs of all gangs are wired to it
+static const int mpr121IntPin       = 1;
 
 static SwitchSettings cfg;
+// crc16() of cfg, sent with each status
+static unsigned int cfgCrc          = 0;
 static unsigned int statusCount     = 0;
 
 RFM12B radio;
-TouchSequence touch(mpr121Addr, mpr121IntPin);
-period_t sleepPeriod = SLEEP_FOREVER;
+TouchSequence touch[TOUCH_GANGS] = {
+    TouchSequence(mpr121Addr, mpr121IntPin),
+#if TOUCH_GANGS > 1
+    TouchSequence(mpr121Addr + 1, mpr121IntPin),
+#endif
+#if TOUCH_GANGS > 2
+    TouchSequence(mpr121Addr + 2, mpr121IntPin),
+#endif
+#if TOUCH_GANGS > 3
+    TouchSequence(mpr121Addr + 3, mpr121IntPin),
+#endif
+};
+static ThresholdCalibration calibration[TOUCH_GANGS] = {
+    ThresholdCalibration(touch[0]),
+#if TOUCH_GANGS > 1
+    ThresholdCalibration(touch[1]),
+#endif
+#if TOUCH_GANGS > 2
+    ThresholdCalibration(touch[2]),
+#endif
+#if TOUCH_GANGS > 3
+    ThresholdCalibration(touch[3]),
+#endif
+};
+
+// the touch sequence state of a gang, its power state is kept by power
+struct GangState {
+    // gesture reported ahead of its timeout by GESTURE_SPECULATIVE
+    byte reportedGesture;
+    unsigned int reportedElectrode;
+    // the sequence started with a touch interrupt
+    bool touchWake;
+    // a finger is held on the slider, see slide()
+    bool sliding;
+    // gesture of the repeat ticks held back by repeats[]
+    byte repeatGesture;
+    unsigned int repeatElectrode;
+};
+static GangState gang[TOUCH_GANGS];
+static SliderStream slider[TOUCH_GANGS];
+static RepeatCoalescer repeats[TOUCH_GANGS];
+static PowerScheduler power(TOUCH_GANGS);
+
+// time spent asleep in sleepTracked(), millis() stops in power down
+static unsigned long sleptMs        = 0;
+// time powered down that the RFM12B wakeup timer accounts for, it was
+// armed at timerArmedAt (clockMs()) to fire timerMs later
+static unsigned long downMs         = 0;
+static unsigned long timerArmedAt   = 0;
+static unsigned long timerMs        = 0;
+
+// touch wakeups since boot and those that did not end in an enabled gesture
+static unsigned int touchWakes      = 0;
+static unsigned int falseWakes      = 0;
+
+// energy accounting since boot, see SwitchEnergy
+static unsigned long wakes          = 0;
+static DutyCounter txTime;
+static DutyCounter ackWaitTime;
+
+// the observed ACK round trips, see SleepSettings::ackPercentile
+static AckWindow ackWindow;
+
+// when the next status is due, see SleepSettings::statusPiggyback
+static StatusSchedule statusSchedule;
+// a status went out with a touch event, calibrate on the next idle pass
+static bool calibrationDue          = false;
+
+// the daily Vcc averages, see BatterySettings::cutoffMv
+static BatteryTrend batteryTrend;
+
+// the journal of the settings in EEPROM
+static ConfigStore configStore;
+
+// the CompactCodec version the hub selected, 0 sends the structs until it
+// answers the ENCODING sent with each status
+static byte encoding                = 0;
+
+// the touch events and corrections waiting for an ACK, sent by
+// sendOutbox() with the outbox and a status if one is due
+static EventQueue events;
+// the last packet sent carried the queued events
+static bool eventsSent              = false;
+
+// the packets of all gangs queued during a loop() pass that need no ACK,
+// repeat ticks and slider data
+static byte outbox[TOUCH_GANGS * sizeof(TouchCorrection) +
+                   sizeof(SwitchSliderData)];
+static byte outboxLen               = 0;
+// the outbox and the queued events fit a packet, a status only rides along
+// when there is room left
+typedef char outboxFitsPacket[sizeof(outbox) + sizeof(SwitchSequence) +
+                              EVENT_QUEUE_SIZE <= RF12_MAXDATA ? 1 : -1];
+
+// raw electrode data streaming requested by STREAM_REQUEST
+static ElectrodeStream stream;
+static unsigned int streamRemaining = 0;
+
+// the debug log was requested by a LOG_REQUEST
+static bool logRequested            = false;
+
+// the time spent in each phase of setup(), sent with the first status
+static SwitchBoot boot;
+static bool bootReported            = false;
+
+// Survives softReset(), which leaves the MPR121s running.  If the settings
+// they were configured with are unchanged setup() takes them over as they
+// are, the events are numbered on from sequence.  Holds garbage after a
+// power on, which magic tells from a reset.
+#define WARM_MAGIC          0x5741
+static struct {
+    unsigned int magic;
+    unsigned int touchCrc;
+    byte sequence;
+} warm __attribute__((section(".noinit")));
 
 extern long readVcc();
+byte fillStatus(byte *buf);
+unsigned int touchConfigCrc();
 void sendStatus();
+void radioSend(const void *data, byte len, bool ack);
 
 void softReset() {
-#if !defined(NDEBUG)
     DEBUG("softReset:");
+    warm.sequence = events.getNext();
+#if defined(DEBUG_SERIAL)
     Serial.flush();
 #endif
     asm volatile ("  jmp 0");
 }
 
 void sleep(period_t time) {
-#if !defined(NDEBUG)
     DEBUG("sleep: ", time);
+#if defined(DEBUG_SERIAL)
     // flush serial for debugging before powering down
     Serial.flush();
     delay(100);
@@ -52,42 +199,252 @@ void sleep(period_t time) {
         wdt_disable();
         LowPower.powerDown(time, ADC_OFF, BOD_OFF);
     }
-    else
+    else {
         LowPower.powerStandby(time, ADC_OFF, BOD_OFF);
+        sleptMs += (unsigned long)WDT_SLICE_MS << time;
+    }
+    wakes++;
 }
 
-void saveConfiguration(SwitchSettings &settings) {
-    SwitchSettings current;
+/* ms since boot including the time spent in sleepTracked() and the time
+   powered down known from the wakeup timer.  Power down ended by a touch
+   is not known, the clock runs slow by it. */
+unsigned long clockMs() {
+    return millis() + sleptMs + downMs;
+}
 
-    EEPROM_readAnything(0, current);
-    byte *s = (byte *)&settings;
-    byte *c = (byte *)&current;
-    for (unsigned int i = 0; i < sizeof(SwitchSettings); ++i) {
-        if (c[i] == s[i])
-            continue;
-        DEBUG_("byte [");
-        DEBUG_FMT_(i, HEX);
-        DEBUG_("] current: ");
-        DEBUG_FMT_(c[i], HEX);
-        DEBUG_(" new: ");
-        DEBUG_FMT(s[i], HEX);
-        EEPROM.write(i, s[i]);
+/* Arms the RFM12B wakeup timer to fire interval * 2^statusScaler ms on */
+void armTimer(byte interval) {
+    radio.Sleep(interval, cfg.sleep.statusScaler);
+    timerArmedAt = clockMs();
+    timerMs = (unsigned long)interval << cfg.sleep.statusScaler;
+}
+
+/* The wakeup timer fired, the part of its interval the clock did not see
+   was spent powered down */
+void timerFired() {
+    unsigned long elapsed = clockMs() - timerArmedAt;
+    if (elapsed < timerMs)
+        downMs += timerMs - elapsed;
+}
+
+/* True if a touch interrupt is pending on any gang */
+bool isInterrupted() {
+    for (byte g = 0; g < TOUCH_GANGS; ++g) {
+        if (touch[g].isInterrupted())
+            return true;
+    }
+    return false;
+}
+
+/* Sleeps in the mode of the power state until one of its wake sources
+   fires.  In standby it sleeps in the longest watchdog periods that fit
+   until the earliest period of the gangs ends, adding each to the clock,
+   and ends early on a touch interrupt.  The interrupted period is not
+   known, half of it is counted.  A retry of the queued events keeps it in
+   standby until the retry is due. */
+void sleepTracked() {
+    if (isInterrupted())
+        return;
+    unsigned long wakeAt;
+    unsigned long retryAt;
+    unsigned long now = clockMs();
+    bool timed = power.getMode() != MODE_POWER_DOWN && power.getWakeAt(wakeAt);
+    if (events.getRetryAt(retryAt) &&
+        (!timed || (long)(retryAt - wakeAt) < 0)) {
+        wakeAt = retryAt;
+        timed = true;
+    }
+    if (!timed) {
+        sleep(SLEEP_FOREVER);
+        return;
+    }
+    DEBUG("sleep: ", wakeAt - now);
+#if defined(DEBUG_SERIAL)
+    Serial.flush();
+#endif
+    while ((long)(wakeAt - now) > 0) {
+        byte period = SLEEP_8S;
+        while (period > SLEEP_15MS &&
+               ((unsigned long)WDT_SLICE_MS << period) > wakeAt - now)
+            period--;
+        LowPower.powerStandby((period_t)period, ADC_OFF, BOD_OFF);
+        wakes++;
+        if (isInterrupted()) {
+            sleptMs += (unsigned long)WDT_SLICE_MS << period >> 1;
+            return;
+        }
+        sleptMs += (unsigned long)WDT_SLICE_MS << period;
+        now = clockMs();
     }
 }
 
+/* The MPR121 at an i2c address, NULL if it is not one of the gangs */
+TouchSequence *findTouch(byte address) {
+    if (address < mpr121Addr || address >= mpr121Addr + TOUCH_GANGS)
+        return NULL;
+    return &touch[address - mpr121Addr];
+}
+
+/* The electrode reported with a gesture, the electrode bitmap for chords */
+unsigned int gestureElectrode(byte g, TouchGesture gesture) {
+    if (gesture == TOUCH_CHORD)
+        return touch[g].getChord();
+    return touch[g].getLastTouch();
+}
+
+#if defined(TOUCH_TRACE)
+static unsigned long traceTime      = 0;
+static unsigned int traceStatus     = 0;
+
+/* Writes a touch trace record line, see TouchTrace.h */
+void traceWrite(unsigned int status) {
+    unsigned long now = clockMs();
+    TraceRecord r;
+    r.ms = now - traceTime > 0xFFFF ? 0xFFFF : now - traceTime;
+    r.status = status;
+    traceTime = now;
+
+    byte buf[TRACE_RECORD_SIZE];
+    traceEncode(r, buf);
+    Serial.print(TRACE_PREFIX);
+    for (byte i = 0; i < sizeof(buf); ++i) {
+        if (buf[i] < 0x10)
+            Serial.print('0');
+        Serial.print(buf[i], HEX);
+    }
+    Serial.println();
+    Serial.flush();
+}
+#endif
+
+/* Records a change of the touch status in the trace, the trace follows the
+   first gang */
+void traceTouch(byte g) {
+#if defined(TOUCH_TRACE)
+    if (g || touch[g].getStatus() == traceStatus)
+        return;
+    traceStatus = touch[g].getStatus();
+    traceWrite(traceStatus);
+#endif
+}
+
+/* Ends the traced session with the gesture it was reported as */
+void traceGesture(byte g) {
+#if defined(TOUCH_TRACE)
+    if (g)
+        return;
+    TouchGesture gesture = touch[g].getGesture();
+    traceWrite(traceEnd(gesture, gestureElectrode(g, gesture) & 0xFF));
+    traceStatus = 0;
+#endif
+}
+
+void saveConfiguration(SwitchSettings &settings) {
+    if (!configStore.commit(settings))
+        DEBUG("saveConfiguration: failed");
+}
+
 void loadConfiguration() {
     DEBUG("loadConfiguration:");
 
-    SwitchSettings current;
-    EEPROM_readAnything(0, current);
-    if (current.header.major != FIRMWARE_MAJOR_VERSION ||
-        current.header.minor != FIRMWARE_MINOR_VERSION) {
-        DEBUG("loadConfiguration: no configuration");
-        // save default settings
-        saveConfiguration(cfg);
+    switch (configStore.load(cfg)) {
+        case CONFIG_NONE:
+            DEBUG("loadConfiguration: no configuration");
+            // save default settings
+            saveConfiguration(cfg);
+            break;
+        case CONFIG_MIGRATED:
+            // in the current layout from now on
+            saveConfiguration(cfg);
+            break;
     }
-    else
-        cfg = current;
+    cfgCrc = crc16(&cfg, sizeof(cfg));
+}
+
+// the parts of the settings a CONFIGURE changed, see settingsPart()
+#define SETTINGS_SAVE       0x01    // read where used, saving suffices
+#define SETTINGS_RESET      0x02    // radio identity, takes a reboot
+#define SETTINGS_TOUCH      0x04    // MPR121 registers
+#define SETTINGS_PROXIMITY  0x08    // proximity thresholds
+#define SETTINGS_SLEEP      0x10    // PowerScheduler periods
+#define SETTINGS_GESTURE    0x20    // TouchSequence gestures and timing
+
+/* The part of the settings the byte at offset belongs to */
+byte settingsPart(byte offset) {
+    // the node id the radio was initialized with
+    if (offset < offsetof(SwitchSettings, rfm12b) +
+                 offsetof(RFM12BSettings, txPower))
+        return SETTINGS_RESET;
+    if (offset < offsetof(SwitchSettings, mpr121))
+        return SETTINGS_SAVE;
+    if (offset < offsetof(SwitchSettings, sleep))
+        return SETTINGS_TOUCH;
+    if (offset < offsetof(SwitchSettings, gesture))
+        return SETTINGS_SLEEP;
+    if (offset < offsetof(SwitchSettings, calibration))
+        return SETTINGS_GESTURE;
+    if (offset == offsetof(SwitchSettings, calibration) +
+                  offsetof(CalibrationSettings, proximityTouch))
+        return SETTINGS_PROXIMITY;
+    if (offset < offsetof(SwitchSettings, slider))
+        return SETTINGS_SAVE;
+    // the slider period and enable flag
+    if (offset < offsetof(SwitchSettings, battery))
+        return SETTINGS_SLEEP;
+    return SETTINGS_SAVE;
+}
+
+/* Sets the gestures and their timing of a gang from cfg */
+void setGestures(TouchSequence &t) {
+    t.setGestures(cfg.gesture.getEnabled(), cfg.gesture.getDoubleTap());
+    t.setGestureTable(cfg.gesture.table);
+    t.setTiming(cfg.gesture.chordMs, cfg.gesture.swipeMs);
+}
+
+/* Sets the proximity thresholds of a gang, adjusted by calibrate() later
+   on */
+void setProximityThresholds(TouchSequence &t) {
+    t.beginBatch();
+    t.setTouchThreshold(cfg.calibration.proximityTouch, ELECTRODE_PROXIMITY);
+    t.setReleaseThreshold(max(cfg.calibration.proximityTouch / 2, 1),
+                          ELECTRODE_PROXIMITY);
+    t.commitBatch();
+}
+
+/* Applies the parts of cfg a CONFIGURE changed to the running switch */
+void applySettings(byte parts) {
+    DEBUG("apply settings: ", parts);
+    if (parts & SETTINGS_SLEEP)
+        power.setPeriods(cfg.sleep, cfg.slider);
+    for (byte g = 0; g < TOUCH_GANGS; ++g) {
+        TouchSequence &t = touch[g];
+        if (parts & SETTINGS_GESTURE)
+            setGestures(t);
+        if (parts & SETTINGS_TOUCH) {
+            t.configure(cfg.mpr121);
+            // the noise seen with the previous filters is void
+            calibration[g].reset();
+        }
+        if (parts & (SETTINGS_TOUCH | SETTINGS_PROXIMITY))
+            setProximityThresholds(t);
+    }
+    // a soft reset takes over the MPR121s as configured now
+    warm.touchCrc = touchConfigCrc();
+}
+
+/* Sets count bytes of cfg from offset, returns the parts of the settings
+   that changed */
+byte configureBytes(byte offset, const byte *values, byte count) {
+    byte *settings = (byte *)&cfg;
+    byte parts = 0;
+    for (byte i = 0; i < count; ++i, ++offset) {
+        if (settings[offset] == values[i])
+            continue;
+        settings[offset] = values[i];
+        parts |= settingsPart(offset);
+    }
+    return parts;
 }
 
 void handleReply() {
@@ -96,10 +453,22 @@ void handleReply() {
     byte datalen = *radio.DataLen;
     memcpy(data, (void *)radio.Data, datalen);
     unsigned char offset = 0;
-    bool settingsChanged = false;
-    while (offset < datalen) {
+    byte settingsChanged = 0;
+    // a RESET ends the reply, the writes and settings before it are
+    // committed first
+    bool reset = false;
+    bool resetSettings = false;
+    // all I2C_SETs in this reply share a single stop/run cycle per MPR121
+    for (byte g = 0; g < TOUCH_GANGS; ++g)
+        touch[g].beginBatch();
+    while (!reset && offset + sizeof(SwitchPacket) <= datalen) {
         SwitchPacket *header = (SwitchPacket *)(data + offset);
         DEBUG("header type: ", header->type);
+        if (header->len < sizeof(SwitchPacket) ||
+            offset + header->len > datalen) {
+            DEBUG("bad length: ", header->len);
+            break;
+        }
         switch (header->type) {
             case SwitchPacket::PING:
                 DEBUG("ping");
@@ -114,58 +483,111 @@ void handleReply() {
                 DEBUG_FMT_(pkt->cfg.offset, HEX);
                 DEBUG_(" : ");
                 DEBUG_FMT(pkt->cfg.value, HEX);
-                byte *settings = (byte *)&cfg;
-                settings[pkt->cfg.offset] = pkt->cfg.value;
-                settingsChanged = true;
+                if (header->len != sizeof(SwitchConfigure) ||
+                    pkt->cfg.offset >= sizeof(SwitchSettings)) {
+                    DEBUG("bad configure");
+                    break;
+                }
+                settingsChanged |= configureBytes(pkt->cfg.offset,
+                                                  &pkt->cfg.value, 1);
+                break;
+            }
+            case SwitchPacket::CONFIGURE_RANGE: {
+                SwitchConfigureRange *pkt = (SwitchConfigureRange *)header;
+                byte fixed = sizeof(SwitchConfigureRange) -
+                    CONFIGURE_RANGE_SIZE;
+                if (header->len < fixed ||
+                    header->len != fixed + pkt->count ||
+                    pkt->offset + pkt->count > sizeof(SwitchSettings)) {
+                    DEBUG("bad configure range");
+                    break;
+                }
+                DEBUG("set range ", pkt->offset, " : ", pkt->count);
+                settingsChanged |= configureBytes(pkt->offset, pkt->value,
+                                                  pkt->count);
                 break;
             }
             case SwitchPacket::DUMP_REQUEST: {
                 SwitchDumpSettings pkt;
-                DEBUG("dumping settings from EEPROM...");
-                EEPROM_readAnything(0, pkt.settings);
+                DEBUG("dumping settings...");
+                // the settings in use, as saved in the newest record
+                pkt.settings = cfg;
                 for (byte b = 0; b < sizeof(pkt.settings); ++b) {
                     DEBUG_FMT_(*((byte *)&pkt.settings + b), HEX);
                     DEBUG_(":");
                 }
                 DEBUG("");
-                radio.Send(GATEWAYID, (const void*)(&pkt), sizeof(pkt), false);
+                radioSend(&pkt, sizeof(pkt), false);
                 break;
             }
             case SwitchPacket::RESET: {
                 DEBUG("reset");
                 SwitchReset *pkt = (SwitchReset *)header;
-                if (pkt->resetSettings) {
-                    DEBUG("resetting settings");
-                    byte v = 255;
-                    EEPROM_writeAnything(0, v);
-                }
-                softReset();
+                reset = true;
+                resetSettings = pkt->resetSettings;
                 break;
             }
             case SwitchPacket::I2C_REQUEST: {
                 SwitchI2CRequest *request = (SwitchI2CRequest *)header;
                 SwitchI2CReply reply;
 
-                Wire.beginTransmission(request->address);
-                Wire.write(request->reg);
-                Wire.endTransmission(false);
-                Wire.requestFrom(request->address, (byte)1);
-                Wire.endTransmission();
+                byte count = 1;
+                if (header->len >= sizeof(SwitchI2CRequest) && request->count)
+                    count = min(request->count, I2C_MAX_READ);
 
                 reply.address = request->address;
                 reply.reg = request->reg;
-                reply.val = Wire.read();
+                TouchSequence *sensor = findTouch(request->address);
+                if (sensor)
+                    reply.count = sensor->getRegisters(request->reg, reply.val,
+                                                       count);
+                else {
+                    Wire.beginTransmission(request->address);
+                    Wire.write(request->reg);
+                    Wire.endTransmission(false);
+                    reply.count = Wire.requestFrom(request->address, count);
+                    for (byte i = 0; i < reply.count; ++i)
+                        reply.val[i] = Wire.read();
+                }
+                // a failed read still carries a value, only the replies of
+                // protocol 1 switches end before it
+                if (!reply.count)
+                    reply.val[0] = 0;
+                reply.len = sizeof(reply) -
+                    (I2C_MAX_READ - (reply.count ? reply.count : 1));
                 DEBUG("i2c request: ", reply.address, " ", reply.reg, " ",
-                        reply.val);
-                radio.Send(GATEWAYID, (const void*)(&reply), sizeof(reply), false);
+                        reply.count);
+                radioSend(&reply, reply.len, false);
                 break;
             }
+            case SwitchPacket::STREAM_REQUEST: {
+                SwitchStreamRequest *pkt = (SwitchStreamRequest *)header;
+                DEBUG("stream: ", pkt->samples, " period: ", pkt->period);
+                streamRemaining = pkt->samples;
+                stream.reset(pkt->period);
+                break;
+            }
+            case SwitchPacket::ENCODING: {
+                SwitchEncoding *pkt = (SwitchEncoding *)header;
+                if (header->len != sizeof(SwitchEncoding)) {
+                    DEBUG("bad encoding");
+                    break;
+                }
+                encoding = min(pkt->version, COMPACT_VERSION);
+                DEBUG("encoding: ", encoding);
+                break;
+            }
+            case SwitchPacket::LOG_REQUEST:
+                DEBUG("log request");
+                logRequested = true;
+                break;
             case SwitchPacket::I2C_SET: {
                 SwitchI2CSet *pkt = (SwitchI2CSet *)header;
                 bool success = false;
                 DEBUG("i2c set: ", pkt->address, " ", pkt->reg, " ", pkt->val);
-                if (pkt->address == mpr121Addr) {
-                    success = touch.setRegister(pkt->reg, pkt->val);
+                TouchSequence *sensor = findTouch(pkt->address);
+                if (sensor) {
+                    success = sensor->setRegister(pkt->reg, pkt->val);
                 }
                 else {
                     Wire.beginTransmission(pkt->address);
@@ -184,31 +606,157 @@ void handleReply() {
         offset += header->len;
         DEBUG("offset: ", offset);
     }
+    // the changed registers share the stop/run cycle as well
+    if (settingsChanged & ~(SETTINGS_SAVE | SETTINGS_RESET))
+        applySettings(settingsChanged);
+    for (byte g = 0; g < TOUCH_GANGS; ++g)
+        touch[g].commitBatch();
 
-    if (settingsChanged) {
+    if (resetSettings) {
+        DEBUG("resetting settings");
+        SwitchSettings defaults;
+        saveConfiguration(defaults);
+        // configure the MPR121s from scratch as well
+        warm.magic = 0;
+    }
+    else if (settingsChanged) {
         saveConfiguration(cfg);
+        cfgCrc = crc16(&cfg, sizeof(cfg));
+    }
+    if (reset || (settingsChanged & SETTINGS_RESET))
         softReset();
+}
+
+/* Sends a packet to the base station, compact if that was negotiated and
+   makes it shorter */
+void radioSend(const void *data, byte len, bool ack) {
+    byte compact[RF12_MAXDATA];
+    if (encoding) {
+        byte n = compactEncode((const byte *)data, len, compact,
+                               sizeof(compact), encoding);
+        if (n) {
+            data = compact;
+            len = n;
+        }
     }
+    txTime.start();
+    radio.Send(GATEWAYID, data, len, ack);
+    txTime.stop();
 }
 
+/* Listens for the ACK of the packet just sent.  The MCU idles between the
+   radio interrupts and timer0 ticks, which keep millis() running.  A packet
+   coming in when the window closes, an ACK carrying commands takes up to
+   30ms, is listened to until its announced length has arrived. */
 void waitForReply(bool sleep = true) {
-    long now = millis();
-    while (millis() - now <= cfg.sleep.replyWakeLock) {
+    byte previous = power.enter(POWER_AWAITING_ACK);
+    byte window = ackWindow.getWindow(cfg.sleep.ackPercentile,
+                                      cfg.sleep.replyWakeLock);
+    bool received = false;
+    unsigned long now = millis();
+    unsigned long limit = window;
+    // the length of an incoming packet was seen heardMs into the wait
+    bool heard = false;
+    unsigned long heardMs = 0;
+    ackWaitTime.start();
+    while (millis() - now <= limit) {
         if (radio.ACKReceived(GATEWAYID)) {
-            handleReply();
+            received = true;
             break;
         }
+        byte len = *radio.DataLen;
+        if (!len)
+            heard = false;
+        else if (!heard) {
+            heard = true;
+            heardMs = millis() - now;
+            unsigned long airMs = ((unsigned long)len + ACK_TRAILER) *
+                                  ACK_BYTE_US / 1000 + 1;
+            if (heardMs + airMs > limit)
+                limit = heardMs + airMs;
+        }
+        LowPower.idle(SLEEP_FOREVER, ADC_OFF, TIMER2_OFF, TIMER1_OFF,
+                      TIMER0_ON, SPI_ON, USART0_ON, TWI_OFF);
     }
+    ackWaitTime.stop();
+    // the window has to cover the start of an ACK, not its payload
+    if (received)
+        ackWindow.add(heard ? heardMs : millis() - now);
+    else
+        ackWindow.miss();
+    DEBUG("ack: ", received ? millis() - now : 0, " window: ", window);
+    power.enter(previous);
+    if (eventsSent) {
+        eventsSent = false;
+        if (received)
+            events.acked();
+        else
+            events.missed(clockMs());
+    }
+    if (received)
+        handleReply();
+    // the wakeup timer restarts, aim it at the next status
     if (sleep)
-        radio.Sleep(cfg.sleep.statusInterval, cfg.sleep.statusScaler);
+        armTimer(statusSchedule.getInterval(clockMs(), cfg.sleep));
+}
+
+/* Writes the SwitchSequence and the queued events to buf, waitForReply()
+   settles them with the ACK of the packet */
+byte fillEvents(byte *buf) {
+    byte len = events.fill(buf);
+    eventsSent = len;
+    return len;
 }
 
-/* Sends a touch event to the base station */
-void handleEvent(byte repeated) {
+/* Sends the outbox and the queued events in a single packet, the events
+   after the outbox as the SwitchSequence numbers all that follow it.  A
+   status due soon is appended to an acknowledged packet with room for it,
+   saving the radio wakeup of its own. */
+void sendOutbox() {
+    if (!outboxLen && !events.isDue(clockMs()))
+        return;
+    byte buf[RF12_MAXDATA];
+    memcpy(buf, outbox, outboxLen);
+    byte len = outboxLen;
+    outboxLen = 0;
+    byte numbered = fillEvents(buf + len);
+    len += numbered;
+    if (numbered && statusSchedule.isDue(clockMs(), cfg.sleep) &&
+            len + sizeof(SwitchStatus) + sizeof(SwitchEnergy) <= RF12_MAXDATA) {
+        DEBUG("status: piggyback");
+        len += fillStatus(buf + len);
+        statusSchedule.sent(clockMs(), cfg.sleep);
+        calibrationDue = true;
+    }
+    DEBUG("send: ", len);
+    radio.Wakeup();
+    radioSend(buf, len, numbered);
+    if (numbered)
+        waitForReply();
+}
+
+/* Queues a packet for sendOutbox(), ack if the packet needs one.  Those are
+   sent again until acknowledged. */
+void queuePacket(const SwitchPacket &pkt, bool ack) {
+    if (ack) {
+        events.add(pkt);
+        return;
+    }
+    if (outboxLen + pkt.len > sizeof(outbox))
+        sendOutbox();
+    memcpy(outbox + outboxLen, &pkt, pkt.len);
+    outboxLen += pkt.len;
+}
+
+/* Queues a touch event for the base station, repeated is the number of
+   repeat ticks it stands for */
+void queueEvent(byte g, byte gesture, unsigned int electrode, byte repeated) {
     TouchEvent pkt;
-    pkt.gesture = touch.getGesture();
-    pkt.electrode = touch.getLastTouch();
+    pkt.gesture = gesture;
+    pkt.electrode = electrode & 0xFF;
+    pkt.electrodeHigh = electrode >> 8;
     pkt.repeat = repeated;
+    pkt.gang = g;
 #if !defined(NDEBUG)
     switch (pkt.gesture) {
         case TOUCH_SWIPE_DOWN:  DEBUG("swipe down");   break;
@@ -222,94 +770,467 @@ void handleEvent(byte repeated) {
         case TOUCH_DOUBLE_TAP:
             DEBUG("double tap ", pkt.electrode);
             break;
+        case TOUCH_CHORD:
+            DEBUG("chord ", electrode);
+            break;
         default:
             DEBUG("no gesture");
             return;
     }
 #endif
+    queuePacket(pkt, !repeated);
+}
+
+/* Queues the current gesture of a gang */
+void handleEvent(byte g, byte repeated) {
+    TouchGesture gesture = touch[g].getGesture();
+    queueEvent(g, gesture, gestureElectrode(g, gesture), repeated);
+}
+
+/* Counts a repeat tick of a held electrode, sent once enough ticks were
+   coalesced */
+void repeatEvent(byte g, unsigned long now) {
+    TouchGesture gesture = touch[g].getGesture();
+    gang[g].repeatGesture = gesture;
+    gang[g].repeatElectrode = gestureElectrode(g, gesture);
+    byte n = repeats[g].tick(now, cfg.sleep);
+    if (n)
+        queueEvent(g, gang[g].repeatGesture, gang[g].repeatElectrode, n);
+}
+
+/* Sends the repeat ticks held back at the end of a hold */
+void flushRepeats(byte g) {
+    byte n = repeats[g].flush();
+    if (n)
+        queueEvent(g, gang[g].repeatGesture, gang[g].repeatElectrode, n);
+}
+
+/* Replaces a speculatively reported gesture if the sequence turned out to be
+   something else */
+void sendCorrection(byte g) {
+    TouchCorrection pkt;
+    pkt.reportedGesture = gang[g].reportedGesture;
+    unsigned int reported = gang[g].reportedElectrode;
+    pkt.reportedElectrode = reported & 0xFF;
+    pkt.reportedElectrodeHigh = reported >> 8;
+    pkt.gesture = touch[g].getGesture();
+    unsigned int electrode = gestureElectrode(g, (TouchGesture)pkt.gesture);
+    pkt.electrode = electrode & 0xFF;
+    pkt.electrodeHigh = electrode >> 8;
+    pkt.gang = g;
+    if (pkt.gesture == pkt.reportedGesture && electrode == reported)
+        return;
+    DEBUG("correction: ", pkt.reportedGesture, " -> ", pkt.gesture);
+    queuePacket(pkt, true);
+}
+
+/* Queues the slider packet of a gang if it holds news and starts the next
+   one */
+void sendSlider(byte g) {
+    if (slider[g].hasNews()) {
+        DEBUG("slider: ", g, " ", slider[g].packet.samples);
+        queuePacket(slider[g].packet, false);
+    }
+    slider[g].next();
+}
+
+/* Ends the slide of a gang */
+void endSlide(byte g) {
+    if (!gang[g].sliding)
+        return;
+    slider[g].end();
+    sendSlider(g);
+    gang[g].sliding = false;
+}
+
+/* Samples the slider position while a finger is held on the slider, the
+   positions replace the repeat events */
+void slide(byte g) {
+    GangState &state = gang[g];
+    if (!state.sliding) {
+        flushRepeats(g);
+        slider[g].begin(g, cfg.slider.period);
+        state.sliding = true;
+    }
+
+    int position = touch[g].getSliderPosition(cfg.slider.minSignal);
+    if (position < 0)
+        return;
+    position = slider[g].smooth(position, cfg.slider.smoothing);
+    if (!slider[g].add(position, cfg.slider.deadband)) {
+        sendSlider(g);
+        slider[g].add(position, cfg.slider.deadband);
+    }
+    if (slider[g].packet.samples >= cfg.slider.samples)
+        sendSlider(g);
+}
+
+/* Reports the final gesture and starts a new sequence */
+void finishGesture(byte g) {
+    GangState &state = gang[g];
+    endSlide(g);
+    flushRepeats(g);
+    if (state.touchWake) {
+        traceGesture(g);
+        touchWakes++;
+        if (!touch[g].isEnabled(touch[g].getGesture(), touch[g].getLastTouch()))
+            falseWakes++;
+        state.touchWake = false;
+    }
+    if (state.reportedGesture != TOUCH_UNKNOWN)
+        sendCorrection(g);
+    else
+        handleEvent(g, 0);
+    touch[g].clear();
+    state.reportedGesture = TOUCH_UNKNOWN;
+    DEBUG("touch done:", millis());
+    DEBUG("");
+    power.handle(g, EVENT_DONE, clockMs());
+}
+
+/* Called after a release, reports the gesture without waiting for the
+   sequence to time out when the gesture settings allow it */
+void commitEarly(byte g) {
+    if (touch[g].isTouched())
+        return;
+
+    byte flags = cfg.gesture.flags;
+    if ((flags & (GESTURE_EARLY_COMMIT | GESTURE_SPECULATIVE)) &&
+        touch[g].isComplete()) {
+        DEBUG("early commit:");
+        finishGesture(g);
+        return;
+    }
+
+    GangState &state = gang[g];
+    TouchGesture gesture = touch[g].getGesture();
+    if ((flags & GESTURE_SPECULATIVE) &&
+        state.reportedGesture == TOUCH_UNKNOWN &&
+        touch[g].isEnabled(gesture, touch[g].getLastTouch())) {
+        DEBUG("speculative:");
+        handleEvent(g, 0);
+        state.reportedGesture = gesture;
+        state.reportedElectrode = gestureElectrode(g, gesture);
+    }
+}
+
+/* Handles the touch interrupt or the end of the sleep period of a gang,
+   returns true if its touch status changed */
+bool serviceGang(byte g, unsigned long now) {
+    byte event = power.poll(g, touch[g], now);
+    if (event == EVENT_NONE)
+        return false;
+    bool changed = event == EVENT_TOUCH || event == EVENT_PROXIMITY ||
+        event == EVENT_RELEASE;
+    if (changed)
+        gang[g].touchWake = true;
+    traceTouch(g);
+
+    switch (power.handle(g, event, now)) {
+        case ACTION_CHANGE:
+            // either a touch or release event woke us up
+            DEBUG("event: ", g, " ", millis());
+            flushRepeats(g);
+            commitEarly(g);
+            break;
+        case ACTION_REPEAT:
+            // the period ended w/o an interrupt, but an electrode or
+            // proximity sensor is still being touched - this is a repeat
+            // event.  A finger moved off the slider ends its slide.
+            DEBUG("repeat: ", g, " ", power.getRepeats(g));
+            endSlide(g);
+            repeatEvent(g, now);
+            break;
+        case ACTION_SLIDE:
+            slide(g);
+            break;
+        case ACTION_FINISH:
+            // no touch interrupt, no current touch - this is a timeout.
+            // handle the event and then clear everything to reset.
+            finishGesture(g);
+            break;
+    }
+    return changed;
+}
+
+/* Sends the pending electrode samples, the ACK carries a request to stop or
+   change the stream */
+void sendStream() {
+    if (stream.isEmpty())
+        return;
+    DEBUG("stream packet: ", stream.packet.samples);
     radio.Wakeup();
-    radio.Send(GATEWAYID, (const void*)(&pkt), sizeof(pkt), !repeated);
-    if (!repeated)
-        waitForReply();
+    radioSend(&stream.packet, stream.packet.len, true);
+    stream.reset(stream.packet.period);
+    waitForReply();
 }
 
-void sendStatus() {
+/* Samples the electrodes once while streaming */
+void streamElectrodes() {
+    unsigned int filtered[STREAM_MAX_CHANNELS];
+    byte baseline[STREAM_MAX_CHANNELS];
+    byte channels = touch[0].readElectrodeData(filtered, baseline);
+    if (!stream.add(channels, filtered, baseline)) {
+        sendStream();
+        stream.add(channels, filtered, baseline);
+    }
+
+    // the reply to sendStream() may already have stopped the stream
+    if (streamRemaining)
+        streamRemaining--;
+    if (!streamRemaining) {
+        sendStream();
+        // drop the touches seen while streaming and go back to sleep
+        for (byte g = 0; g < TOUCH_GANGS; ++g) {
+            touch[g].clear();
+            touch[g].enableInterrupt();
+            repeats[g].flush();
+            power.handle(g, EVENT_DONE, clockMs());
+        }
+    }
+}
+
+/* True if nothing is touched on a gang, its electrodes only see noise */
+bool isIdle(byte g) {
+    return power.isIdle(g) && !touch[g].isTouched() &&
+        !touch[g].isProximity();
+}
+
+/* Samples the electrode noise of the idle gangs on an idle wakeup and
+   adjusts the thresholds once enough wakeups were sampled */
+void calibrate() {
+    if (!(cfg.calibration.flags & CALIBRATION_ENABLED))
+        return;
+    for (byte i = 0; i < cfg.calibration.samples; ++i) {
+        // a touch woke us up, the remaining samples would not be noise
+        if (isInterrupted())
+            return;
+        for (byte g = 0; g < TOUCH_GANGS; ++g) {
+            if (isIdle(g))
+                calibration[g].sample();
+        }
+        sleep(SLEEP_15MS);
+    }
+    for (byte g = 0; g < TOUCH_GANGS; ++g) {
+        if (isIdle(g))
+            calibration[g].update(cfg.calibration);
+    }
+}
+
+/* Writes the status and energy counters to buf, returns their length */
+byte fillStatus(byte *buf) {
     SwitchStatus pkt;
     pkt.batteryLevel = readVcc();
+    batteryTrend.add(clockMs(), pkt.batteryLevel);
+    pkt.batteryDays = batteryTrend.getDaysLeft(cfg.battery.cutoffMv);
     pkt.statusCount = statusCount++;
-    DEBUG("vcc: ", pkt.batteryLevel, " cnt: ", pkt.statusCount);
+    pkt.touchWakes = touchWakes;
+    pkt.falseWakes = falseWakes;
+    pkt.settingsCrc = cfgCrc;
+    pkt.droppedEvents = events.getDropped();
+    DEBUG("vcc: ", pkt.batteryLevel, " days: ", pkt.batteryDays,
+          " cnt: ", pkt.statusCount,
+          " wakes: ", falseWakes, "/", touchWakes, " crc: ", cfgCrc,
+          " dropped: ", pkt.droppedEvents);
+
+    // millis() only runs while awake
+    SwitchEnergy energy;
+    energy.awakeMs = millis();
+    energy.standbyMs = sleptMs;
+    energy.i2cMs = TouchSequence::getI2CMs();
+    energy.txMs = txTime.getMs();
+    energy.ackWaitMs = ackWaitTime.getMs();
+    energy.wakes = wakes;
+    DEBUG("awake: ", energy.awakeMs, " standby: ", energy.standbyMs,
+          " i2c: ", energy.i2cMs, " tx: ", energy.txMs,
+          " ack: ", energy.ackWaitMs, " wakes: ", wakes);
 
+    memcpy(buf, &pkt, sizeof(pkt));
+    memcpy(buf + sizeof(pkt), &energy, sizeof(energy));
+    return sizeof(pkt) + sizeof(energy);
+}
+
+void sendStatus() {
+    byte buf[sizeof(SwitchStatus) + sizeof(SwitchEnergy) + sizeof(SwitchBoot) +
+             sizeof(SwitchEncoding) + sizeof(SwitchSequence) +
+             EVENT_QUEUE_SIZE];
+    byte len = fillStatus(buf);
+    if (!bootReported) {
+        memcpy(buf + len, &boot, sizeof(boot));
+        len += sizeof(boot);
+        bootReported = true;
+    }
+    if (!encoding) {
+        SwitchEncoding offer;
+        offer.version = COMPACT_VERSION;
+        memcpy(buf + len, &offer, sizeof(offer));
+        len += sizeof(offer);
+    }
+    // events waiting for a retry go along
+    len += fillEvents(buf + len);
+    statusSchedule.sent(clockMs(), cfg.sleep);
     radio.Wakeup();
-    radio.Send(GATEWAYID, (const void*)(&pkt), sizeof(pkt), true);
+    radioSend(buf, len, true);
     waitForReply();
 }
 
+#if defined(DEBUG_LOG)
+/* Sends the debug log records held when the log was requested in LOG_DATA
+   packets, records added meanwhile wait for the next request */
+void sendLog() {
+    unsigned int remaining = LogRing::size();
+    SwitchLogData pkt;
+    radio.Wakeup();
+    do {
+        pkt.dropped = LogRing::getDropped();
+        byte n = LogRing::read(pkt.data, min(remaining, sizeof(pkt.data)));
+        remaining -= n;
+        pkt.flags = remaining && n ? 0 : LOG_END;
+        pkt.len = sizeof(pkt) - sizeof(pkt.data) + n;
+        radioSend(&pkt, pkt.len, true);
+        waitForReply(pkt.flags & LOG_END);
+    } while (!(pkt.flags & LOG_END));
+}
+
+/* Writes the debug log records to the serial port as LOG_PREFIX lines */
+void dumpLog() {
+    byte buf[LOG_MAX_RECORD];
+    byte n;
+    while ((n = LogRing::read(buf, sizeof(buf)))) {
+        for (byte r = 0; r < n; r += buf[r]) {
+            Serial.print(LOG_PREFIX);
+            for (byte i = r; i < r + buf[r]; ++i) {
+                if (buf[i] < 0x10)
+                    Serial.print('0');
+                Serial.print(buf[i], HEX);
+            }
+            Serial.println();
+        }
+    }
+    Serial.flush();
+}
+#endif
+
+/* Ends a boot phase started at mark, returns the start of the next one */
+unsigned long bootPhase(byte phase, unsigned long mark) {
+    unsigned long now = micros();
+    boot.phaseUs[phase] = now - mark;
+    return now;
+}
+
+/* The CRC of the settings the MPR121s are configured with */
+unsigned int touchConfigCrc() {
+    unsigned int crc = crc16(&cfg.mpr121, sizeof(cfg.mpr121));
+    return crc16(&cfg.calibration.proximityTouch,
+                 sizeof(cfg.calibration.proximityTouch), crc);
+}
+
 void setup() {
+    unsigned long mark = micros();
     // initialize serial
     Serial.begin(115200);
     while (!Serial);
     DEBUG("initializing...");
+    mark = bootPhase(BOOT_SERIAL, mark);
 
     // D5 GND for electrodes
     //pinMode(5, OUTPUT);
     //digitalWrite(5, LOW);
 
     loadConfiguration();
+    unsigned int touchCrc = touchConfigCrc();
+    bool warmStart = warm.magic == WARM_MAGIC && warm.touchCrc == touchCrc;
+    // the hub takes a new sequence after a power on, numbered from the
+    // power on count so two power ons never start alike
+    if (warm.magic == WARM_MAGIC)
+        events.begin(warm.sequence, false);
+    else
+        events.begin(ConfigStore::countBoot(), true);
+    mark = bootPhase(BOOT_CONFIG, mark);
 
     DEBUG("  * radio...");
     radio.Initialize(cfg.rfm12b.nodeId, DEFAULT_FREQ_BAND, NETWORKID);
     /* radio.Encrypt(KEY); */
-    radio.Sleep(cfg.sleep.statusInterval, cfg.sleep.statusScaler);
+    armTimer(cfg.sleep.statusInterval);
+    mark = bootPhase(BOOT_RADIO, mark);
 
-    DEBUG("  * touch sensor...");
-    touch.begin(cfg.mpr121);
+    power.setPeriods(cfg.sleep, cfg.slider);
+    DEBUG("  * touch sensors: ", TOUCH_GANGS, warmStart ? " warm" : " cold");
+    boot.flags = warmStart ? BOOT_WARM : 0;
+    for (byte g = 0; g < TOUCH_GANGS; ++g) {
+        TouchSequence &t = touch[g];
+        setGestures(t);
+        gang[g].reportedGesture = TOUCH_UNKNOWN;
+        gang[g].touchWake = false;
+        gang[g].sliding = false;
 
-    // proximity thresholds
-    touch.stop();
-    touch.setTouchThreshold(2, 12);
-    touch.setReleaseThreshold(1, 12);
-    touch.run();
-
-    touch.enableInterrupt();
-    touch.dump();
+        // the thresholds calibrate() left are kept as well
+        if (!warmStart || !t.resume()) {
+            boot.flags &= ~BOOT_WARM;
+            t.begin(cfg.mpr121);
+            setProximityThresholds(t);
+            t.dump();
+        }
+        t.enableInterrupt();
+    }
+    mark = bootPhase(BOOT_TOUCH, mark);
+    warm.magic = WARM_MAGIC;
+    warm.touchCrc = touchCrc;
+    DEBUG("boot: ", boot.phaseUs[BOOT_SERIAL], " ", boot.phaseUs[BOOT_CONFIG],
+          " ", boot.phaseUs[BOOT_RADIO], " ", boot.phaseUs[BOOT_TOUCH], "us");
 
     sendStatus();
 }
 
 void loop() {
-    if (!touch.isInterrupted())
-        sleep(sleepPeriod);
+    if (streamRemaining) {
+        sleep((period_t)stream.packet.period);
+        streamElectrodes();
+        return;
+    }
 
-    if (radio.DidTimeOut())
+    sleepTracked();
+
+#if defined(DEBUG_LOG)
+    if (Serial.available() && Serial.read() == LOG_REQUEST_CHAR)
+        dumpLog();
+    if (logRequested) {
+        logRequested = false;
+        sendLog();
+    }
+#endif
+
+    if (radio.DidTimeOut()) {
+        timerFired();
+        byte previous = power.enter(POWER_STATUS);
+        calibrate();
         sendStatus();
+        power.enter(previous);
+    }
 
-    if (touch.isInterrupted()) {
-        // either a touch or release event woke us up
-        touch.update();
-        if (touch.isTouched())
-            sleepPeriod = (period_t)cfg.sleep.touch;
-        else if (touch.isProximity())
-            sleepPeriod = (period_t)cfg.sleep.proximity;
-        else
-            sleepPeriod = (period_t)cfg.sleep.release;
-        DEBUG("event: ", millis());
-        touch.enableInterrupt();
-    }
-    else if (touch.isTouched() || touch.isProximity()) {
-        // we woke up w/o an interrupt, but an electrode or proximity sensor
-        // is still being touched - this is a repeat event
-        touch.update();
-        DEBUG("repeat:");
-        handleEvent(1);
-        sleepPeriod = (period_t)cfg.sleep.repeat;
+    // the gangs share the interrupt line, service all of them and send the
+    // events they finished in a single packet
+    bool interrupted = isInterrupted();
+    bool changed = false;
+    unsigned long now = clockMs();
+    for (byte g = 0; g < TOUCH_GANGS; ++g)
+        changed |= serviceGang(g, now);
+    // hold the events for up to a slice if another gang is about to finish
+    if (!power.isDueSoon(clockMs()))
+        sendOutbox();
+
+    // a touch too short to show in the touch status of any gang
+    if (interrupted && !changed) {
+        touchWakes++;
+        falseWakes++;
     }
-    else {
-        // no touch interrupt, no current touch - this is a timeout.
-        // handle the event and then clear everything to reset.
-        handleEvent(0);
-        touch.clear();
-        DEBUG("touch done:", millis());
-        DEBUG("");
-        sleepPeriod = SLEEP_FOREVER;
+
+    // the status went out with a touch event, calibrate as the status
+    // wakeup would once all gangs are idle again
+    if (calibrationDue && power.getState() == POWER_IDLE) {
+        calibrationDue = false;
+        power.enter(POWER_STATUS);
+        calibrate();
+        power.enter(POWER_IDLE);
     }
 }